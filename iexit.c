@@ -27,6 +27,7 @@ void exit(int status)
 	snprintf(cond, sizeof(cond), "exit(%d)", status);
 	np_throw(np::event_t(np::EV_EXIT, cond).with_stack());
     }
+    np::profile::probe_t::flush();
     _exit(status);
 }
 
@@ -20,10 +20,25 @@
 #include <getopt.h>
 #include "np/util/profile.hxx"
 
+#define DEFAULT_TIMEOUT_MULTIPLE	5.0
+#define DEFAULT_TIMEOUT_FLOOR		2	/* seconds */
+#define DEFAULT_TIMEOUT_CEILING		600	/* seconds */
+
 static void
 usage(const char *argv0)
 {
-    fprintf(stderr, "Usage: %s [-f output-format] [test-spec...]\n", argv0);
+    fprintf(stderr, "Usage: %s [-f output-format] [-j jobs] [-H history-file] "
+		    "[--adaptive-timeouts[=multiple[,floor[,ceiling]]]] "
+		    "[-M memory-budget-mb] "
+		    "[-K output-keep-kb] [-L output-limit-kb] "
+		    "[-J journal-file [--resume]] [-B result-log] "
+		    "[-S metrics-socket] [-t trace-file] "
+		    "[--daemon socket|--connect socket] "
+		    "[test-spec...]\n", argv0);
+    fprintf(stderr, "Adaptive timeouts are %g times a test's recorded p99 "
+		    "duration, between %d and %d seconds, by default\n",
+		    DEFAULT_TIMEOUT_MULTIPLE, DEFAULT_TIMEOUT_FLOOR,
+		    DEFAULT_TIMEOUT_CEILING);
     exit(1);
 }
 
@@ -34,19 +49,45 @@ main(int argc, char **argv)
     np_plan_t *plan = 0;
     np_runner_t *runner = 0;
     const char *output_format = 0;
-    enum { UNKNOWN, RUN, LIST } mode = UNKNOWN;
+    enum { UNKNOWN, RUN, LIST, DAEMON } mode = UNKNOWN;
+    const char *socket_path = 0;
     int concurrency = -1;
+    const char *history_file = 0;
+    bool adaptive_timeouts = false;
+    float timeout_multiple = DEFAULT_TIMEOUT_MULTIPLE;
+    int timeout_floor = DEFAULT_TIMEOUT_FLOOR;
+    int timeout_ceiling = DEFAULT_TIMEOUT_CEILING;
+    int memory_budget = 0;
+    int output_keep = -1;
+    int output_limit = 0;
+    const char *journal_file = 0;
+    bool resume = false;
+    const char *result_log = 0;
+    const char *metrics_socket = 0;
+    const char *trace_file = 0;
     int c;
     static const struct option opts[] =
     {
 	{ "format", required_argument, NULL, 'f' },
 	{ "jobs", required_argument, NULL, 'j' },
 	{ "list", no_argument, NULL, 'l' },
+	{ "history", required_argument, NULL, 'H' },
+	{ "adaptive-timeouts", optional_argument, NULL, 'T' },
+	{ "memory-budget", required_argument, NULL, 'M' },
+	{ "output-keep", required_argument, NULL, 'K' },
+	{ "output-limit", required_argument, NULL, 'L' },
+	{ "journal", required_argument, NULL, 'J' },
+	{ "resume", no_argument, NULL, 'R' },
+	{ "result-log", required_argument, NULL, 'B' },
+	{ "metrics-socket", required_argument, NULL, 'S' },
+	{ "trace", required_argument, NULL, 't' },
+	{ "daemon", required_argument, NULL, 'D' },
+	{ "connect", required_argument, NULL, 'C' },
 	{ NULL, 0, NULL, 0 },
     };
 
     /* Parse arguments */
-    while ((c = getopt_long(argc, argv, "f:j:l", opts, NULL)) >= 0)
+    while ((c = getopt_long(argc, argv, "f:j:lH:T::M:K:L:J:RB:S:t:D:C:", opts, NULL)) >= 0)
     {
 	switch (c)
 	{
@@ -62,10 +103,81 @@ main(int argc, char **argv)
 	case 'l':
 	    mode = LIST;
 	    break;
+	case 'H':
+	    history_file = optarg;
+	    break;
+	case 'T':
+	    adaptive_timeouts = true;
+	    /* any of the multiple, floor and ceiling, in that order */
+	    if (optarg &&
+		(sscanf(optarg, "%f,%d,%d", &timeout_multiple,
+			&timeout_floor, &timeout_ceiling) < 1 ||
+		 timeout_multiple <= 0 || timeout_floor <= 0 ||
+		 timeout_ceiling < timeout_floor))
+		usage(argv[0]);
+	    break;
+	case 'M':
+	    if ((memory_budget = atoi(optarg)) <= 0)
+		usage(argv[0]);
+	    break;
+	case 'K':
+	    if ((output_keep = atoi(optarg)) < 0)
+		usage(argv[0]);
+	    break;
+	case 'L':
+	    if ((output_limit = atoi(optarg)) <= 0)
+		usage(argv[0]);
+	    break;
+	case 'J':
+	    journal_file = optarg;
+	    break;
+	case 'R':
+	    resume = true;
+	    break;
+	case 'B':
+	    result_log = optarg;
+	    break;
+	case 'S':
+	    metrics_socket = optarg;
+	    break;
+	case 't':
+	    trace_file = optarg;
+	    break;
+	case 'D':
+	    mode = DAEMON;
+	    socket_path = optarg;
+	    break;
+	case 'C':
+	    mode = RUN;
+	    socket_path = optarg;
+	    break;
 	default:
 	    usage(argv[0]);
 	}
     }
+    if (resume && !journal_file)
+	usage(argv[0]);
+    if (mode == RUN && socket_path &&
+	(history_file || adaptive_timeouts || memory_budget ||
+	 output_keep >= 0 || output_limit || journal_file ||
+	 result_log || metrics_socket || trace_file))
+    {
+	/* the daemon protocol only carries the format, jobs and specs,
+	 * and we mustn't silently behave differently with a daemon */
+	fprintf(stderr, "np: --connect can only be used with -f, -j "
+			"and test specs\n");
+	exit(1);
+    }
+    if (mode == RUN && socket_path)
+    {
+	/* Try to have a resident daemon run the tests for us */
+	ec = np_daemon_run(socket_path, output_format, concurrency,
+			   argc-optind, (const char **)argv+optind);
+	if (ec >= 0)
+	    exit(ec);
+	/* no daemon, just run them ourselves */
+    }
+
     if (optind < argc)
     {
 	/* Some tests were specified on the commandline */
@@ -82,6 +194,10 @@ main(int argc, char **argv)
 	np_list_tests(runner, plan);
 	break;
 
+    case DAEMON:    /* Stay resident, running tests for clients */
+	ec = np_daemon_serve(socket_path);
+	break;
+
     case UNKNOWN:
     case RUN:	    /* Run the specified (or all the discovered) tests */
 	/* Set the output format */
@@ -98,6 +214,35 @@ main(int argc, char **argv)
 	if (concurrency >= 0)
 	    np_set_concurrency(runner, concurrency);
 
+	/* Set how long tests may run before being killed */
+	if (history_file)
+	    np_set_history_file(runner, history_file);
+	if (adaptive_timeouts)
+	    np_set_adaptive_timeouts(runner, timeout_multiple,
+				     timeout_floor, timeout_ceiling);
+
+	/* Limit how much memory parallel tests may use */
+	if (memory_budget)
+	    np_set_memory_budget(runner, memory_budget);
+
+	/* Limit how much of each test's output is kept */
+	if (output_keep >= 0 || output_limit)
+	    np_set_output_limits(runner, output_keep, output_limit);
+
+	/* Checkpoint results so an interrupted run can be resumed */
+	if (journal_file)
+	    np_set_journal_file(runner, journal_file, resume);
+
+	/* Keep every run's results for later analysis */
+	if (result_log)
+	    np_set_result_log(runner, result_log);
+
+	/* Let the run be watched while it's going */
+	if (metrics_socket)
+	    np_set_metrics_socket(runner, metrics_socket);
+	if (trace_file)
+	    np_set_trace_file(runner, trace_file);
+
 	/* Run the specified tests */
 	ec = np_run_tests(runner, plan);
 	break;
@@ -43,7 +43,19 @@ extern void np_set_concurrency(np_runner_t *, int);
 extern bool np_set_output_format(np_runner_t *, const char *);
 extern int np_run_tests(np_runner_t *, np_plan_t *);
 extern int np_get_timeout(void);   /* in seconds, or zero */
+extern void np_set_history_file(np_runner_t *, const char *);
+extern void np_set_adaptive_timeouts(np_runner_t *, float multiple,
+				     int floor, int ceiling);
+extern void np_set_memory_budget(np_runner_t *, int megabytes);
+extern void np_set_output_limits(np_runner_t *, int keep_kb, int limit_kb);
+extern void np_set_journal_file(np_runner_t *, const char *, int resume);
+extern void np_set_result_log(np_runner_t *, const char *);
+extern void np_set_metrics_socket(np_runner_t *, const char *);
+extern void np_set_trace_file(np_runner_t *, const char *);
 extern void np_done(np_runner_t *);
+extern int np_daemon_serve(const char *path);
+extern int np_daemon_run(const char *path, const char *format,
+			 int concurrency, int nspec, const char **specs);
 
 extern np_plan_t *np_plan_new(void);
 extern bool np_plan_add_specs(np_plan_t *, int nspec, const char **spec);
@@ -276,6 +288,86 @@ struct __np_param_dec
 	return &d; \
     }
 
+/**
+ * Statically declare the timeout for the tests in a file.
+ *
+ * @param secs	    timeout in seconds for each test
+ *
+ * Declares that every test function in the current file should be
+ * allowed to run for up to @a secs seconds before NovaProva decides
+ * it has hung and kills it, overriding both the default timeout and
+ * any timeout chosen automatically from previous run durations.  The
+ * timeout is multiplied by 3 when running under Valgrind.  For example:
+ * @code
+ * NP_TIMEOUT(120);
+ * @endcode
+ */
+#define NP_TIMEOUT(secs) \
+    static int __np_timeout(void) __attribute__((unused)); \
+    static int __np_timeout(void) \
+    { \
+	return (secs); \
+    }
+
+/**
+ * Statically declare the timeout for a single test.
+ *
+ * @param nm	    name of the test, i.e. the test function name
+ *		    without the @c test_ prefix
+ * @param secs	    timeout in seconds
+ *
+ * Like @c NP_TIMEOUT but applies only to the test named @a nm in
+ * the current file.  For example:
+ * @code
+ * static void test_soak(void) { ... }
+ * NP_TEST_TIMEOUT(soak, 300);
+ * @endcode
+ */
+#define NP_TEST_TIMEOUT(nm, secs) \
+    static int __np_timeout_##nm(void) __attribute__((unused)); \
+    static int __np_timeout_##nm(void) \
+    { \
+	return (secs); \
+    }
+
+/**
+ * Statically declare the memory needed by the tests in a file.
+ *
+ * @param mb	    expected peak memory use of each test, in megabytes
+ *
+ * Declares that every test function in the current file is expected
+ * to use up to @a mb megabytes of memory at its peak.  When a memory
+ * budget is set with @c np_set_memory_budget, this estimate is used
+ * instead of the peak memory use recorded on previous runs to decide
+ * when the test can be started.  For example:
+ * @code
+ * NP_MEMORY(512);
+ * @endcode
+ */
+#define NP_MEMORY(mb) \
+    static int __np_memory(void) __attribute__((unused)); \
+    static int __np_memory(void) \
+    { \
+	return (mb); \
+    }
+
+/**
+ * Statically declare the memory needed by a single test.
+ *
+ * @param nm	    name of the test, i.e. the test function name
+ *		    without the @c test_ prefix
+ * @param mb	    expected peak memory use, in megabytes
+ *
+ * Like @c NP_MEMORY but applies only to the test named @a nm in
+ * the current file.
+ */
+#define NP_TEST_MEMORY(nm, mb) \
+    static int __np_memory_##nm(void) __attribute__((unused)); \
+    static int __np_memory_##nm(void) \
+    { \
+	return (mb); \
+    }
+
 /**
  * Install a dynamic mock by function pointer.
  *
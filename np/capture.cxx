@@ -0,0 +1,86 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/capture.hxx"
+
+namespace np {
+using namespace std;
+
+void
+capture_t::append(const char *p, unsigned int len)
+{
+    unsigned int n;
+
+    total_ += len;
+    if (!keep_)
+    {
+	head_.append(p, len);
+	return;
+    }
+
+    if (head_.length() < keep_)
+    {
+	n = min(len, keep_ - (unsigned int)head_.length());
+	head_.append(p, n);
+	p += n;
+	len -= n;
+    }
+    if (!len)
+	return;
+
+    if (len >= keep_)
+    {
+	/* replaces the whole tail */
+	tail_.assign(p + len - keep_, keep_);
+	tailpos_ = 0;
+	return;
+    }
+    if (tail_.length() < keep_)
+    {
+	n = min(len, keep_ - (unsigned int)tail_.length());
+	tail_.append(p, n);
+	tailpos_ = 0;
+	p += n;
+	len -= n;
+    }
+    while (len)
+    {
+	n = min(len, keep_ - tailpos_);
+	tail_.replace(tailpos_, n, p, n);
+	tailpos_ = (tailpos_ + n) % keep_;
+	p += n;
+	len -= n;
+    }
+}
+
+string
+capture_t::get() const
+{
+    string s = head_;
+    uint64_t omitted = total_ - head_.length() - tail_.length();
+    if (omitted)
+    {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "\n[... %llu bytes omitted ...]\n",
+		 (unsigned long long)omitted);
+	s += buf;
+    }
+    s.append(tail_, tailpos_, string::npos);
+    s.append(tail_, 0, tailpos_);
+    return s;
+}
+
+// close the namespace
+};
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_CAPTURE_H__
+#define __NP_CAPTURE_H__ 1
+
+#include "np/util/common.hxx"
+
+namespace np {
+
+/*
+ * Accumulates the stdout or stderr of a test, as read from a pipe by
+ * the runner or from a capture file.  Only the first and the last
+ * keep bytes are retained, along with a count of the total, so that
+ * a test which prints gigabytes costs the runner no more memory than
+ * one which prints a few kilobytes.  A keep of 0 retains everything.
+ */
+class capture_t : public np::util::zalloc
+{
+public:
+    capture_t() : keep_(0), tailpos_(0), total_(0) {}
+
+    void set_keep(unsigned int keep) { keep_ = keep; }
+    unsigned int get_keep() const { return keep_; }
+    void append(const char *p, unsigned int len);
+    std::string get() const;
+    uint64_t get_total() const { return total_; }
+    bool is_truncated() const { return keep_ && total_ > 2 * (uint64_t)keep_; }
+
+private:
+    unsigned int keep_;
+    std::string head_;
+    std::string tail_;		/* a ring once it's full */
+    unsigned int tailpos_;	/* oldest byte in tail_ */
+    uint64_t total_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_CAPTURE_H__ */
@@ -13,37 +13,282 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "np/child.hxx"
 #include "np/testnode.hxx"
 #include "np/job.hxx"
 #include "np/event.hxx"
 #include "np/proxy_listener.hxx"
+#include "np/ring.hxx"
 #include "np_priv.h"
 
 namespace np {
 
-child_t::child_t(pid_t pid, int fd, job_t *j)
+child_t::child_t(pid_t pid, int fd, ring_t *ring, job_t *j)
  :  pid_(pid),
     event_pipe_(fd),
+    event_ring_(ring),
     job_(j),
     result_(R_UNKNOWN),
     state_(RUNNING)
 {
+    /* a child which stalls halfway through a frame mustn't
+     * hold up the runner */
+    fcntl(event_pipe_, F_SETFL, fcntl(event_pipe_, F_GETFL) | O_NONBLOCK);
+    output_fds_[0] = output_fds_[1] = -1;
 }
 
 child_t::~child_t()
 {
     close(event_pipe_);
+    for (int i = 0 ; i < 2 ; i++)
+	if (output_fds_[i] >= 0)
+	    close(output_fds_[i]);
+    ring_t::destroy(event_ring_);
     delete job_;
 }
 
+/*
+ * Capture the test's stdout and stderr from the read ends of pipes.
+ */
+void
+child_t::set_output_fds(int outfd, int errfd)
+{
+    output_fds_[0] = outfd;
+    output_fds_[1] = errfd;
+    for (int i = 0 ; i < 2 ; i++)
+    {
+	int fd = output_fds_[i];
+	if (fd >= 0)
+	    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+}
+
+void
+child_t::get_pollfds(struct pollfd *pfd) const
+{
+    memset(pfd, 0, NPOLLFDS * sizeof(struct pollfd));
+    /* poll() ignores negative fds */
+    pfd[0].fd = get_input_fd();
+    pfd[0].events = POLLIN;
+    for (int i = 0 ; i < 2 ; i++)
+    {
+	pfd[1+i].fd = output_fds_[i];
+	pfd[1+i].events = POLLIN;
+    }
+}
+
+void
+child_t::handle_poll(const struct pollfd *pfd)
+{
+    if ((pfd[0].revents & POLLIN))
+	handle_input();
+    for (int i = 0 ; i < 2 ; i++)
+    {
+	/* we need to see the EOF to close the pipe */
+	if ((pfd[1+i].revents & (POLLIN|POLLHUP|POLLERR)))
+	    read_output(i);
+    }
+}
+
+/*
+ * Read whatever is available on the stdout (@a i = 0) or stderr
+ * (@a i = 1) pipe without blocking.  Returns false if there was
+ * nothing to read.
+ */
+bool
+child_t::read_output(int i)
+{
+    char buf[16384];
+    int r;
+
+    if (output_fds_[i] < 0)
+	return false;
+
+    do
+	r = read(output_fds_[i], buf, sizeof(buf));
+    while (r < 0 && errno == EINTR);
+
+    if (r > 0)
+    {
+	capture_t *cap = (i ? job_->get_stderr_capture() : job_->get_stdout_capture());
+	cap->append(buf, r);
+	check_truncation(i);
+	check_limit();
+	return true;
+    }
+    if (r < 0 && errno == EAGAIN)
+	return false;
+    if (r < 0)
+	perror("np: error reading test output");
+    close(output_fds_[i]);
+    output_fds_[i] = -1;
+    return false;
+}
+
+/*
+ * Report, once per stream, that the captured output of stream @a i
+ * has started dropping bytes.
+ */
+void
+child_t::check_truncation(int i)
+{
+    capture_t *cap = (i ? job_->get_stderr_capture() : job_->get_stdout_capture());
+    char buf[256];
+
+    if (truncated_[i] || !cap->is_truncated())
+	return;
+    truncated_[i] = true;
+    snprintf(buf, sizeof(buf),
+	     "%s truncated, keeping the first and last %u KB",
+	     (i ? "stderr" : "stdout"), cap->get_keep() / 1024);
+    event_t ev(EV_TRUNCATED, buf);
+    merge_result(np::runner_t::running()->raise_event(job_, &ev));
+}
+
+static uint64_t
+file_size(const std::string &path)
+{
+    struct stat sb;
+
+    if (path == "" || stat(path.c_str(), &sb) < 0)
+	return 0;
+    return sb.st_size;
+}
+
+/*
+ * Fail the test, once, if it has written more than the hard limit.
+ * We keep reading so the child doesn't block on a full pipe.
+ */
+void
+child_t::check_limit()
+{
+    char buf[256];
+
+    if (over_limit_ || !output_limit_)
+	return;
+    uint64_t total = job_->get_stdout_capture()->get_total() +
+		     job_->get_stderr_capture()->get_total() +
+		     file_size(job_->get_stdout_path()) +
+		     file_size(job_->get_stderr_path());
+    if (total <= output_limit_)
+	return;
+    over_limit_ = true;
+    snprintf(buf, sizeof(buf),
+	     "Child process %d wrote more than %llu KB of output",
+	     (int)pid_, (unsigned long long)(output_limit_ / 1024));
+    event_t ev(EV_OUTLIMIT, buf);
+    merge_result(np::runner_t::running()->raise_event(job_, &ev));
+}
+
+/*
+ * Called before the runner sleeps; returns true if there are
+ * calls waiting in the ring, so it shouldn't.
+ */
+bool
+child_t::arm_ring()
+{
+    return (state_ != FINISHED && event_ring_ && event_ring_->arm());
+}
+
+void
+child_t::handle_ring()
+{
+    if (state_ == FINISHED || !event_ring_)
+	return;
+    ringbuf_.clear();
+    if (!event_ring_->get(ringbuf_))
+	return;
+    /* the ring only ever holds whole frames */
+    unsigned int used;
+    if (!proxy_listener_t::handle_frames(&ringbuf_[0], ringbuf_.size(),
+					 &used, job_, &result_))
+	state_ = FINISHED;
+}
+
+/*
+ * Read whatever is available on the event pipe without blocking,
+ * and handle any frames which are now complete.  Returns false
+ * if there was nothing to read.
+ */
+bool
+child_t::read_input()
+{
+    static const unsigned int chunk = 64*1024;
+    unsigned int len = inbuf_.size();
+    int r;
+
+    inbuf_.resize(len + chunk);
+    do
+	r = read(event_pipe_, &inbuf_[len], chunk);
+    while (r < 0 && errno == EINTR);
+    inbuf_.resize(len + (r > 0 ? r : 0));
+
+    if (r < 0 && errno == EAGAIN)
+	return false;
+
+    /* The child only turns to the pipe once the ring is full and
+     * never goes back, so whatever is still in the ring was sent
+     * before what we just read, and it may have got there since
+     * the ring was last looked at. */
+    int e = errno;
+    handle_ring();
+    if (state_ == FINISHED)
+	return true;
+    errno = e;
+
+    if (r < 0)
+    {
+	perror("np: error reading from proxy");
+	state_ = FINISHED;
+	return false;
+    }
+    if (r == 0)
+    {
+	/* EOF: the child has gone away */
+	if (inbuf_.size())
+	    fprintf(stderr, "np: unexpected EOF reading from proxy\n");
+	state_ = FINISHED;
+	return false;
+    }
+
+    unsigned int used;
+    if (!proxy_listener_t::handle_frames(&inbuf_[0], inbuf_.size(),
+					 &used, job_, &result_))
+	state_ = FINISHED;
+    inbuf_.erase(inbuf_.begin(), inbuf_.begin() + used);
+    return true;
+}
+
 void
 child_t::handle_input()
 {
+    handle_ring();
     if (state_ == FINISHED)
 	return;
-    if (!proxy_listener_t::handle_call(event_pipe_, job_, &result_))
-	state_ = FINISHED;
+    read_input();
+}
+
+/*
+ * Handle any calls and output still in flight after the child has
+ * exited.  We don't wait for EOF: the test might have left a grandchild
+ * holding the write end of the pipe open.
+ */
+void
+child_t::drain()
+{
+    handle_ring();
+    while (state_ != FINISHED && read_input())
+	;
+    for (int i = 0 ; i < 2 ; i++)
+    {
+	/* but don't let a grandchild keep us here forever either */
+	for (int n = 0 ; n < 64 && read_output(i) ; n++)
+	    ;
+    }
+    /* output captured to files can only be measured now */
+    check_limit();
 }
 
 void
@@ -54,8 +299,11 @@ child_t::handle_timeout(int64_t end)
     case RUNNING:
 	if (deadline_ <= end)
 	{
-	    static char buf[80];
-	    snprintf(buf, sizeof(buf), "Child process %d timed out, killing", (int)pid_);
+	    static char buf[256];
+	    snprintf(buf, sizeof(buf),
+		     "Child process %d timed out after %d sec (%s), killing",
+		     (int)pid_, job_->get_timeout(),
+		     job_->get_timeout_reason().c_str());
 	    event_t ev(EV_TIMEOUT, buf);
 	    merge_result(np::runner_t::running()->raise_event(job_, &ev));
 
@@ -19,31 +19,58 @@
 #include "np/util/common.hxx"
 #include "np/types.hxx"
 #include <sys/poll.h>
+#include <vector>
 
 namespace np {
 
 class job_t;
+class ring_t;
 
 class child_t : public np::util::zalloc
 {
 public:
-    child_t(pid_t pid, int fd, job_t *);
+    child_t(pid_t pid, int fd, ring_t *, job_t *);
     ~child_t();
 
     pid_t get_pid() const { return pid_; }
     job_t *get_job() const { return job_; }
     result_t get_result() const { return result_; }
 
+    void set_output_fds(int outfd, int errfd);
+    /* fail the test if it writes more than this many bytes to
+     * stdout and stderr combined; 0 means no limit */
+    void set_output_limit(uint64_t limit) { output_limit_ = limit; }
+
+    /* the event pipe, then stdout and stderr */
+    enum { NPOLLFDS = 3 };
+    void get_pollfds(struct pollfd *) const;
+    void handle_poll(const struct pollfd *);
+
     int get_input_fd() const { return (state_ == FINISHED ? -1 : event_pipe_); }
     void handle_input();
+    bool arm_ring();
+    void handle_ring();
+    void drain();
     int64_t get_deadline() const { return deadline_; }
     void set_deadline(int64_t d) { deadline_ = d; }
     void handle_timeout(int64_t);
     void merge_result(result_t r);
 
 private:
+    bool read_input();
+    bool read_output(int i);
+    void check_truncation(int i);
+    void check_limit();
+
     pid_t pid_;
     int event_pipe_;	    /* read end of the pipe */
+    ring_t *event_ring_;    /* shared with the child, may be NULL */
+    std::vector<char> ringbuf_;
+    std::vector<char> inbuf_;	/* partial frames read from the pipe */
+    int output_fds_[2];	    /* read ends of stdout, stderr pipes */
+    bool truncated_[2];	    /* we have reported truncation */
+    uint64_t output_limit_;
+    bool over_limit_;
     job_t *job_;
     result_t result_;
     enum {
@@ -0,0 +1,513 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include "np/daemon.hxx"
+#include "np/runner.hxx"
+#include "np/plan.hxx"
+#include "np/testmanager.hxx"
+#include "np/spiegel/platform/common.hxx"
+#include "np/util/tok.hxx"
+#include "np_priv.h"
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+/* how often to check whether the executable has changed, in ms */
+#define DAEMON_POLL_MS	1000
+/* how long a client may take to send each part of its request,
+ * in seconds; we serve one at a time so mustn't wait forever */
+#define DAEMON_CLIENT_TIMEOUT	5
+
+daemon_t::request_t::~request_t()
+{
+    if (outfd_ >= 0)
+	close(outfd_);
+    if (errfd_ >= 0)
+	close(errfd_);
+}
+
+daemon_t::daemon_t(const char *path)
+ :  path_(xstrdup(path)),
+    fd_(-1)
+{
+    struct stat sb;
+
+    exe_ = np::spiegel::platform::self_exe();
+    if (exe_ && stat(exe_, &sb) == 0)
+    {
+	exe_mtime_ = sb.st_mtime;
+	exe_size_ = sb.st_size;
+	build_id_ = np::spiegel::platform::get_build_id(exe_);
+    }
+}
+
+daemon_t::~daemon_t()
+{
+    if (fd_ >= 0)
+    {
+	close(fd_);
+	unlink(path_);
+    }
+    xfree(path_);
+    xfree(exe_);
+}
+
+static bool
+make_address(const char *path, struct sockaddr_un *sun)
+{
+    memset(sun, 0, sizeof(*sun));
+    sun->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sun->sun_path))
+    {
+	fprintf(stderr, "np: socket path too long: %s\n", path);
+	return false;
+    }
+    strcpy(sun->sun_path, path);
+    return true;
+}
+
+bool
+daemon_t::listen()
+{
+    struct sockaddr_un sun;
+
+    if (!make_address(path_, &sun))
+	return false;
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0)
+    {
+	perror("np: socket");
+	return false;
+    }
+    fcntl(fd_, F_SETFD, FD_CLOEXEC);
+
+    if (bind(fd_, (struct sockaddr *)&sun, sizeof(sun)) < 0)
+    {
+	if (errno != EADDRINUSE)
+	{
+	    perror(path_);
+	    goto error;
+	}
+	/* Someone left a socket behind; if nobody is listening
+	 * on it then it's stale and we can take it over. */
+	int cfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	int r = connect(cfd, (struct sockaddr *)&sun, sizeof(sun));
+	close(cfd);
+	if (r == 0)
+	{
+	    fprintf(stderr, "np: a daemon is already listening on %s\n", path_);
+	    goto error;
+	}
+	unlink(path_);
+	if (bind(fd_, (struct sockaddr *)&sun, sizeof(sun)) < 0)
+	{
+	    perror(path_);
+	    goto error;
+	}
+    }
+
+    if (::listen(fd_, 5) < 0)
+    {
+	perror("np: listen");
+	unlink(path_);
+	goto error;
+    }
+    return true;
+
+error:
+    close(fd_);
+    fd_ = -1;
+    return false;
+}
+
+bool
+daemon_t::exe_changed(bool check_build_id) const
+{
+    struct stat sb;
+
+    if (!exe_)
+	return false;
+    if (stat(exe_, &sb) < 0)
+	return true;	/* deleted, probably being relinked */
+    if (sb.st_mtime != exe_mtime_ || sb.st_size != exe_size_)
+	return true;
+    if (check_build_id &&
+	np::spiegel::platform::get_build_id(exe_) != build_id_)
+	return true;
+    return false;
+}
+
+int
+daemon_t::serve()
+{
+    if (!listen())
+	return 1;
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "np: daemon listening on %s\n", path_);
+
+    for (;;)
+    {
+	struct pollfd pfd;
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = fd_;
+	pfd.events = POLLIN;
+	int r = poll(&pfd, 1, DAEMON_POLL_MS);
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    perror("np: poll");
+	    return 1;
+	}
+	if (r == 0)
+	{
+	    if (exe_changed(false))
+		break;
+	    continue;
+	}
+
+	int cfd = accept(fd_, NULL, NULL);
+	if (cfd < 0)
+	{
+	    if (errno != EINTR && errno != ECONNABORTED)
+		perror("np: accept");
+	    continue;
+	}
+	fcntl(cfd, F_SETFD, FD_CLOEXEC);
+	handle_client(cfd);
+	close(cfd);
+	if (exe_changed(false))
+	    break;
+    }
+
+    fprintf(stderr, "np: executable %s has changed, daemon exiting\n", exe_);
+    return 0;
+}
+
+static void
+reply(int fd, const string &s)
+{
+    string line = s + "\n";
+    write(fd, line.c_str(), line.length());
+}
+
+void
+daemon_t::handle_client(int cfd)
+{
+    request_t req;
+    string buf;
+    char data[1024];
+    char control[CMSG_SPACE(2*sizeof(int))];
+    struct timeval tv;
+
+    memset(&tv, 0, sizeof(tv));
+    tv.tv_sec = DAEMON_CLIENT_TIMEOUT;
+    if (setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+    {
+	perror("np: setsockopt");
+	return;
+    }
+
+    for (;;)
+    {
+	struct iovec iov;
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = data;
+	iov.iov_len = sizeof(data);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t r = recvmsg(cfd, &msg, MSG_CMSG_CLOEXEC);
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		fprintf(stderr, "np: client took too long to send a request\n");
+	    else
+		perror("np: recvmsg");
+	    return;
+	}
+	if (r == 0)
+	    return;	/* client went away */
+
+	struct cmsghdr *cmsg;
+	for (cmsg = CMSG_FIRSTHDR(&msg) ; cmsg ; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+	    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+		continue;
+	    int *fds = (int *)CMSG_DATA(cmsg);
+	    unsigned int nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+	    for (unsigned int i = 0 ; i < nfds ; i++)
+	    {
+		if (req.outfd_ < 0)
+		    req.outfd_ = fds[i];
+		else if (req.errfd_ < 0)
+		    req.errfd_ = fds[i];
+		else
+		    close(fds[i]);
+	    }
+	}
+
+	buf.append(data, r);
+	size_t nl;
+	while ((nl = buf.find('\n')) != string::npos)
+	{
+	    string line = buf.substr(0, nl);
+	    buf.erase(0, nl+1);
+
+	    tok_t tok(line.c_str(), " \t");
+	    const char *cmd = tok.next();
+	    const char *arg = tok.next();
+	    if (!cmd)
+		continue;
+	    if (!strcmp(cmd, "format") && arg)
+		req.formats_.push_back(arg);
+	    else if (!strcmp(cmd, "jobs") && arg)
+		req.concurrency_ = atoi(arg);
+	    else if (!strcmp(cmd, "spec") && arg)
+		req.specs_.push_back(arg);
+	    else if (!strcmp(cmd, "run"))
+	    {
+		if (exe_changed(true))
+		{
+		    reply(cfd, "retry");
+		    return;
+		}
+		string err;
+		int ec = run_request(req, err);
+		if (ec < 0)
+		    reply(cfd, "error " + err);
+		else
+		    reply(cfd, "exit " + dec(ec));
+		return;
+	    }
+	    else
+	    {
+		reply(cfd, "error bad request: " + line);
+		return;
+	    }
+	}
+    }
+}
+
+int
+daemon_t::run_request(request_t &req, string &err)
+{
+    int ec = -1;
+    int saved_out = -1;
+    int saved_err = -1;
+    runner_t *runner = 0;
+    plan_t *plan = 0;
+    vector<string>::iterator i;
+
+    if (req.outfd_ < 0 || req.errfd_ < 0)
+    {
+	err = "no output descriptors";
+	return -1;
+    }
+
+    /* Send our output to the client while running its plan */
+    fflush(stdout);
+    fflush(stderr);
+    saved_out = dup(STDOUT_FILENO);
+    saved_err = dup(STDERR_FILENO);
+    dup2(req.outfd_, STDOUT_FILENO);
+    dup2(req.errfd_, STDERR_FILENO);
+
+    runner = new runner_t;
+    for (i = req.formats_.begin() ; i != req.formats_.end() ; ++i)
+    {
+	if (!np_set_output_format(runner, i->c_str()))
+	{
+	    err = "unknown output format " + *i;
+	    goto out;
+	}
+    }
+    if (req.concurrency_ >= 0)
+	runner->set_concurrency(req.concurrency_);
+
+    if (req.specs_.size())
+    {
+	plan = new plan_t;
+	for (i = req.specs_.begin() ; i != req.specs_.end() ; ++i)
+	{
+	    const char *spec = i->c_str();
+	    if (!plan->add_specs(1, &spec))
+	    {
+		err = "no such test " + *i;
+		goto out;
+	    }
+	}
+    }
+
+    ec = runner->run_tests(plan);
+
+out:
+    delete plan;
+    delete runner;
+    fflush(stdout);
+    fflush(stderr);
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    close(saved_out);
+    close(saved_err);
+    return ec;
+}
+
+/*
+ * Client side.  Returns the exit code from the daemon, or -1 if
+ * there is no usable daemon and the caller should run the tests
+ * itself.
+ */
+int
+daemon_t::run_remote(const char *path, const char *format,
+		     int concurrency, int nspec, const char **specs)
+{
+    struct sockaddr_un sun;
+    int fd;
+    string req;
+    string resp;
+    char buf[256];
+    ssize_t r;
+
+    if (!make_address(path, &sun))
+	return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+	perror("np: socket");
+	return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0)
+    {
+	close(fd);
+	return -1;
+    }
+
+    if (format)
+	req += string("format ") + format + "\n";
+    if (concurrency >= 0)
+	req += "jobs " + dec(concurrency) + "\n";
+    for (int i = 0 ; i < nspec ; i++)
+	req += string("spec ") + specs[i] + "\n";
+    if (req.length())
+	write(fd, req.c_str(), req.length());
+
+    /* send our stdout and stderr along with the run command */
+    static const char run[] = "run\n";
+    int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    iov.iov_base = (void *)run;
+    iov.iov_len = sizeof(run)-1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    fflush(stdout);
+    fflush(stderr);
+    if (sendmsg(fd, &msg, 0) < 0)
+    {
+	perror("np: sendmsg");
+	close(fd);
+	return -1;
+    }
+
+    while ((r = read(fd, buf, sizeof(buf))) > 0)
+	resp.append(buf, r);
+    close(fd);
+
+    if (!strncmp(resp.c_str(), "exit ", 5))
+	return atoi(resp.c_str()+5);
+    if (!strncmp(resp.c_str(), "error ", 6))
+    {
+	fprintf(stderr, "np: daemon: %s", resp.c_str()+6);
+	return 1;
+    }
+    /* "retry", or the daemon died */
+    return -1;
+}
+
+// close the namespace
+};
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+using namespace np;
+
+/**
+ * Serve test plans to clients until the executable changes.
+ *
+ * @param path	    filename of the Unix domain socket to listen on
+ * @return	    exit code for the process
+ *
+ * Keeps the process resident after @c np_init, so that repeated runs
+ * of the same test executable (for example while bisecting or doing
+ * TDD) don't have to repeat the startup work of discovering tests.
+ * Each plan received from a client is run by a new runner object with
+ * the client's output format, concurrency and test specifications,
+ * and with output going to the client's stdout and stderr.  Returns
+ * when the executable file is modified or replaced.
+ */
+extern "C" int
+np_daemon_serve(const char *path)
+{
+    np::testmanager_t::instance();
+    daemon_t *d = new daemon_t(path);
+    int ec = d->serve();
+    delete d;
+    return ec;
+}
+
+/**
+ * Run tests in a resident daemon.
+ *
+ * @param path		filename of the daemon's Unix domain socket
+ * @param format	output format or NULL for the default
+ * @param concurrency	concurrency value, or -1 for the default
+ * @param nspec		number of test specifications
+ * @param specs		array of test specifications
+ * @return		0 on success, non-zero if any tests failed, or -1
+ *			if there is no usable daemon
+ *
+ * Asks a daemon started with @c np_daemon_serve to run tests, with
+ * the results being emitted to the caller's stdout and stderr.  When
+ * this returns -1 the caller should run the tests itself, e.g. because
+ * the daemon is not running or the executable has been rebuilt.
+ */
+extern "C" int
+np_daemon_run(const char *path, const char *format, int concurrency,
+	      int nspec, const char **specs)
+{
+    return daemon_t::run_remote(path, format, concurrency, nspec, specs);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_DAEMON_H__
+#define __NP_DAEMON_H__ 1
+
+#include "np/util/common.hxx"
+#include <vector>
+
+namespace np {
+
+/*
+ * Keeps a test executable resident after discovery, accepting plans
+ * from clients over a Unix domain socket and running each one with
+ * a fresh runner_t but the already-built testmanager_t state.
+ *
+ * The protocol is line based.  The client sends any number of
+ *
+ *	format NAME
+ *	jobs N
+ *	spec SPEC
+ *
+ * lines followed by a "run" line, which carries the client's stdout
+ * and stderr file descriptors as SCM_RIGHTS ancillary data.  The
+ * daemon runs the tests with its output going to those descriptors
+ * and replies with "exit N", or with "error MESSAGE", or with "retry"
+ * if the executable has changed and the client should run the tests
+ * itself.  Clients are served one at a time, so one which stops
+ * sending before "run" is dropped after a few seconds.
+ */
+class daemon_t : public np::util::zalloc
+{
+public:
+    daemon_t(const char *path);
+    ~daemon_t();
+
+    int serve();
+
+    /* client side */
+    static int run_remote(const char *path, const char *format,
+			  int concurrency, int nspec, const char **specs);
+
+private:
+    struct request_t
+    {
+	request_t() : concurrency_(-1), outfd_(-1), errfd_(-1) {}
+	~request_t();
+
+	std::vector<std::string> formats_;
+	int concurrency_;
+	std::vector<std::string> specs_;
+	int outfd_;
+	int errfd_;
+    };
+
+    bool listen();
+    bool exe_changed(bool check_build_id) const;
+    void handle_client(int fd);
+    int run_request(request_t &req, std::string &err);
+
+    char *path_;
+    int fd_;
+    char *exe_;
+    time_t exe_mtime_;
+    off_t exe_size_;
+    std::string build_id_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_DAEMON_H__ */
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/discovery_cache.hxx"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+static inline uint64_t
+pad8(uint64_t n)
+{
+    return (n + 7) & ~(uint64_t)7;
+}
+
+/* FNV-1a, just to give each identity its own file name */
+static uint64_t
+hash_identity(const string &identity)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (string::const_iterator i = identity.begin() ; i != identity.end() ; ++i)
+    {
+	h ^= (unsigned char)*i;
+	h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+discovery_cache_t::discovery_cache_t(const char *directory,
+				     const string &identity)
+ :  directory_(xstrdup(directory)),
+    identity_(identity)
+{
+    char buf[PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s/%016llx.npdc", directory,
+	     (unsigned long long)hash_identity(identity));
+    filename_ = xstrdup(buf);
+}
+
+discovery_cache_t::~discovery_cache_t()
+{
+    xfree(directory_);
+    xfree(filename_);
+}
+
+void
+discovery_cache_t::add_function(functype_t type,
+				np::spiegel::dwarf::reference_t function,
+				np::spiegel::dwarf::reference_t target,
+				const char *submatch)
+{
+    function_t f;
+    f.type_ = type;
+    f.function_ = function;
+    f.target_ = target;
+    f.submatch_ = (submatch ? submatch : "");
+    functions_.push_back(f);
+}
+
+bool
+discovery_cache_t::parse(const char *base, uint64_t size)
+{
+    const header_t *hdr = (const header_t *)base;
+    if (size < sizeof(header_t) || hdr->magic_ != MAGIC)
+	return false;
+    /* an older format, or someone else's program which hashed
+     * to the same name; either way it'll be replaced */
+    if (hdr->version_ != VERSION ||
+	hdr->identity_length_ != identity_.length() ||
+	size < sizeof(header_t) + hdr->identity_length_ ||
+	memcmp(base + sizeof(header_t), identity_.c_str(), identity_.length()))
+	return true;
+
+    uint64_t off = pad8(sizeof(header_t) + hdr->identity_length_ + 1);
+    const function_record_t *frec = (const function_record_t *)(base + off);
+    off += pad8((uint64_t)hdr->nfunctions_ * sizeof(function_record_t));
+    const range_record_t *rrec = (const range_record_t *)(base + off);
+    off += pad8((uint64_t)hdr->nranges_ * sizeof(range_record_t));
+    const char *strings = base + off;
+    off += hdr->strings_length_;
+    if (off != size || (hdr->strings_length_ && strings[hdr->strings_length_-1]))
+	return false;
+
+    for (uint32_t i = 0 ; i < hdr->nfunctions_ ; i++)
+    {
+	if (frec[i].submatch_ >= hdr->strings_length_)
+	    return false;
+	add_function((functype_t)frec[i].type_, frec[i].function_,
+		     frec[i].target_, strings + frec[i].submatch_);
+    }
+    for (uint32_t i = 0 ; i < hdr->nranges_ ; i++)
+	ranges_.push_back(address_range_t(rrec[i].lo_, rrec[i].hi_,
+					  rrec[i].funcref_));
+    return true;
+}
+
+bool
+discovery_cache_t::load()
+{
+    int fd;
+    struct stat sb;
+    void *map;
+    bool r;
+
+    functions_.clear();
+    ranges_.clear();
+
+    fd = open(filename_, O_RDONLY, 0);
+    if (fd < 0)
+    {
+	/* a missing file just means this program hasn't been seen */
+	if (errno != ENOENT)
+	    perror(filename_);
+	return false;
+    }
+    if (fstat(fd, &sb) < 0)
+    {
+	perror(filename_);
+	close(fd);
+	return false;
+    }
+    if (!sb.st_size)
+    {
+	close(fd);
+	return false;
+    }
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+	perror(filename_);
+	return false;
+    }
+
+    r = parse((const char *)map, sb.st_size);
+    munmap(map, sb.st_size);
+    if (!r)
+    {
+	fprintf(stderr, "np: ignoring bad discovery cache %s\n", filename_);
+	functions_.clear();
+	ranges_.clear();
+    }
+    return (functions_.size() > 0);
+}
+
+/*
+ * Write the whole file under a temporary name and rename it into
+ * place, so that concurrent runs only ever see complete files.
+ */
+bool
+discovery_cache_t::save() const
+{
+    string strings;
+    vector<function_record_t> frecs;
+    vector<function_t>::const_iterator fi;
+    for (fi = functions_.begin() ; fi != functions_.end() ; ++fi)
+    {
+	function_record_t rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.type_ = fi->type_;
+	rec.submatch_ = strings.length();
+	rec.function_ = fi->function_;
+	rec.target_ = fi->target_;
+	frecs.push_back(rec);
+	strings.append(fi->submatch_.c_str(), fi->submatch_.length()+1);
+    }
+
+    vector<range_record_t> rrecs;
+    vector<address_range_t>::const_iterator ri;
+    for (ri = ranges_.begin() ; ri != ranges_.end() ; ++ri)
+    {
+	range_record_t rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.lo_ = ri->lo_;
+	rec.hi_ = ri->hi_;
+	rec.funcref_ = ri->funcref_;
+	rrecs.push_back(rec);
+    }
+
+    header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic_ = MAGIC;
+    hdr.version_ = VERSION;
+    hdr.identity_length_ = identity_.length();
+    hdr.nfunctions_ = frecs.size();
+    hdr.nranges_ = rrecs.size();
+    hdr.strings_length_ = strings.length();
+
+    string buf((const char *)&hdr, sizeof(hdr));
+    buf.append(identity_.c_str(), identity_.length()+1);
+    buf.resize(pad8(buf.length()), '\0');
+    if (frecs.size())
+	buf.append((const char *)&frecs[0], frecs.size() * sizeof(function_record_t));
+    buf.resize(pad8(buf.length()), '\0');
+    if (rrecs.size())
+	buf.append((const char *)&rrecs[0], rrecs.size() * sizeof(range_record_t));
+    buf.resize(pad8(buf.length()), '\0');
+    buf += strings;
+
+    if (mkdir(directory_, 0777) < 0 && errno != EEXIST)
+    {
+	perror(directory_);
+	return false;
+    }
+
+    char tmpfile[PATH_MAX];
+    snprintf(tmpfile, sizeof(tmpfile), "%s.%d.tmp", filename_, (int)getpid());
+    int fd = open(tmpfile, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd < 0)
+    {
+	perror(tmpfile);
+	return false;
+    }
+    if (write(fd, buf.c_str(), buf.length()) != (ssize_t)buf.length())
+    {
+	perror(tmpfile);
+	close(fd);
+	unlink(tmpfile);
+	return false;
+    }
+    close(fd);
+    if (rename(tmpfile, filename_) < 0)
+    {
+	perror(filename_);
+	unlink(tmpfile);
+	return false;
+    }
+    return true;
+}
+
+// close the namespace
+};
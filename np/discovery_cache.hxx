@@ -0,0 +1,111 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_DISCOVERY_CACHE_H__
+#define __NP_DISCOVERY_CACHE_H__ 1
+
+#include "np/util/common.hxx"
+#include "np/types.hxx"
+#include "np/spiegel/dwarf/state.hxx"
+#include <vector>
+
+namespace np {
+
+/*
+ * Remembers what testmanager_t::discover_functions() found in a
+ * program, so that running the same program again needn't walk all
+ * its DWARF info.  That's the functions which went into the test
+ * tree, with how they were classified, and the address index.
+ * Functions are kept as DWARF references, which don't change for
+ * as long as the program doesn't.
+ *
+ * Each program gets a file in the cache directory, named for a hash
+ * of the program's identity (see state_t::get_identity()).  The
+ * identity is also kept in the file, and a file for a different
+ * identity is just ignored and later replaced.  The file is a
+ * header_t, the identity and a NUL padded to 8 bytes, the
+ * function_record_ts, the range_record_ts and then the strings they
+ * refer to.  All numbers are in the byte order of the machine which
+ * wrote them.
+ */
+class discovery_cache_t : public np::util::zalloc
+{
+public:
+    enum
+    {
+	MAGIC = 0x4344504e,	/* "NPDC" */
+	VERSION = 1,
+    };
+
+    struct header_t
+    {
+	uint32_t magic_;
+	uint32_t version_;
+	uint32_t identity_length_;	/* not including the NUL */
+	uint32_t nfunctions_;
+	uint32_t nranges_;
+	uint32_t strings_length_;
+    };
+    struct function_record_t
+    {
+	uint32_t type_;			/* a functype_t */
+	uint32_t submatch_;		/* offset into the strings */
+	np::spiegel::dwarf::reference_t function_;
+	np::spiegel::dwarf::reference_t target_;    /* if a mock */
+    };
+    struct range_record_t
+    {
+	uint64_t lo_;
+	uint64_t hi_;
+	np::spiegel::dwarf::reference_t funcref_;
+    };
+
+    discovery_cache_t(const char *directory, const std::string &identity);
+    ~discovery_cache_t();
+
+    /* returns false if there's nothing cached for this identity */
+    bool load();
+    bool save() const;
+
+    struct function_t
+    {
+	functype_t type_;
+	np::spiegel::dwarf::reference_t function_;
+	np::spiegel::dwarf::reference_t target_;
+	std::string submatch_;
+    };
+    void add_function(functype_t type,
+		      np::spiegel::dwarf::reference_t function,
+		      np::spiegel::dwarf::reference_t target,
+		      const char *submatch);
+    const std::vector<function_t> &get_functions() const { return functions_; }
+
+    typedef np::spiegel::dwarf::state_t::address_range_t address_range_t;
+    std::vector<address_range_t> &get_ranges() { return ranges_; }
+
+private:
+    bool parse(const char *base, uint64_t size);
+
+    char *directory_;
+    char *filename_;
+    std::string identity_;
+    std::vector<function_t> functions_;
+    std::vector<address_range_t> ranges_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_DISCOVERY_CACHE_H__ */
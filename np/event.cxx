@@ -21,7 +21,11 @@ using namespace np::util;
 
 event_t &event_t::with_stack()
 {
-    string trace = np::spiegel::describe_stacktrace();
+    return with_stack(np::spiegel::describe_stacktrace());
+}
+
+event_t &event_t::with_stack(const string &trace)
+{
     if (trace.length())
     {
 	/* only clobber `function' if we have something better */
@@ -120,6 +124,23 @@ event_t::normalise() const
 	    norm.locflags |= LT_STACK;
 	    norm.function = xstr(function);
 	}
+	if (locflags & LT_ADDRESSES)
+	{
+	    vector<np::spiegel::addr_t> stack;
+	    const char *p = xstr(function);
+	    char *end;
+	    for (;;)
+	    {
+		unsigned long addr = strtoul(p, &end, 16);
+		if (end == p)
+		    break;
+		stack.push_back(addr);
+		p = end;
+	    }
+	    funcbuf = np::spiegel::describe_stacktrace(stack);
+	    norm.locflags |= LT_STACK;
+	    norm.function = funcbuf.c_str();
+	}
     }
 
     return &norm;
@@ -138,6 +159,7 @@ event_t::get_result() const
     case EV_SLMATCH:
     case EV_TIMEOUT:
     case EV_FDLEAK:
+    case EV_OUTLIMIT:
 	return R_FAIL;
     case EV_EXPASS:
 	return R_PASS;
@@ -161,7 +183,7 @@ event_t::which_as_string() const
 	"NONE", "ASSERT", "EXIT", "SIGNAL",
 	"SYSLOG", "FIXTURE", "EXPASS", "EXFAIL",
 	"EXNA", "VALGRIND", "SLMATCH", "TIMEOUT",
-	"FDLEAK"
+	"FDLEAK", "TRUNCATED", "OUTLIMIT"
     };
     const char *wstr = ((unsigned)which < arraysize(whichstrs))
 			? whichstrs[(unsigned)which] : "unknown";
@@ -37,6 +37,8 @@ enum events_t
     EV_SLMATCH,		/* syslog matching */
     EV_TIMEOUT,		/* child took too long */
     EV_FDLEAK,		/* file descriptor leak */
+    EV_TRUNCATED,	/* captured output was truncated */
+    EV_OUTLIMIT,	/* CuT wrote too much output */
 };
 
 class event_t
@@ -51,8 +53,9 @@ public:
 	LT_SPIEGELFUNC	= (1<<3),   /* function */
 	LT_STACK	= (1<<4),   /* function */
 	LT_FUNCTYPE	= (1<<5),   /* functype */
+	LT_ADDRESSES	= (1<<6),   /* function */
 
-	LT__function	= (LT_FUNCNAME|LT_SPIEGELFUNC|LT_STACK)
+	LT__function	= (LT_FUNCNAME|LT_SPIEGELFUNC|LT_STACK|LT_ADDRESSES)
     };
 
     // default c'tor
@@ -131,6 +134,17 @@ public:
 	return *this;
     }
     event_t &with_stack();
+    event_t &with_stack(const std::string &trace);
+    /* A stack trace as hex addresses, one to a line, which
+     * normalise() will describe.  For signal handlers, which
+     * can't safely describe them themselves. */
+    event_t &with_addresses(const char *addrs)
+    {
+	locflags &= ~LT__function;
+	locflags |= LT_ADDRESSES;
+	function = addrs;
+	return *this;
+    }
 
     event_t *clone() const;
     const event_t *normalise() const;
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/grouped_listener.hxx"
+#include "np/job.hxx"
+#include "np/event.hxx"
+
+namespace np {
+using namespace std;
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+grouped_listener_t::grouped_listener_t()
+ :  progress_(false),
+    progress_shown_(false),
+    nrun_(0),
+    nfailed_(0)
+{
+}
+
+/*
+ * Write @a block to stderr with as few write() calls as possible,
+ * replacing the progress line if there is one.
+ */
+void
+grouped_listener_t::emit(const string &block)
+{
+    string s;
+
+    if (progress_shown_)
+	s += "\r\033[K";
+    s += block;
+    if (progress_)
+    {
+	char buf[128];
+	snprintf(buf, sizeof(buf), "np: %u run %u failed %u running",
+		 nrun_, nfailed_, (unsigned int)blocks_.size());
+	s += buf;
+	progress_shown_ = true;
+    }
+
+    fflush(stderr);
+    const char *p = s.c_str();
+    size_t remain = s.length();
+    while (remain)
+    {
+	ssize_t r = write(STDERR_FILENO, p, remain);
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	p += r;
+	remain -= r;
+    }
+}
+
+void
+grouped_listener_t::begin()
+{
+    nrun_ = 0;
+    nfailed_ = 0;
+    progress_ = !!isatty(STDERR_FILENO);
+    emit("np: running\n");
+}
+
+void
+grouped_listener_t::end()
+{
+    char buf[128];
+
+    /* no more progress line */
+    progress_ = false;
+    snprintf(buf, sizeof(buf), "np: %u run %u failed\n", nrun_, nfailed_);
+    emit(buf);
+}
+
+void
+grouped_listener_t::begin_job(const job_t *j)
+{
+    blocks_[j] = string("np: running: \"") + j->as_string() + "\"\n";
+    if (progress_)
+	emit("");
+}
+
+void
+grouped_listener_t::add_event(const job_t *j, const event_t *ev)
+{
+    string s = string("EVENT ") +
+		ev->as_string() +
+	       "\n" +
+	       ev->get_long_location() +
+	       "\n";
+
+    map<const job_t*, string>::iterator itr = blocks_.find(j);
+    if (itr == blocks_.end())
+	emit(s);	/* not from any job we know about */
+    else
+	itr->second += s;
+}
+
+void
+grouped_listener_t::end_job(const job_t *j, result_t res)
+{
+    string s;
+    string nm = j->as_string();
+    char buf[64];
+
+    map<const job_t*, string>::iterator itr = blocks_.find(j);
+    if (itr != blocks_.end())
+    {
+	s = itr->second;
+	blocks_.erase(itr);
+    }
+    s += j->get_stdout();
+    s += j->get_stderr();
+    if (s.length() && s[s.length()-1] != '\n')
+	s += "\n";
+
+    nrun_++;
+    switch (res)
+    {
+    case R_PASS:
+	s += "PASS " + nm + "\n";
+	break;
+    case R_NOTAPPLICABLE:
+	s += "N/A " + nm + "\n";
+	break;
+    case R_FAIL:
+	nfailed_++;
+	s += "FAIL " + nm + "\n";
+	break;
+    default:
+	snprintf(buf, sizeof(buf), "??? (result %d) ", res);
+	s += buf + nm + "\n";
+	break;
+    }
+    emit(s);
+}
+
+// close the namespace
+};
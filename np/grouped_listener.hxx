@@ -0,0 +1,56 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_GROUPED_LISTENER_H__
+#define __NP_GROUPED_LISTENER_H__ 1
+
+#include "np/listener.hxx"
+#include <map>
+
+namespace np {
+
+/*
+ * Like text_listener_t, but each job's events and captured output are
+ * held until the job ends and then written to stderr as one block, so
+ * that jobs running in parallel don't interleave.  If stderr is a
+ * terminal, a single progress line is kept updated below the blocks.
+ */
+class grouped_listener_t : public listener_t
+{
+public:
+    grouped_listener_t();
+    ~grouped_listener_t() {}
+
+    bool needs_stdout() const { return true; }
+    void begin();
+    void end();
+    void begin_job(const job_t *);
+    void end_job(const job_t *, result_t);
+    void add_event(const job_t *, const event_t *ev);
+
+private:
+    void emit(const std::string &block);
+
+    std::map<const job_t*, std::string> blocks_;
+    bool progress_;
+    bool progress_shown_;
+    unsigned int nrun_;
+    unsigned int nfailed_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_GROUPED_LISTENER_H__ */
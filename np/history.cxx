@@ -0,0 +1,434 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include "np/history.hxx"
+#include "np/spiegel/platform/common.hxx"
+#include "np/util/tok.hxx"
+#include <algorithm>
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+static const char header[] =
+    "# novaprova job history: name elapsed_ns peak_rss_kb result\n";
+
+history_t::history_t(const char *filename)
+ :  filename_(xstrdup(filename)),
+    fd_(-1)
+{
+    /* The executable's path rather than its build ID, so
+     * that the history carries over when it's rebuilt */
+    char *exe = np::spiegel::platform::self_exe();
+    if (exe)
+	exe_ = exe;
+    xfree(exe);
+}
+
+history_t::~history_t()
+{
+    if (fd_ >= 0)
+	close(fd_);
+    xfree(filename_);
+}
+
+static result_t
+parse_result(const char *s)
+{
+    static const result_t results[] = { R_PASS, R_NOTAPPLICABLE, R_FAIL };
+    /* lines from before results were recorded were all passes */
+    if (!s)
+	return R_PASS;
+    for (unsigned int i = 0 ; i < sizeof(results)/sizeof(results[0]) ; i++)
+    {
+	if (!strcmp(s, as_string(results[i])))
+	    return results[i];
+    }
+    return R_UNKNOWN;
+}
+
+bool
+history_t::load()
+{
+    FILE *fp;
+    char buf[PATH_MAX+64];
+    const char *name;
+    const char *elapsed;
+    const char *rss;
+    jobs_t *jobs = &exes_[exe_];
+
+    fp = fopen(filename_, "r");
+    if (!fp)
+    {
+	/* a missing file just means we have no history yet */
+	if (errno == ENOENT)
+	    return true;
+	perror(filename_);
+	return false;
+    }
+
+    while (fgets(buf, sizeof(buf), fp))
+    {
+	if (buf[0] == '@')
+	{
+	    /* start of the section for an executable */
+	    name = buf+1;
+	    while (*name == ' ')
+		name++;
+	    buf[strcspn(buf, "\r\n")] = '\0';
+	    jobs = &exes_[name];
+	    continue;
+	}
+	tok_t tok(buf, " \t\r\n");
+	name = tok.next();
+	if (!name || name[0] == '#')
+	    continue;
+	elapsed = tok.next();
+	if (!elapsed)
+	    continue;
+	rss = tok.next();
+	add(*jobs, name, sample_t(strtoll(elapsed, NULL, 10),
+				  (rss ? strtol(rss, NULL, 10) : 0),
+				  parse_result(tok.next())));
+	nlines_++;
+    }
+
+    fclose(fp);
+    return true;
+}
+
+bool
+history_t::save() const
+{
+    string tmpfile = string(filename_) + ".tmp";
+    FILE *fp;
+
+    fp = fopen(tmpfile.c_str(), "w");
+    if (!fp)
+    {
+	perror(tmpfile.c_str());
+	return false;
+    }
+
+    fputs(header, fp);
+    map<string, jobs_t>::const_iterator eitr;
+    for (eitr = exes_.begin() ; eitr != exes_.end() ; ++eitr)
+    {
+	if (!eitr->second.size())
+	    continue;
+	fprintf(fp, "@ %s\n", eitr->first.c_str());
+	jobs_t::const_iterator jitr;
+	for (jitr = eitr->second.begin() ; jitr != eitr->second.end() ; ++jitr)
+	{
+	    deque<sample_t>::const_iterator sitr;
+	    for (sitr = jitr->second.begin() ; sitr != jitr->second.end() ; ++sitr)
+		fprintf(fp, "%s %lld %ld %s\n", jitr->first.c_str(),
+			(long long)sitr->elapsed_, sitr->rss_,
+			as_string(sitr->result_));
+	}
+    }
+
+    if (fclose(fp) < 0)
+    {
+	perror(tmpfile.c_str());
+	unlink(tmpfile.c_str());
+	return false;
+    }
+    if (rename(tmpfile.c_str(), filename_) < 0)
+    {
+	perror(filename_);
+	unlink(tmpfile.c_str());
+	return false;
+    }
+    return true;
+}
+
+unsigned int
+history_t::count_kept() const
+{
+    unsigned int nkept = 0;
+    map<string, jobs_t>::const_iterator eitr;
+    for (eitr = exes_.begin() ; eitr != exes_.end() ; ++eitr)
+    {
+	jobs_t::const_iterator jitr;
+	for (jitr = eitr->second.begin() ; jitr != eitr->second.end() ; ++jitr)
+	    nkept += jitr->second.size();
+    }
+    return nkept;
+}
+
+/*
+ * Returns true if @a fd is still open on the file named @a filename,
+ * rather than one which has since been replaced by compaction.
+ */
+static bool
+is_current(int fd, const char *filename)
+{
+    struct stat fsb, psb;
+    return (fstat(fd, &fsb) == 0 &&
+	    stat(filename, &psb) == 0 &&
+	    fsb.st_dev == psb.st_dev &&
+	    fsb.st_ino == psb.st_ino);
+}
+
+/*
+ * Rewrite the file with only the samples we're keeping, if the
+ * lines appended since it was last written have made it big enough.
+ * Other runs may be appending to the file at the same time, so it's
+ * locked exclusively and read again first, and everything they
+ * appended since we loaded it is kept.
+ */
+bool
+history_t::compact()
+{
+    if (nlines_ <= COMPACT_RATIO * count_kept())
+	return true;
+
+    int lfd;
+    for (;;)
+    {
+	lfd = open(filename_, O_RDONLY);
+	if (lfd < 0)
+	{
+	    perror(filename_);
+	    return false;
+	}
+	if (flock(lfd, LOCK_EX) < 0)
+	{
+	    perror(filename_);
+	    close(lfd);
+	    return false;
+	}
+	if (is_current(lfd, filename_))
+	    break;
+	/* someone else compacted it while we waited */
+	close(lfd);
+    }
+
+    exes_.clear();
+    nlines_ = 0;
+    bool ok = load();
+    unsigned int nkept = count_kept();
+    if (ok && nlines_ > COMPACT_RATIO * nkept)
+    {
+	ok = save();
+	if (ok)
+	    nlines_ = nkept;
+    }
+
+    /* further appends must go to the new file */
+    if (fd_ >= 0)
+    {
+	close(fd_);
+	fd_ = -1;
+    }
+    close(lfd);
+    return ok;
+}
+
+/*
+ * Open the file for appending if we haven't already, or again if it
+ * has been replaced by compaction since, and lock it shared so that
+ * it can't be compacted while we write to it.  Sets *@a freshp if the
+ * file was (re)opened.
+ */
+bool
+history_t::lock_for_append(bool *freshp)
+{
+    *freshp = false;
+    for (;;)
+    {
+	if (fd_ < 0)
+	{
+	    fd_ = open(filename_, O_WRONLY|O_APPEND|O_CREAT, 0666);
+	    if (fd_ < 0)
+	    {
+		perror(filename_);
+		return false;
+	    }
+	    fcntl(fd_, F_SETFD, FD_CLOEXEC);
+	    *freshp = true;
+	}
+	if (flock(fd_, LOCK_SH) < 0)
+	{
+	    perror(filename_);
+	    return false;
+	}
+	if (is_current(fd_, filename_))
+	    return true;
+	close(fd_);
+	fd_ = -1;
+    }
+}
+
+/*
+ * Append a sample to the file straight away, in a single write()
+ * so that lines from concurrent runs don't get mixed up.
+ */
+bool
+history_t::append(const string &name, const sample_t &s)
+{
+    char buf[PATH_MAX+64];
+    int len;
+
+    len = snprintf(buf, sizeof(buf), "%s %lld %ld %s\n", name.c_str(),
+		   (long long)s.elapsed_, s.rss_, as_string(s.result_));
+    if (len >= (int)sizeof(buf))
+	return false;	    /* silly long name, just don't keep it */
+
+    bool fresh;
+    if (!lock_for_append(&fresh))
+	return false;
+
+    string text;
+    if (fresh)
+    {
+	struct stat sb;
+	if (fstat(fd_, &sb) == 0 && sb.st_size == 0)
+	    text = header;
+	/* the file may have ended with someone else's section */
+	text += string("@ ") + exe_ + "\n";
+    }
+    text += buf;
+
+    bool ok = (write(fd_, text.c_str(), text.length()) == (ssize_t)text.length());
+    if (!ok)
+	perror(filename_);
+    flock(fd_, LOCK_UN);
+    if (ok)
+	nlines_++;
+    return ok;
+}
+
+void
+history_t::add(jobs_t &jobs, const string &name, const sample_t &s)
+{
+    deque<sample_t> &samples = jobs[name];
+    samples.push_back(s);
+    while (samples.size() > MAX_SAMPLES)
+	samples.pop_front();
+}
+
+void
+history_t::add_sample(const string &name, int64_t elapsed, long rss,
+		      result_t res)
+{
+    sample_t s(elapsed, rss, res);
+    add(exes_[exe_], name, s);
+    append(name, s);
+}
+
+const deque<history_t::sample_t> *
+history_t::find(const string &name) const
+{
+    map<string, jobs_t>::const_iterator eitr = exes_.find(exe_);
+    if (eitr == exes_.end())
+	return 0;
+    jobs_t::const_iterator jitr = eitr->second.find(name);
+    if (jitr == eitr->second.end() || !jitr->second.size())
+	return 0;
+    return &jitr->second;
+}
+
+bool
+history_t::get_stats(const string &name, stats_t *stats) const
+{
+    const deque<sample_t> *samples = find(name);
+    if (!samples)
+	return false;
+
+    memset(stats, 0, sizeof(*stats));
+    vector<int64_t> v;
+    deque<sample_t>::const_iterator sitr;
+    for (sitr = samples->begin() ; sitr != samples->end() ; ++sitr)
+    {
+	stats->nsamples_++;
+	stats->npassed_ += (sitr->result_ == R_PASS);
+	stats->nfailed_ += (sitr->result_ == R_FAIL);
+	stats->last_result_ = sitr->result_;
+	stats->peak_rss_ = max(stats->peak_rss_, sitr->rss_);
+	if (sitr->result_ == R_PASS)
+	    v.push_back(sitr->elapsed_);
+    }
+
+    if (v.size())
+    {
+	sort(v.begin(), v.end());
+	stats->median_ = v[(v.size()-1)/2];
+	/* nearest-rank method */
+	stats->p99_ = v[(99 * v.size() + 99) / 100 - 1];
+	stats->max_ = v.back();
+    }
+    return true;
+}
+
+/*
+ * Only passing samples count towards the p99, so a test
+ * which hangs doesn't drag its own adaptive timeout upwards.
+ */
+unsigned int
+history_t::get_p99(const string &name, int64_t *p99) const
+{
+    stats_t stats;
+    if (!get_stats(name, &stats) || !stats.npassed_)
+	return 0;
+    *p99 = stats.p99_;
+    return stats.npassed_;
+}
+
+unsigned int
+history_t::get_peak_rss(const string &name, long *rss) const
+{
+    const deque<sample_t> *samples = find(name);
+    if (!samples)
+	return 0;
+
+    unsigned int n = 0;
+    long peak = 0;
+    deque<sample_t>::const_iterator sitr;
+    for (sitr = samples->begin() ; sitr != samples->end() ; ++sitr)
+    {
+	if (!sitr->rss_)
+	    continue;	/* not recorded */
+	peak = max(peak, sitr->rss_);
+	n++;
+    }
+    if (n)
+	*rss = peak;
+    return n;
+}
+
+long
+history_t::get_largest_peak_rss() const
+{
+    long peak = 0;
+    map<string, jobs_t>::const_iterator eitr = exes_.find(exe_);
+    if (eitr == exes_.end())
+	return 0;
+    jobs_t::const_iterator jitr;
+    for (jitr = eitr->second.begin() ; jitr != eitr->second.end() ; ++jitr)
+    {
+	deque<sample_t>::const_iterator sitr;
+	for (sitr = jitr->second.begin() ; sitr != jitr->second.end() ; ++sitr)
+	    peak = max(peak, sitr->rss_);
+    }
+    return peak;
+}
+
+// close the namespace
+};
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_HISTORY_H__
+#define __NP_HISTORY_H__ 1
+
+#include "np/util/common.hxx"
+#include "np/types.hxx"
+#include <map>
+#include <deque>
+
+namespace np {
+
+/*
+ * Remembers how long each job took, how much memory it used, and
+ * what its result was, on previous runs, keyed by the identity of
+ * the test executable and the job's name (as returned by
+ * job_t::as_string()), so that the runner and the listeners can make
+ * better decisions about it next time.
+ *
+ * The history is kept in a small text file with one sample per line,
+ * grouped into sections for each executable.  The runner appends a
+ * line as each job finishes, so the history survives a run which
+ * doesn't; at the end of the run the file is compacted down to the
+ * most recent MAX_SAMPLES samples for each job, once enough lines
+ * have been appended to make that worthwhile.
+ *
+ * Several runs can share the file.  Appends are done holding a shared
+ * flock() and compaction holding an exclusive one, and a run whose
+ * file was replaced by someone else's compaction opens it again.
+ */
+class history_t : public np::util::zalloc
+{
+public:
+    history_t(const char *filename);
+    ~history_t();
+
+    bool load();
+    bool save() const;
+    bool compact();
+
+    void add_sample(const std::string &name, int64_t elapsed, long rss,
+		    result_t res);
+
+    struct stats_t
+    {
+	unsigned int nsamples_;
+	unsigned int npassed_;
+	unsigned int nfailed_;
+	result_t last_result_;
+	/* durations of the passing samples, in nanoseconds */
+	int64_t median_;
+	int64_t p99_;
+	int64_t max_;
+	long peak_rss_;		/* in KiB, or 0 if never recorded */
+    };
+    /* returns false if the job has no history */
+    bool get_stats(const std::string &name, stats_t *stats) const;
+
+    /* these return the number of samples used, or 0 if there are none */
+    unsigned int get_p99(const std::string &name, int64_t *p99) const;
+    unsigned int get_peak_rss(const std::string &name, long *rss) const;
+    /* of any job in this executable, in KiB, or 0 */
+    long get_largest_peak_rss() const;
+
+    enum { MAX_SAMPLES = 20 };
+    /* compact when the file has this many times the lines we keep */
+    enum { COMPACT_RATIO = 4 };
+
+private:
+    struct sample_t
+    {
+	sample_t(int64_t e, long r, result_t res)
+	 :  elapsed_(e), rss_(r), result_(res) {}
+	int64_t elapsed_;	/* in nanoseconds */
+	long rss_;		/* peak resident set size in KiB, or 0 */
+	result_t result_;
+    };
+    typedef std::map<std::string, std::deque<sample_t> > jobs_t;
+
+    void add(jobs_t &jobs, const std::string &name, const sample_t &s);
+    const std::deque<sample_t> *find(const std::string &name) const;
+    unsigned int count_kept() const;
+    bool lock_for_append(bool *freshp);
+    bool append(const std::string &name, const sample_t &s);
+
+    char *filename_;
+    std::string exe_;	    /* identity of this test executable */
+    std::map<std::string, jobs_t> exes_;
+    unsigned int nlines_;   /* sample lines in the file */
+    int fd_;		    /* for appending, or -1 */
+};
+
+// close the namespace
+};
+
+#endif /* __NP_HISTORY_H__ */
@@ -32,6 +32,8 @@ job_t::job_t(const plan_t::iterator &i)
 
 job_t::~job_t()
 {
+    if (keep_output_)
+	return;
     if (stdout_path_ != "")
 	unlink(stdout_path_.c_str());
     if (stderr_path_ != "")
@@ -79,6 +81,13 @@ job_t::post_run(bool in_parent)
 	i->unapply();
 }
 
+void
+job_t::set_elapsed(int64_t ns)
+{
+    end_ = rel_now();
+    start_ = end_ - ns;
+}
+
 int64_t
 job_t::get_elapsed() const
 {
@@ -88,16 +97,20 @@ job_t::get_elapsed() const
     return end - start_;
 }
 
+/*
+ * Read a capture file through a capture_t so that a huge file is
+ * trimmed the same way as output captured through a pipe.
+ */
 static string
-get_file_contents(const string &path)
+get_file_contents(const string &path, unsigned int keep)
 {
-    struct stat sb;
+    capture_t cap;
+    char buf[16384];
     int r;
     int fd;
-    int remain;
-    char *b;
-    string buf;
 
+    if (path == "")
+	return string("");	/* output was not captured */
     fd = open(path.c_str(), O_RDONLY, 0);
     if (fd < 0)
     {
@@ -105,36 +118,30 @@ get_file_contents(const string &path)
 	return string("");
     }
 
-    r = fstat(fd, &sb);
+    cap.set_keep(keep);
+    while ((r = read(fd, buf, sizeof(buf))) > 0)
+	cap.append(buf, r);
     if (r < 0)
-    {
 	perror(path.c_str());
-	return string("");
-    }
-    buf.resize(sb.st_size);
-
-    remain = sb.st_size;
-    b = (char *)buf.c_str();
-    while (remain > 0 && (r = read(fd, b, remain)) > 0)
-    {
-	remain -= r;
-	b += r;
-    }
 
     close(fd);
-    return buf;
+    return cap.get();
 }
 
 string
 job_t::get_stdout() const
 {
-    return get_file_contents(stdout_path_);
+    if (stdout_path_ != "")
+	return get_file_contents(stdout_path_, stdout_capture_.get_keep());
+    return stdout_capture_.get();
 }
 
 string
 job_t::get_stderr() const
 {
-    return get_file_contents(stderr_path_);
+    if (stderr_path_ != "")
+	return get_file_contents(stderr_path_, stderr_capture_.get_keep());
+    return stderr_capture_.get();
 }
 
 // close the namespace
@@ -19,6 +19,7 @@
 #include "np/util/common.hxx"
 #include "np/testnode.hxx"
 #include "np/plan.hxx"
+#include "np/capture.hxx"
 
 namespace np {
 
@@ -30,14 +31,57 @@ public:
 
     std::string as_string() const;
     testnode_t *get_node() const { return node_; }
+    const std::vector<testnode_t::assignment_t> &get_assignments() const { return assigns_; }
     void pre_run(bool in_parent);
     void post_run(bool in_parent);
 
     int64_t get_start() const { return start_; }
     int64_t get_elapsed() const;
 
+    void set_timeout(int secs, const std::string &reason)
+    {
+	timeout_ = secs;
+	timeout_reason_ = reason;
+    }
+    int get_timeout() const { return timeout_; }
+    const std::string &get_timeout_reason() const { return timeout_reason_; }
+
+    /* memory use in KiB */
+    void set_memory_estimate(long kb) { memory_estimate_ = kb; }
+    long get_memory_estimate() const { return memory_estimate_; }
+    void set_peak_rss(long kb) { peak_rss_ = kb; }
+    long get_peak_rss() const { return peak_rss_; }
+
+    /* for resuming from a journal */
+    void set_elapsed(int64_t ns);
+
+    /* When each phase of running the job in the child began, as
+     * rel_now() timestamps which the child sends back to the parent.
+     * A phase ends when the next one begins, and 0 means the phase
+     * never began, e.g. because the test crashed. */
+    enum phase_t
+    {
+	PH_SETUP,	/* applying parameters */
+	PH_BEFORE,	/* before fixtures */
+	PH_TEST,
+	PH_AFTER,	/* after fixtures */
+	PH_CHECK,	/* looking for leaks */
+	PH_DONE,
+	PH_NUM
+    };
+    void begin_phase(phase_t ph) { phase_start_[ph] = np::util::rel_now(); }
+    void set_phase_start(phase_t ph, int64_t t) { phase_start_[ph] = t; }
+    int64_t get_phase_start(phase_t ph) const { return phase_start_[ph]; }
+
     void set_stdout_path(const char *path) { stdout_path_ = std::string(path); }
     void set_stderr_path(const char *path) { stderr_path_ = std::string(path); }
+    const std::string &get_stdout_path() const { return stdout_path_; }
+    const std::string &get_stderr_path() const { return stderr_path_; }
+    /* don't remove the captured output files when we're done */
+    void set_keep_output(bool b) { keep_output_ = b; }
+    /* output captured through pipes, when not captured to files */
+    capture_t *get_stdout_capture() { return &stdout_capture_; }
+    capture_t *get_stderr_capture() { return &stderr_capture_; }
     std::string get_stdout() const;
     std::string get_stderr() const;
 
@@ -49,8 +93,16 @@ private:
     std::vector<testnode_t::assignment_t> assigns_;
     int64_t start_;
     int64_t end_;
+    int64_t phase_start_[PH_NUM];
+    int timeout_;	/* in seconds, 0 to disable */
+    std::string timeout_reason_;
+    long memory_estimate_;
+    long peak_rss_;
     std::string stdout_path_;
     std::string stderr_path_;
+    bool keep_output_;
+    capture_t stdout_capture_;
+    capture_t stderr_capture_;
 };
 
 // close the namespace
@@ -0,0 +1,362 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include "np/journal.hxx"
+#include "np/job.hxx"
+#include "np/event.hxx"
+#include "np/spiegel/platform/common.hxx"
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+static const char header[] = "# novaprova checkpoint journal";
+
+journal_t::record_t::~record_t()
+{
+    vector<event_t*>::iterator itr;
+    for (itr = events_.begin() ; itr != events_.end() ; ++itr)
+	delete *itr;
+}
+
+journal_t::journal_t(const char *filename)
+ :  filename_(xstrdup(filename)),
+    fd_(-1)
+{
+}
+
+journal_t::~journal_t()
+{
+    if (fd_ >= 0)
+	close(fd_);
+    forget();
+    xfree(filename_);
+}
+
+/*
+ * Identifies the build of the test executable, so that a journal
+ * written by a different build isn't resumed from.  That's the build
+ * ID when the linker put one in, otherwise the best we can do is the
+ * path, size and modification time of the executable.  Returns an
+ * empty string if the executable can't be identified at all.
+ */
+static string
+get_exe_identity()
+{
+    char *exe = np::spiegel::platform::self_exe();
+    if (!exe)
+	return string("");
+    string id = np::spiegel::platform::get_build_id(exe);
+    if (id == "")
+    {
+	struct stat sb;
+	if (stat(exe, &sb) == 0)
+	{
+	    char buf[64];
+	    snprintf(buf, sizeof(buf), ":%lld:%lld",
+		     (long long)sb.st_size, (long long)sb.st_mtime);
+	    id = string(exe) + buf;
+	}
+    }
+    xfree(exe);
+    return id;
+}
+
+/* Journal fields are separated by tabs and records by newlines,
+ * so those characters need to be escaped in strings. */
+static string
+escape(const char *s)
+{
+    string r;
+    for ( ; s && *s ; s++)
+    {
+	switch (*s)
+	{
+	case '\\': r += "\\\\"; break;
+	case '\t': r += "\\t"; break;
+	case '\n': r += "\\n"; break;
+	default: r += *s; break;
+	}
+    }
+    return r;
+}
+
+static string
+unescape(const string &s)
+{
+    string r;
+    for (string::const_iterator itr = s.begin() ; itr != s.end() ; ++itr)
+    {
+	if (*itr == '\\' && itr+1 != s.end())
+	{
+	    ++itr;
+	    r += (*itr == 't' ? '\t' : *itr == 'n' ? '\n' : *itr);
+	}
+	else
+	{
+	    r += *itr;
+	}
+    }
+    return r;
+}
+
+static vector<string>
+split_fields(const char *line)
+{
+    vector<string> fields;
+    const char *p;
+    while ((p = strchr(line, '\t')) != 0)
+    {
+	fields.push_back(unescape(string(line, p-line)));
+	line = p+1;
+    }
+    fields.push_back(unescape(string(line)));
+    return fields;
+}
+
+string
+journal_t::get_output_directory() const
+{
+    return string(filename_) + ".d";
+}
+
+/*
+ * Open the journal for appending.  When @a resume is true, completed
+ * jobs are first read from any existing journal; otherwise, or if
+ * there is nothing usable to resume from, the journal and any captured
+ * output from a previous run are thrown away.
+ */
+bool
+journal_t::open(bool resume)
+{
+    bool fresh = !(resume && load());
+    if (fresh)
+	discard();
+
+    fd_ = ::open(filename_, O_WRONLY|O_CREAT|O_APPEND|(fresh ? O_TRUNC : 0), 0666);
+    if (fd_ < 0)
+    {
+	perror(filename_);
+	return false;
+    }
+
+    string dir = get_output_directory();
+    if (mkdir(dir.c_str(), 0777) < 0 && errno != EEXIST)
+    {
+	perror(dir.c_str());
+	return false;
+    }
+
+    struct stat sb;
+    if (fstat(fd_, &sb) == 0 && sb.st_size == 0)
+    {
+	append(string(header) + "\n");
+	append(string("exe\t") + escape(get_exe_identity().c_str()) + "\n");
+    }
+    return true;
+}
+
+bool
+journal_t::load()
+{
+    FILE *fp;
+    char *line = 0;
+    size_t linesize = 0;
+    ssize_t len;
+    string exe_id;
+    bool valid = false;
+    /* events for jobs which haven't finished yet */
+    map<string, vector<event_t*> > pending;
+
+    fp = fopen(filename_, "r");
+    if (!fp)
+    {
+	/* a missing file just means there's nothing to resume */
+	if (errno != ENOENT)
+	    perror(filename_);
+	return false;
+    }
+
+    while ((len = getline(&line, &linesize, fp)) > 0)
+    {
+	/* ignore a partial record written as we were killed */
+	if (line[len-1] != '\n')
+	    break;
+	line[len-1] = '\0';
+	if (line[0] == '#')
+	{
+	    if (!strcmp(line, header))
+		valid = true;
+	    continue;
+	}
+
+	vector<string> f = split_fields(line);
+	if (f[0] == "exe" && f.size() == 2)
+	{
+	    exe_id = f[1];
+	}
+	else if (f[0] == "event" && f.size() == 9)
+	{
+	    event_t ev((events_t)atoi(f[2].c_str()), f[6].c_str());
+	    ev.locflags = atoi(f[3].c_str());
+	    ev.lineno = atoi(f[4].c_str());
+	    ev.functype = (functype_t)atoi(f[5].c_str());
+	    ev.filename = (f[7] == "" ? 0 : f[7].c_str());
+	    ev.function = (f[8] == "" ? 0 : f[8].c_str());
+	    pending[f[1]].push_back(ev.clone());
+	}
+	else if (f[0] == "job" && f.size() == 6)
+	{
+	    record_t *rec = new record_t;
+	    rec->result_ = (result_t)atoi(f[2].c_str());
+	    rec->elapsed_ = strtoll(f[3].c_str(), NULL, 10);
+	    rec->stdout_path_ = f[4];
+	    rec->stderr_path_ = f[5];
+	    rec->events_.swap(pending[f[1]]);
+	    pending.erase(f[1]);
+
+	    record_t *&slot = completed_[f[1]];
+	    delete slot;
+	    slot = rec;
+	}
+    }
+    free(line);
+    fclose(fp);
+
+    map<string, vector<event_t*> >::iterator pitr;
+    for (pitr = pending.begin() ; pitr != pending.end() ; ++pitr)
+    {
+	vector<event_t*>::iterator eitr;
+	for (eitr = pitr->second.begin() ; eitr != pitr->second.end() ; ++eitr)
+	    delete *eitr;
+    }
+
+    if (!valid)
+    {
+	forget();
+	return false;
+    }
+    string our_id = get_exe_identity();
+    if (our_id == "" || exe_id != our_id)
+    {
+	if (our_id == "")
+	    fprintf(stderr, "np: cannot identify this build, "
+			    "not resuming from %s\n", filename_);
+	else
+	    fprintf(stderr, "np: %s was written by a different build, "
+			    "not resuming from it\n", filename_);
+	forget();
+	return false;
+    }
+    return true;
+}
+
+/* throw away the completed jobs read by load() */
+void
+journal_t::forget()
+{
+    map<string, record_t*>::iterator itr;
+    for (itr = completed_.begin() ; itr != completed_.end() ; ++itr)
+	delete itr->second;
+    completed_.clear();
+}
+
+/* remove captured output left over from a previous run */
+void
+journal_t::discard()
+{
+    string dir = get_output_directory();
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+	return;
+    struct dirent *de;
+    while ((de = readdir(d)) != 0)
+    {
+	if (de->d_name[0] == '.')
+	    continue;
+	unlink((dir + "/" + de->d_name).c_str());
+    }
+    closedir(d);
+}
+
+const journal_t::record_t *
+journal_t::find(const string &name) const
+{
+    map<string, record_t*>::const_iterator itr = completed_.find(name);
+    return (itr == completed_.end() ? 0 : itr->second);
+}
+
+/*
+ * Records are written with a single write() on an O_APPEND
+ * descriptor, so each one lands in the file whole or not at all
+ * unless the disk fills up.
+ */
+void
+journal_t::append(const string &line)
+{
+    const char *p = line.c_str();
+    size_t remain = line.length();
+
+    while (remain)
+    {
+	ssize_t r = write(fd_, p, remain);
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    perror(filename_);
+	    return;
+	}
+	p += r;
+	remain -= r;
+    }
+}
+
+void
+journal_t::add_event(const job_t *j, const event_t *ev)
+{
+    if (fd_ < 0 || !j)
+	return;
+    append(string("event\t") +
+	   escape(j->as_string().c_str()) + "\t" +
+	   dec(ev->which) + "\t" +
+	   dec(ev->locflags) + "\t" +
+	   dec(ev->lineno) + "\t" +
+	   dec(ev->functype) + "\t" +
+	   escape(ev->description) + "\t" +
+	   escape(ev->filename) + "\t" +
+	   escape(ev->function) + "\n");
+}
+
+void
+journal_t::end_job(const job_t *j, result_t res)
+{
+    if (fd_ < 0)
+	return;
+    char elapsed[32];
+    snprintf(elapsed, sizeof(elapsed), "%lld", (long long)j->get_elapsed());
+    append(string("job\t") +
+	   escape(j->as_string().c_str()) + "\t" +
+	   dec(res) + "\t" +
+	   elapsed + "\t" +
+	   escape(j->get_stdout_path().c_str()) + "\t" +
+	   escape(j->get_stderr_path().c_str()) + "\n");
+}
+
+// close the namespace
+};
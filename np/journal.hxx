@@ -0,0 +1,83 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_JOURNAL_H__
+#define __NP_JOURNAL_H__ 1
+
+#include "np/util/common.hxx"
+#include "np/types.hxx"
+#include <map>
+#include <vector>
+
+namespace np {
+
+class event_t;
+class job_t;
+
+/*
+ * Checkpoints the results of completed jobs so that an interrupted
+ * run can be resumed later without re-running them.  The journal is
+ * a text file which is only ever appended to, one record per line:
+ * an "event" line for each event raised by a job followed by a "job"
+ * line when the job is finished.  A job only counts as completed if
+ * its "job" line made it to disk intact, so being killed partway
+ * through writing a record is harmless.
+ *
+ * When the listeners want the jobs' stdout and stderr captured, the
+ * capture files are kept in a directory next to the journal (named
+ * after it with a ".d" suffix) and their paths are journalled, so
+ * resumed results have their output too.
+ */
+class journal_t : public np::util::zalloc
+{
+public:
+    struct record_t
+    {
+	record_t() : result_(R_UNKNOWN), elapsed_(0) {}
+	~record_t();
+
+	result_t result_;
+	int64_t elapsed_;	/* in nanoseconds */
+	std::string stdout_path_;
+	std::string stderr_path_;
+	std::vector<event_t*> events_;
+    };
+
+    journal_t(const char *filename);
+    ~journal_t();
+
+    bool open(bool resume);
+    std::string get_output_directory() const;
+    const record_t *find(const std::string &name) const;
+    unsigned int get_ncompleted() const { return completed_.size(); }
+
+    void add_event(const job_t *, const event_t *);
+    void end_job(const job_t *, result_t);
+
+private:
+    bool load();
+    void forget();
+    void discard();
+    void append(const std::string &line);
+
+    char *filename_;
+    int fd_;
+    std::map<std::string, record_t*> completed_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_JOURNAL_H__ */
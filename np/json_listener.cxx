@@ -0,0 +1,198 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/json_listener.hxx"
+#include "np/job.hxx"
+#include "np/event.hxx"
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+/*
+ * Return @a s as a quoted JSON string.  Test output can contain
+ * anything, so bytes which aren't part of a valid UTF-8 sequence
+ * are replaced with U+FFFD.
+ */
+string
+json_string(const string &s)
+{
+    string r = "\"";
+    const unsigned char *p = (const unsigned char *)s.c_str();
+    const unsigned char *end = p + s.length();
+    char buf[8];
+
+    while (p < end)
+    {
+	unsigned char c = *p;
+	if (c < 0x80)
+	{
+	    switch (c)
+	    {
+	    case '"': r += "\\\""; break;
+	    case '\\': r += "\\\\"; break;
+	    case '\n': r += "\\n"; break;
+	    case '\r': r += "\\r"; break;
+	    case '\t': r += "\\t"; break;
+	    default:
+		if (c < 0x20 || c == 0x7f)
+		{
+		    snprintf(buf, sizeof(buf), "\\u%04x", c);
+		    r += buf;
+		}
+		else
+		    r += (char)c;
+		break;
+	    }
+	    p++;
+	    continue;
+	}
+
+	unsigned int n = (c >= 0xf0 && c < 0xf5 ? 3 :
+			  c >= 0xe0 ? 2 :
+			  c >= 0xc2 && c < 0xe0 ? 1 : 0);
+	if (c >= 0xf5)
+	    n = 0;
+	unsigned int i;
+	for (i = 1 ; i <= n ; i++)
+	{
+	    if (p + i >= end || (p[i] & 0xc0) != 0x80)
+		break;
+	}
+	if (!n || i <= n)
+	{
+	    r += "\\ufffd";
+	    p++;
+	    continue;
+	}
+	r.append((const char *)p, n+1);
+	p += n+1;
+    }
+    return r + "\"";
+}
+
+string
+json_listener_t::start_object(const char *type) const
+{
+    return string("{\"type\":\"") + type + "\",\"time\":" +
+	   rel_format(rel_now() - start_);
+}
+
+string
+json_listener_t::job_members(const job_t *j) const
+{
+    string s = ",\"job\":" + json_string(j->as_string()) +
+	       ",\"node\":" + json_string(j->get_node()->get_fullname());
+
+    const vector<testnode_t::assignment_t> &assigns = j->get_assignments();
+    if (assigns.size())
+    {
+	s += ",\"parameters\":{";
+	vector<testnode_t::assignment_t>::const_iterator i;
+	for (i = assigns.begin() ; i != assigns.end() ; ++i)
+	{
+	    if (i != assigns.begin())
+		s += ",";
+	    s += json_string(i->get_name()) + ":" + json_string(i->get_value());
+	}
+	s += "}";
+    }
+    return s;
+}
+
+void
+json_listener_t::emit(string &obj)
+{
+    obj += "}\n";
+    fputs(obj.c_str(), stdout);
+    fflush(stdout);
+}
+
+void
+json_listener_t::begin()
+{
+    start_ = rel_now();
+    nrun_ = 0;
+    nfailed_ = 0;
+
+    string s = start_object("begin");
+    s += ",\"timestamp\":" + json_string(abs_format_iso8601(abs_now()));
+    emit(s);
+}
+
+void
+json_listener_t::end()
+{
+    string s = start_object("end");
+    s += ",\"run\":" + dec(nrun_) + ",\"failed\":" + dec(nfailed_);
+    emit(s);
+}
+
+void
+json_listener_t::begin_job(const job_t *j)
+{
+    string s = start_object("begin_job");
+    s += job_members(j);
+    if (j->get_timeout())
+	s += ",\"timeout\":" + dec((unsigned int)j->get_timeout());
+    emit(s);
+}
+
+void
+json_listener_t::add_event(const job_t *j, const event_t *ev)
+{
+    /* the runner has already normalised the event */
+    string s = start_object("event");
+
+    if (j)
+	s += job_members(j);
+    s += ",\"which\":" + json_string(ev->which_as_string());
+    s += ",\"result\":" + json_string(as_string(ev->get_result()));
+    s += ",\"description\":" + json_string(xstr(ev->description));
+    if (ev->locflags & event_t::LT_FILENAME)
+	s += ",\"file\":" + json_string(xstr(ev->filename));
+    if (ev->locflags & event_t::LT_LINENO)
+	s += ",\"line\":" + dec(ev->lineno);
+    if (ev->locflags & event_t::LT_FUNCNAME)
+	s += ",\"function\":" + json_string(xstr(ev->function));
+    if (ev->locflags & event_t::LT_FUNCTYPE)
+	s += ",\"functype\":" + json_string(as_string((functype_t)ev->functype));
+    if (ev->locflags & event_t::LT_STACK)
+	s += ",\"stack\":" + json_string(xstr(ev->function));
+    emit(s);
+}
+
+void
+json_listener_t::end_job(const job_t *j, result_t res)
+{
+    string s = start_object("end_job");
+
+    nrun_++;
+    if (res == R_FAIL)
+	nfailed_++;
+    s += job_members(j);
+    s += ",\"result\":" + json_string(as_string(res));
+    s += ",\"elapsed\":" + rel_format(j->get_elapsed());
+    if (j->get_peak_rss())
+	s += ",\"peak_rss_kb\":" + dec((unsigned int)j->get_peak_rss());
+    s += ",\"stdout\":" + json_string(j->get_stdout());
+    s += ",\"stderr\":" + json_string(j->get_stderr());
+    emit(s);
+}
+
+// close the namespace
+};
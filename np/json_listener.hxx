@@ -0,0 +1,59 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_JSON_LISTENER_H__
+#define __NP_JSON_LISTENER_H__ 1
+
+#include "np/listener.hxx"
+
+namespace np {
+
+/*
+ * Writes one JSON object per line to stdout for each listener
+ * callback, flushing after every line so that another program can
+ * follow a run as it happens.  Every object has a "type" member,
+ * one of "begin", "begin_job", "event", "end_job" or "end", and a
+ * "time" member in seconds since the start of the run.
+ */
+class json_listener_t : public listener_t
+{
+public:
+    json_listener_t() : start_(0), nrun_(0), nfailed_(0) {}
+    ~json_listener_t() {}
+
+    bool needs_stdout() const { return true; }
+    void begin();
+    void end();
+    void begin_job(const job_t *);
+    void end_job(const job_t *, result_t);
+    void add_event(const job_t *, const event_t *ev);
+
+private:
+    std::string start_object(const char *type) const;
+    std::string job_members(const job_t *) const;
+    void emit(std::string &obj);
+
+    int64_t start_;
+    unsigned int nrun_;
+    unsigned int nfailed_;
+};
+
+/* also used by other listeners which write JSON */
+extern std::string json_string(const std::string &);
+
+// close the namespace
+};
+
+#endif /* __NP_JSON_LISTENER_H__ */
@@ -15,9 +15,11 @@
  */
 #include "np/util/common.hxx"
 #include <sys/stat.h>
-#include <libxml/tree.h>
+#include <libxml/xmlwriter.h>
 #include "np/junit_listener.hxx"
 #include "np/job.hxx"
+#include "np/plan.hxx"
+#include "np/testnode.hxx"
 #include "except.h"
 
 namespace np {
@@ -26,15 +28,67 @@ using namespace np::util;
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
+junit_listener_t::junit_listener_t()
+ :  spillfd_(-1),
+    spillpos_(0)
+{
+}
+
+junit_listener_t::~junit_listener_t()
+{
+    if (spillfd_ >= 0)
+	close(spillfd_);
+}
+
 bool
 junit_listener_t::needs_stdout() const
 {
     return true;
 }
 
+string
+junit_listener_t::get_suitename(testnode_t *tn)
+{
+    return tn->get_parent()->get_fullname();
+}
+
+/*
+ * Count how many jobs each suite will run, so that we know when
+ * we've seen the last of them.
+ */
+void
+junit_listener_t::set_plan(plan_t *plan)
+{
+    plan_t::iterator pitr;
+    for (pitr = plan->begin() ; pitr != plan->end() ; ++pitr)
+	suites_[get_suitename(pitr.get_node())].nexpected_++;
+}
+
 void
 junit_listener_t::begin()
 {
+    hostname_ = get_hostname();
+
+    // TODO: mkdir_p
+    directory_ = "reports";
+    int r = mkdir(directory_.c_str(), 0777);
+    if (r < 0 && errno != EEXIST)
+    {
+	fprintf(stderr, "np: cannot make directory %s: %s\n",
+		directory_.c_str(), strerror(errno));
+	directory_ = "";
+	return;
+    }
+
+    /* captured output waits here until its suite is written */
+    string spillfile = directory_ + "/.spill.XXXXXX";
+    char *path = xstrdup(spillfile.c_str());
+    spillfd_ = mkstemp(path);
+    if (spillfd_ < 0)
+	perror(path);
+    else
+	unlink(path);
+    xfree(path);
 }
 
 string
@@ -56,107 +110,237 @@ junit_listener_t::get_hostname() const
 #define s(x) ((const xmlChar *)(const char *)(x))
 #define ss(x) ((const xmlChar *)(x).c_str())
 
+/*
+ * Append @a s to the spill file, and remember where it went.
+ */
+bool
+junit_listener_t::spill(const string &s, extent_t *ext)
+{
+    const char *p = s.c_str();
+    size_t remain = s.length();
+
+    if (spillfd_ < 0 || !remain)
+	return false;
+
+    ext->offset_ = spillpos_;
+    ext->length_ = remain;
+    while (remain)
+    {
+	ssize_t r = pwrite(spillfd_, p, remain, spillpos_);
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    perror("np: cannot write JUnit spill file");
+	    ext->length_ = 0;
+	    return false;
+	}
+	p += r;
+	remain -= r;
+	spillpos_ += r;
+    }
+    return true;
+}
+
+/*
+ * Return the @a len bytes at @a p as text which can go in an XML
+ * document.  Test output can contain anything, so control characters
+ * which XML doesn't allow and bytes which aren't part of a valid UTF-8
+ * sequence are replaced with U+FFFD.  When @a more is true, a sequence
+ * cut short at the end is left for the next call, which will have the
+ * rest of it; *@a usedp is set to the number of bytes consumed.
+ */
+static string
+xml_text(const char *s, size_t len, bool more, size_t *usedp)
+{
+    static const char replacement[] = "\xef\xbf\xbd";
+    const unsigned char *p = (const unsigned char *)s;
+    const unsigned char *end = p + len;
+    string r;
+
+    while (p < end)
+    {
+	unsigned char c = *p;
+	if (c < 0x80)
+	{
+	    if (c < 0x20 && c != '\t' && c != '\n' && c != '\r')
+		r += replacement;
+	    else
+		r += (char)c;
+	    p++;
+	    continue;
+	}
+
+	unsigned int n = (c >= 0xf0 && c < 0xf5 ? 3 :
+			  c >= 0xe0 ? 2 :
+			  c >= 0xc2 && c < 0xe0 ? 1 : 0);
+	if (c >= 0xf5)
+	    n = 0;
+	unsigned int i;
+	for (i = 1 ; i <= n ; i++)
+	{
+	    if (p + i >= end || (p[i] & 0xc0) != 0x80)
+		break;
+	}
+	if (more && n && p + i >= end)
+	    break;
+	if (!n || i <= n)
+	{
+	    r += replacement;
+	    p++;
+	    continue;
+	}
+	r.append((const char *)p, n+1);
+	p += n+1;
+    }
+    *usedp = p - (const unsigned char *)s;
+    return r;
+}
+
+/*
+ * Write the part of the spill file described by @a ext as XML text,
+ * a chunk at a time.  A UTF-8 sequence split between chunks is
+ * carried over to the next one.
+ */
+static void
+write_extent(xmlTextWriter *xw, int fd, off_t offset, size_t length)
+{
+    char buf[16384];
+    size_t have = 0;
+
+    while (length)
+    {
+	ssize_t r = pread(fd, buf+have, min(length, sizeof(buf)-have), offset);
+	if (r < 0 && errno == EINTR)
+	    continue;
+	if (r <= 0)
+	{
+	    perror("np: cannot read JUnit spill file");
+	    return;
+	}
+	offset += r;
+	length -= r;
+	have += r;
+
+	size_t used;
+	xmlTextWriterWriteString(xw, ss(xml_text(buf, have, (length > 0), &used)));
+	memmove(buf, buf+used, have-used);
+	have -= used;
+    }
+}
+
 void
-junit_listener_t::end()
+junit_listener_t::write_suite(const string &suitename, const suite_t *suite)
 {
-    string hostname = get_hostname();
-    string timestamp = abs_format_iso8601(abs_now());
+    // If only there were a standard DTD URL...
+    // instead we have a Schema from
+    // http://windyroad.org/dl/OpenSource/JUnit.xsd
 
-    // TODO: mkdir_p
-    string directory = "reports";
-    int r = mkdir(directory.c_str(), 0777);
-    if (r < 0 && errno != EEXIST)
+    if (directory_ == "")
+	return;
+    string filename = directory_ + string("/TEST-") + suitename + ".xml";
+    string tmpfile = filename + ".tmp";
+
+    xmlTextWriter *xw = xmlNewTextWriterFilename(tmpfile.c_str(), 0);
+    if (!xw)
     {
-	fprintf(stderr, "np: cannot make directory %s: %s\n",
-		directory.c_str(), strerror(errno));
+	fprintf(stderr, "np: failed to write JUnit XML file %s: %s\n",
+		filename.c_str(), strerror(errno));
 	return;
     }
 
-    map<string, suite_t>::iterator sitr;
-    for (sitr = suites_.begin() ; sitr != suites_.end() ; ++sitr)
+    unsigned int nerrs = 0;
+    int64_t sns = 0;
+    map<string, case_t>::const_iterator citr;
+    for (citr = suite->cases_.begin() ; citr != suite->cases_.end() ; ++citr)
+    {
+	if (citr->second.result_ == R_FAIL)
+	    nerrs++;
+	sns += citr->second.elapsed_;
+    }
+
+    xmlTextWriterStartDocument(xw, NULL, "UTF-8", NULL);
+    xmlTextWriterStartElement(xw, s("testsuite"));
+    xmlTextWriterWriteAttribute(xw, s("name"), ss(suitename));
+    xmlTextWriterWriteAttribute(xw, s("failures"), s("0"));
+    xmlTextWriterWriteAttribute(xw, s("tests"), ss(dec(suite->cases_.size())));
+    xmlTextWriterWriteAttribute(xw, s("hostname"), ss(hostname_));
+    xmlTextWriterWriteAttribute(xw, s("timestamp"), ss(abs_format_iso8601(abs_now())));
+    xmlTextWriterWriteAttribute(xw, s("errors"), ss(dec(nerrs)));
+    xmlTextWriterWriteAttribute(xw, s("time"), ss(rel_format(sns)));
+
+    xmlTextWriterStartElement(xw, s("properties"));
+    xmlTextWriterEndElement(xw);
+
+    for (citr = suite->cases_.begin() ; citr != suite->cases_.end() ; ++citr)
     {
-	const string &suitename = sitr->first;
-	suite_t *suite = &sitr->second;
-
-	xmlDoc *xdoc = xmlNewDoc(s("1.0"));
-	// If only there were a standard DTD URL...
-	// instead we have a Schema from
-	// http://windyroad.org/dl/OpenSource/JUnit.xsd
-
-	xmlNode *xsuite = xmlNewNode(NULL, s("testsuite"));
-	xmlDocSetRootElement(xdoc, xsuite);
-	xmlNewProp(xsuite, s("name"), ss(suitename));
-	xmlNewProp(xsuite, s("failures"), s("0"));
-	xmlNewProp(xsuite, s("tests"), ss(dec(suite->cases_.size())));
-	xmlNewProp(xsuite, s("hostname"), ss(hostname));
-	xmlNewProp(xsuite, s("timestamp"), ss(timestamp));
-
-	xmlAddChild(xsuite, xmlNewNode(NULL, s("properties")));
-
-	unsigned int nerrs = 0;
-	int64_t sns = 0;
-	map<string, case_t>::iterator citr;
-	string all_stdout;
-	string all_stderr;
+	const string &casename = citr->first;
+	const case_t *c = &citr->second;
+
+	xmlTextWriterStartElement(xw, s("testcase"));
+	xmlTextWriterWriteAttribute(xw, s("name"), ss(casename));
+	// TODO: this is wrong
+	xmlTextWriterWriteAttribute(xw, s("classname"), ss(casename));
+	xmlTextWriterWriteAttribute(xw, s("time"), ss(rel_format(c->elapsed_)));
+
+	if (c->event_)
+	{
+	    event_t *e = c->event_;
+	    xmlTextWriterStartElement(xw, s("error"));
+	    xmlTextWriterWriteAttribute(xw, s("type"), ss(e->which_as_string()));
+	    xmlTextWriterWriteAttribute(xw, s("message"), s(e->description));
+	    xmlTextWriterWriteString(xw, ss(e->as_string() +
+				     "\n" +
+				     e->get_long_location()));
+	    xmlTextWriterEndElement(xw);
+	}
+	xmlTextWriterEndElement(xw);
+    }
+
+    /* all the cases' stdout, then all their stderr */
+    static const char * const tags[2] = { "system-out", "system-err" };
+    for (int i = 0 ; i < 2 ; i++)
+    {
+	xmlTextWriterStartElement(xw, s(tags[i]));
 	for (citr = suite->cases_.begin() ; citr != suite->cases_.end() ; ++citr)
 	{
-	    const string &casename = citr->first;
-	    case_t *c = &citr->second;
-
-	    xmlNode *xcase = xmlAddChild(xsuite, xmlNewNode(NULL, s("testcase")));
-	    xmlNewProp(xcase, s("name"), ss(casename));
-	    // TODO: this is wrong
-	    xmlNewProp(xcase, s("classname"), ss(casename));
-
-	    sns += c->elapsed_;
-	    xmlNewProp(xcase, s("time"), ss(rel_format(c->elapsed_)));
-
-	    if (c->event_)
-	    {
-		event_t *e = c->event_;
-		xmlNode *xerror = xmlAddChild(xcase, xmlNewNode(NULL, s("error")));
-		xmlNewProp(xerror, s("type"), ss(e->which_as_string()));
-		xmlNewProp(xerror, s("message"), s(e->description));
-		xmlAddChild(xerror, xmlNewText(ss(e->as_string() +
-				       "\n" +
-				       e->get_long_location())));
-	    }
-	    if (c->result_ == R_FAIL)
-		nerrs++;
-
-	    if (c->stdout_ != "")
-	    {
-		all_stdout += string("===") + casename + string("===\n");
-		all_stdout += c->stdout_;
-	    }
-	    if (c->stderr_ != "")
-	    {
-		all_stderr += string("===") + casename + string("===\n");
-		all_stderr += c->stderr_;
-	    }
+	    const extent_t *ext = (i ? &citr->second.stderr_ : &citr->second.stdout_);
+	    if (!ext->length_)
+		continue;
+	    xmlTextWriterWriteString(xw, ss(string("===") + citr->first + string("===\n")));
+	    write_extent(xw, spillfd_, ext->offset_, ext->length_);
 	}
-	xmlNewProp(xsuite, s("errors"), ss(dec(nerrs)));
-	xmlNewProp(xsuite, s("time"), ss(rel_format(sns)));
+	xmlTextWriterEndElement(xw);
+    }
 
-	xmlAddChild(xmlAddChild(xsuite, xmlNewNode(NULL, s("system-out"))), xmlNewText(ss(all_stdout)));
-	xmlAddChild(xmlAddChild(xsuite, xmlNewNode(NULL, s("system-err"))), xmlNewText(ss(all_stderr)));
+    xmlTextWriterEndDocument(xw);
+    xmlFreeTextWriter(xw);
 
-	string filename = directory + string("/TEST-") + suitename + ".xml";
+    if (rename(tmpfile.c_str(), filename.c_str()) < 0)
+    {
+	fprintf(stderr, "np: failed to write JUnit XML file %s: %s\n",
+		filename.c_str(), strerror(errno));
+	unlink(tmpfile.c_str());
+    }
+}
 
-	int r = xmlSaveFileEnc(filename.c_str(), xdoc, "UTF-8");
-	if (r < 0)
-	{
-	    fprintf(stderr, "np: failed to write JUnit XML file %s: %s\n",
-		    filename.c_str(), strerror(errno));
-	}
-	xmlFreeDoc(xdoc);
+void
+junit_listener_t::end()
+{
+    /* write whatever is left, e.g. if the run was cut short */
+    map<string, suite_t>::iterator sitr;
+    for (sitr = suites_.begin() ; sitr != suites_.end() ; ++sitr)
+    {
+	if (sitr->second.cases_.size())
+	    write_suite(sitr->first, &sitr->second);
     }
+    suites_.clear();
 }
 
 junit_listener_t::case_t *
 junit_listener_t::find_case(const job_t *j)
 {
-    string suitename = j->get_node()->get_parent()->get_fullname();
+    string suitename = get_suitename(j->get_node());
 
     string jobname = j->as_string();
     int off = jobname.find(suitename);
@@ -176,8 +360,19 @@ junit_listener_t::end_job(const job_t *j, result_t res)
     case_t *c = find_case(j);
     c->result_ = res;
     c->elapsed_ = j->get_elapsed();
-    c->stdout_ = j->get_stdout();
-    c->stderr_ = j->get_stderr();
+    spill(j->get_stdout(), &c->stdout_);
+    spill(j->get_stderr(), &c->stderr_);
+
+    string suitename = get_suitename(j->get_node());
+    map<string, suite_t>::iterator sitr = suites_.find(suitename);
+    suite_t *suite = &sitr->second;
+    suite->nended_++;
+    if (suite->nexpected_ && suite->nended_ >= suite->nexpected_)
+    {
+	/* that was the last job in the suite */
+	write_suite(suitename, suite);
+	suites_.erase(sitr);
+    }
 }
 
 void
@@ -17,18 +17,29 @@
 #define __NP_JUNIT_LISTENER_H__ 1
 
 #include "np/listener.hxx"
+#include <map>
 
 namespace np {
 
+class testnode_t;
+
+/*
+ * Writes a JUnit XML file for each suite (the parent node of each
+ * test) in the reports/ directory.  Each suite's file is written as
+ * soon as the last of its jobs ends, so only the suites which still
+ * have jobs running are kept in memory, and the captured output of
+ * those is kept in a temporary spill file rather than in memory.
+ */
 class junit_listener_t : public listener_t
 {
 public:
-    junit_listener_t() {}
-    ~junit_listener_t() {}
+    junit_listener_t();
+    ~junit_listener_t();
 
     // TODO: methods to allow changing the base directory
 
     bool needs_stdout() const;
+    void set_plan(plan_t *);
     void begin();
     void end();
     void begin_job(const job_t *);
@@ -36,6 +47,14 @@ public:
     void add_event(const job_t *, const event_t *);
 
 private:
+    /* a range of the spill file */
+    struct extent_t
+    {
+	extent_t() : offset_(0), length_(0) {}
+	off_t offset_;
+	size_t length_;
+    };
+
     struct case_t
     {
 	case_t()
@@ -45,24 +64,34 @@ private:
 	{ }
 	~case_t();
 
-	std::string name_;
 	result_t result_;
 	event_t *event_;
 	int64_t elapsed_;
-	std::string stdout_;
-	std::string stderr_;
+	extent_t stdout_;
+	extent_t stderr_;
     };
 
     struct suite_t
     {
+	suite_t() : nexpected_(0), nended_(0) {}
+
+	unsigned int nexpected_;    /* jobs in the plan */
+	unsigned int nended_;
 	std::map<std::string, case_t> cases_;
     };
 
     std::string get_hostname() const;
     std::string get_timestamp() const;
+    static std::string get_suitename(testnode_t *tn);
     case_t *find_case(const job_t *j);
+    bool spill(const std::string &s, extent_t *ext);
+    void write_suite(const std::string &suitename, const suite_t *suite);
 
     std::map<std::string, suite_t> suites_;
+    std::string hostname_;
+    std::string directory_;
+    int spillfd_;
+    off_t spillpos_;
 };
 
 // close the namespace
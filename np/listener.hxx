@@ -24,6 +24,7 @@ namespace np {
 
 class event_t;
 class job_t;
+class plan_t;
 
 class listener_t
 {
@@ -32,6 +33,8 @@ public:
     virtual ~listener_t() {}
 
     virtual bool needs_stdout() const { return false; }
+    /* called before begin() with the plan about to be run */
+    virtual void set_plan(plan_t *) {}
     virtual void begin() = 0;
     virtual void end() = 0;
     virtual void begin_job(const job_t *) = 0;
@@ -0,0 +1,401 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include "np/metrics.hxx"
+#include "np/plan.hxx"
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+/* histogram bucket upper bounds, in seconds */
+static const double duration_bounds[] =
+{
+    0.001, 0.01, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300
+};
+static const double reap_delay_bounds[] =
+{
+    0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1
+};
+#define NBOUNDS(b)  (sizeof(b)/sizeof(b[0]))
+
+metrics_t::histogram_t::histogram_t(const double *bounds, unsigned int nbounds)
+ :  bounds_(bounds),
+    nbounds_(nbounds),
+    count_(0),
+    sum_(0.0)
+{
+    assert(nbounds <= MAX_BOUNDS);
+    memset(counts_, 0, sizeof(counts_));
+}
+
+void
+metrics_t::histogram_t::observe(int64_t ns)
+{
+    double secs = (double)ns / NANOSEC_PER_SEC;
+    unsigned int i;
+
+    for (i = 0 ; i < nbounds_ && secs > bounds_[i] ; i++)
+	;
+    counts_[i]++;
+    count_++;
+    sum_ += secs;
+}
+
+void
+metrics_t::histogram_t::format(string &s, const char *name, const char *help) const
+{
+    char buf[256];
+    uint64_t cumulative = 0;
+
+    snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s histogram\n",
+	     name, help, name);
+    s += buf;
+    for (unsigned int i = 0 ; i <= nbounds_ ; i++)
+    {
+	cumulative += counts_[i];
+	if (i < nbounds_)
+	    snprintf(buf, sizeof(buf), "%s_bucket{le=\"%g\"} %llu\n",
+		     name, bounds_[i], (unsigned long long)cumulative);
+	else
+	    snprintf(buf, sizeof(buf), "%s_bucket{le=\"+Inf\"} %llu\n",
+		     name, (unsigned long long)cumulative);
+	s += buf;
+    }
+    snprintf(buf, sizeof(buf), "%s_sum %.6f\n%s_count %llu\n",
+	     name, sum_, name, (unsigned long long)count_);
+    s += buf;
+}
+
+metrics_t::metrics_t(const char *path)
+ :  path_(xstrdup(path)),
+    fd_(-1),
+    owner_(getpid()),
+    duration_(duration_bounds, NBOUNDS(duration_bounds)),
+    reap_delay_(reap_delay_bounds, NBOUNDS(reap_delay_bounds))
+{
+}
+
+metrics_t::~metrics_t()
+{
+    stop();
+    xfree(path_);
+}
+
+bool
+metrics_t::listen()
+{
+    struct sockaddr_un sun;
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    if (strlen(path_) >= sizeof(sun.sun_path))
+    {
+	fprintf(stderr, "np: socket path too long: %s\n", path_);
+	return false;
+    }
+    strcpy(sun.sun_path, path_);
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0)
+    {
+	perror("np: socket");
+	return false;
+    }
+    fcntl(fd_, F_SETFD, FD_CLOEXEC);
+    fcntl(fd_, F_SETFL, O_NONBLOCK);
+
+    /* a socket left behind by an earlier run is just replaced,
+     * but anything else at that path is left well alone */
+    struct stat sb;
+    if (lstat(path_, &sb) == 0 && S_ISSOCK(sb.st_mode))
+	unlink(path_);
+    if (bind(fd_, (struct sockaddr *)&sun, sizeof(sun)) < 0)
+    {
+	perror(path_);
+	close(fd_);
+	fd_ = -1;
+	return false;
+    }
+    if (::listen(fd_, MAX_CLIENTS) < 0)
+    {
+	perror("np: listen");
+	stop();
+	return false;
+    }
+    return true;
+}
+
+void
+metrics_t::stop()
+{
+    vector<client_t*>::iterator itr;
+    for (itr = clients_.begin() ; itr != clients_.end() ; ++itr)
+    {
+	close((*itr)->fd_);
+	delete *itr;
+    }
+    clients_.clear();
+
+    if (fd_ >= 0)
+    {
+	close(fd_);
+	fd_ = -1;
+	/* forked children get a copy of us, but the
+	 * socket file belongs to the runner */
+	if (getpid() == owner_)
+	    unlink(path_);
+    }
+}
+
+void
+metrics_t::begin(plan_t *plan, unsigned int maxchildren)
+{
+    start_ = rel_now();
+    maxchildren_ = maxchildren;
+    plan_t::iterator pitr;
+    for (pitr = plan->begin() ; pitr != plan->end() ; ++pitr)
+	nplanned_++;
+}
+
+void
+metrics_t::begin_job()
+{
+    nstarted_++;
+    nrunning_++;
+}
+
+void
+metrics_t::end_job(result_t res, int64_t elapsed, int64_t reap_delay)
+{
+    nrunning_--;
+    ndone_++;
+    nresults_[res]++;
+    duration_.observe(elapsed);
+    if (reap_delay >= 0)
+	reap_delay_.observe(reap_delay);
+}
+
+void
+metrics_t::get_pollfds(vector<struct pollfd> &pfd) const
+{
+    struct pollfd p;
+
+    if (fd_ < 0)
+	return;
+    memset(&p, 0, sizeof(p));
+    p.fd = fd_;
+    p.events = POLLIN;
+    pfd.push_back(p);
+
+    vector<client_t*>::const_iterator itr;
+    for (itr = clients_.begin() ; itr != clients_.end() ; ++itr)
+    {
+	p.fd = (*itr)->fd_;
+	p.events = ((*itr)->responding_ ? POLLOUT : POLLIN);
+	pfd.push_back(p);
+    }
+}
+
+void
+metrics_t::handle_poll(const struct pollfd *pfd)
+{
+    if (fd_ < 0)
+	return;
+
+    /* clients first, as accepting changes the list */
+    vector<client_t*> keep;
+    vector<client_t*>::iterator itr;
+    const struct pollfd *p = pfd+1;
+    for (itr = clients_.begin() ; itr != clients_.end() ; ++itr, ++p)
+    {
+	client_t *c = *itr;
+	bool done = false;
+	if ((p->revents & (POLLERR|POLLNVAL)))
+	    done = true;
+	else if ((p->revents & (POLLIN|POLLHUP)) && !c->responding_)
+	    done = read_request(c);
+	else if ((p->revents & POLLOUT) && c->responding_)
+	    done = write_response(c);
+	if (done)
+	{
+	    close(c->fd_);
+	    delete c;
+	}
+	else
+	{
+	    keep.push_back(c);
+	}
+    }
+    clients_.swap(keep);
+
+    if ((pfd->revents & POLLIN))
+	accept_clients();
+}
+
+void
+metrics_t::accept_clients()
+{
+    for (;;)
+    {
+	int cfd = accept(fd_, NULL, NULL);
+	if (cfd < 0)
+	{
+	    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		perror("np: accept");
+	    return;
+	}
+	if (clients_.size() >= MAX_CLIENTS)
+	{
+	    close(cfd);
+	    continue;
+	}
+	fcntl(cfd, F_SETFD, FD_CLOEXEC);
+	fcntl(cfd, F_SETFL, O_NONBLOCK);
+	clients_.push_back(new client_t(cfd));
+    }
+}
+
+/*
+ * Returns true when the client is finished with.  The response
+ * is written once a blank line ends an HTTP request, or once the
+ * client shuts down its side of the connection.
+ */
+bool
+metrics_t::read_request(client_t *c)
+{
+    char buf[1024];
+    bool eof = false;
+
+    for (;;)
+    {
+	ssize_t r = read(c->fd_, buf, sizeof(buf));
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		break;
+	    return true;
+	}
+	if (r == 0)
+	{
+	    eof = true;
+	    break;
+	}
+	c->in_.append(buf, r);
+    }
+
+    bool http = !strncmp(c->in_.c_str(), "GET ", 4);
+    if (!eof &&
+	c->in_.size() < MAX_REQUEST &&
+	c->in_.find("\r\n\r\n") == string::npos &&
+	c->in_.find("\n\n") == string::npos)
+	return false;	    /* wait for the rest of the request */
+
+    string body = format();
+    if (http)
+    {
+	char hdr[256];
+	snprintf(hdr, sizeof(hdr),
+		 "HTTP/1.0 200 OK\r\n"
+		 "Content-Type: text/plain; version=0.0.4\r\n"
+		 "Content-Length: %lu\r\n"
+		 "Connection: close\r\n"
+		 "\r\n",
+		 (unsigned long)body.size());
+	c->out_ = hdr;
+    }
+    c->out_ += body;
+    c->responding_ = true;
+    return write_response(c);
+}
+
+bool
+metrics_t::write_response(client_t *c)
+{
+    while (c->outpos_ < c->out_.size())
+    {
+	ssize_t r = send(c->fd_, c->out_.data() + c->outpos_,
+			 c->out_.size() - c->outpos_, MSG_NOSIGNAL);
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		return false;	/* wait for POLLOUT */
+	    return true;
+	}
+	c->outpos_ += r;
+    }
+    shutdown(c->fd_, SHUT_WR);
+    return true;
+}
+
+static void
+format_metric(string &s, const char *name, const char *type,
+	      const char *help, double value)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s %s\n%s %.10g\n",
+	     name, help, name, type, name, value);
+    s += buf;
+}
+
+string
+metrics_t::format() const
+{
+    string s;
+    char buf[256];
+
+    format_metric(s, "np_jobs_queued", "gauge",
+		  "Jobs in the plan which have not started yet.",
+		  nplanned_ > nstarted_ ? nplanned_ - nstarted_ : 0);
+    format_metric(s, "np_jobs_running", "gauge",
+		  "Jobs currently running.", nrunning_);
+    format_metric(s, "np_jobs_done_total", "counter",
+		  "Jobs which have finished.", ndone_);
+
+    s += "# HELP np_job_results_total Finished jobs by result.\n"
+	 "# TYPE np_job_results_total counter\n";
+    static const result_t results[] = { R_PASS, R_NOTAPPLICABLE, R_FAIL };
+    for (unsigned int i = 0 ; i < NBOUNDS(results) ; i++)
+    {
+	snprintf(buf, sizeof(buf), "np_job_results_total{result=\"%s\"} %u\n",
+		 as_string(results[i]), nresults_[results[i]]);
+	s += buf;
+    }
+
+    int64_t elapsed = rel_now() - start_;
+    format_metric(s, "np_jobs_per_second", "gauge",
+		  "Jobs finished per second since the run began.",
+		  elapsed > 0 ? (double)ndone_ * NANOSEC_PER_SEC / elapsed : 0.0);
+    format_metric(s, "np_concurrency_limit", "gauge",
+		  "Most child processes which may run jobs at once.",
+		  maxchildren_);
+
+    duration_.format(s, "np_job_duration_seconds",
+		     "How long each job took to run.");
+    reap_delay_.format(s, "np_reap_delay_seconds",
+		       "Time from a child exiting until the runner reaped it.");
+    return s;
+}
+
+// close the namespace
+};
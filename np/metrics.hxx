@@ -0,0 +1,113 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_METRICS_H__
+#define __NP_METRICS_H__ 1
+
+#include "np/util/common.hxx"
+#include "np/types.hxx"
+#include <vector>
+
+namespace np {
+
+class plan_t;
+
+/*
+ * Serves live statistics about a run, in the Prometheus text
+ * exposition format, on a Unix domain socket.  The runner keeps the
+ * counters up to date as jobs start and finish, and polls the socket
+ * alongside its children's descriptors; clients are only ever read
+ * from and written to without blocking, so a slow or stuck client
+ * cannot hold up the runner.
+ *
+ * A client may send an HTTP request, e.g.
+ *
+ *	curl --unix-socket SOCKET http://localhost/metrics
+ *
+ * or just shut down its side of the connection, in which case the
+ * metrics are sent without any HTTP headers.
+ */
+class metrics_t : public np::util::zalloc
+{
+public:
+    metrics_t(const char *path);
+    ~metrics_t();
+
+    bool listen();
+    void stop();
+
+    void begin(plan_t *plan, unsigned int maxchildren);
+    void begin_job();
+    /* reap_delay is negative when the job was not run by a child */
+    void end_job(result_t res, int64_t elapsed, int64_t reap_delay);
+
+    /* appends our descriptors, and handles them after poll() */
+    void get_pollfds(std::vector<struct pollfd> &pfd) const;
+    void handle_poll(const struct pollfd *pfd);
+
+    enum { MAX_CLIENTS = 8, MAX_REQUEST = 4096 };
+
+private:
+    struct histogram_t
+    {
+	histogram_t(const double *bounds, unsigned int nbounds);
+
+	void observe(int64_t ns);
+	void format(std::string &s, const char *name, const char *help) const;
+
+	const double *bounds_;	/* in seconds */
+	unsigned int nbounds_;
+	enum { MAX_BOUNDS = 16 };
+	uint64_t counts_[MAX_BOUNDS+1];	/* the last is for +Inf */
+	uint64_t count_;
+	double sum_;
+    };
+
+    struct client_t
+    {
+	client_t(int fd) : fd_(fd), responding_(false), outpos_(0) {}
+
+	int fd_;
+	bool responding_;
+	std::string in_;
+	std::string out_;
+	size_t outpos_;
+    };
+
+    void accept_clients();
+    bool read_request(client_t *c);
+    bool write_response(client_t *c);
+    std::string format() const;
+
+    char *path_;
+    int fd_;
+    pid_t owner_;
+    std::vector<client_t*> clients_;
+
+    int64_t start_;
+    unsigned int maxchildren_;
+    unsigned int nplanned_;
+    unsigned int nstarted_;
+    unsigned int nrunning_;
+    unsigned int ndone_;
+    unsigned int nresults_[R_FAIL+1];
+    histogram_t duration_;
+    histogram_t reap_delay_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_METRICS_H__ */
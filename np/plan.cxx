@@ -94,6 +94,7 @@ void plan_t::iterator::find_testable_node()
 	    ++vitr_;
 	    if (vitr_ == vend_)
 		return;	    // end of iteration
+	    nitr_ = *vitr_;
 	}
 	if ((*nitr_)->get_function(FT_TEST))
 	{
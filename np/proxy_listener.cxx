@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 #include "np/proxy_listener.hxx"
+#include "np/job.hxx"
+#include "np/ring.hxx"
 #include "except.h"
 #include "np_priv.h"
 
@@ -23,133 +25,243 @@ enum proxy_call
 {
     PROXY_EVENT = 1,
     PROXY_FINISHED = 2,
+    PROXY_PHASES = 3,
 };
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
-static void
-serialise_uint(int fd, unsigned int i)
+/* Strings are encoded as a uint32 length including a trailing
+ * NUL, so that they can be used in place in the received frame. */
+static unsigned int
+string_length(const char *s)
 {
-    write(fd, &i, sizeof(i));
+    return sizeof(uint32_t) + (s ? strlen(s)+1 : 0);
 }
 
-static void
-serialise_string(int fd, const char *s)
+static char *
+serialise_uint(char *p, unsigned int i)
 {
-    unsigned int len = (s ? strlen(s) : 0);
-    serialise_uint(fd, len);
-    if (len)
-    {
-	write(fd, s, len);
-	write(fd, "\0", 1);
-    }
+    uint32_t u = i;
+    memcpy(p, &u, sizeof(u));
+    return p + sizeof(u);
+}
+
+static char *
+serialise_int64(char *p, int64_t i)
+{
+    memcpy(p, &i, sizeof(i));
+    return p + sizeof(i);
 }
 
-static void
-serialise_event(int fd, const event_t *ev)
+static char *
+serialise_string(char *p, const char *s)
 {
-    serialise_uint(fd, ev->which);
-    serialise_string(fd, ev->description);
-    serialise_uint(fd, ev->locflags);
-    serialise_string(fd, ev->filename);
-    serialise_uint(fd, ev->lineno);
-    serialise_string(fd, ev->function);
-    serialise_uint(fd, ev->functype);
+    unsigned int len = (s ? strlen(s)+1 : 0);
+    p = serialise_uint(p, len);
+    memcpy(p, s, len);
+    return p + len;
 }
 
-static int
-deserialise_bytes(int fd, char *p, unsigned int len)
+static unsigned int
+event_length(const event_t *ev)
 {
-    int r;
+    return 5 * sizeof(uint32_t) +
+	   string_length(ev->description) +
+	   string_length(ev->filename) +
+	   string_length(ev->function);
+}
 
+static char *
+serialise_event(char *p, const event_t *ev)
+{
+    p = serialise_uint(p, PROXY_EVENT);
+    p = serialise_uint(p, ev->which);
+    p = serialise_string(p, ev->description);
+    p = serialise_uint(p, ev->locflags);
+    p = serialise_string(p, ev->filename);
+    p = serialise_uint(p, ev->lineno);
+    p = serialise_string(p, ev->function);
+    p = serialise_uint(p, ev->functype);
+    return p;
+}
+
+static bool
+write_all(int fd, const char *p, unsigned int len)
+{
     while (len)
     {
-	r = read(fd, p, len);
-	if (r < 0) {
-	    perror("np: error reading from proxy");
-	    return -errno;
-	}
-	if (r == 0) {
-	    fprintf(stderr, "np: unexpected EOF deserialising from proxy\n");
-	    return -EINVAL;
+	int r = write(fd, p, len);
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    return false;
 	}
 	len -= r;
 	p += r;
     }
-    return 0;
+    return true;
 }
 
-static int
-deserialise_uint(int fd, unsigned int *ip)
+/* Walks over the calls in a received frame */
+class frame_reader_t
 {
-    return deserialise_bytes(fd, (char *)ip, sizeof(*ip));
-}
+public:
+    frame_reader_t(char *p, unsigned int len)
+     :  p_(p), end_(p + len), ok_(true) {}
 
-static int
-deserialise_string(int fd, char *buf, unsigned int maxlen)
-{
-    unsigned int len;
-    int r;
-    if ((r = deserialise_uint(fd, &len)))
-	return r;
-    if (len >= maxlen)
-	return -ENAMETOOLONG;
-    if (!len)
+    bool at_end() const { return p_ == end_; }
+    bool ok() const { return ok_; }
+
+    unsigned int get_uint()
     {
-	buf[0] = '\0';
-	return 0;
+	uint32_t u = 0;
+	if (end_ - p_ < (int)sizeof(u))
+	{
+	    ok_ = false;
+	    return 0;
+	}
+	memcpy(&u, p_, sizeof(u));
+	p_ += sizeof(u);
+	return u;
     }
-    return deserialise_bytes(fd, buf, len+1);
-}
+
+    char *get_bytes(unsigned int len)
+    {
+	if (!ok_ || (unsigned int)(end_ - p_) < len)
+	{
+	    ok_ = false;
+	    return 0;
+	}
+	char *p = p_;
+	p_ += len;
+	return p;
+    }
+
+    int64_t get_int64()
+    {
+	int64_t i = 0;
+	char *p = get_bytes(sizeof(i));
+	if (p)
+	    memcpy(&i, p, sizeof(i));
+	return i;
+    }
+
+    const char *get_string()
+    {
+	unsigned int len = get_uint();
+	if (!ok_ || (unsigned int)(end_ - p_) < len || (len && p_[len-1]))
+	{
+	    ok_ = false;
+	    return "";
+	}
+	const char *s = (len ? p_ : "");
+	p_ += len;
+	return s;
+    }
+
+private:
+    char *p_;
+    char *end_;
+    bool ok_;
+};
 
 static bool
-deserialise_event(int fd, event_t *ev)
-{
-    int r;
-    unsigned int which;
-    unsigned int locflags;
-    unsigned int lineno;
-    unsigned int ft;
-    static char description_buf[1024];
-    static char filename_buf[1024];
-    static char function_buf[1024];
-
-    if ((r = deserialise_uint(fd, &which)))
-	return r;
-    if ((r = deserialise_string(fd, description_buf,
-				sizeof(description_buf))))
-	return r;
-    if ((r = deserialise_uint(fd, &locflags)))
-	return r;
-    if ((r = deserialise_string(fd, filename_buf,
-				sizeof(filename_buf))))
-	return r;
-    if ((r = deserialise_uint(fd, &lineno)))
-	return r;
-    if ((r = deserialise_string(fd, function_buf,
-				sizeof(function_buf))))
-	return r;
-    if ((r = deserialise_uint(fd, &ft)))
-	return r;
-    ev->which = (enum events_t)which;
-    ev->description = description_buf;
-    ev->locflags = locflags;
-    ev->lineno = lineno;
-    ev->filename = filename_buf;
-    ev->function = function_buf;
-    ev->functype = (functype_t)ft;
-    return 0;
+deserialise_event(frame_reader_t &fr, event_t *ev)
+{
+    ev->which = (enum events_t)fr.get_uint();
+    ev->description = fr.get_string();
+    ev->locflags = fr.get_uint();
+    ev->filename = fr.get_string();
+    ev->lineno = fr.get_uint();
+    ev->function = fr.get_string();
+    ev->functype = (functype_t)fr.get_uint();
+    return fr.ok();
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
-proxy_listener_t::proxy_listener_t(int fd)
- :  fd_(fd)
+proxy_listener_t *proxy_listener_t::instance_;
+
+proxy_listener_t::proxy_listener_t(int fd, ring_t *ring)
+ :  fd_(fd),
+    ring_(ring),
+    use_pipe_(false),
+    framelen_(0),
+    flushing_(false),
+    assembling_(false)
 {
+    /* The runner sends SIGTERM to a child which has timed out; make
+     * sure any batched events get to the parent before we die. */
+    instance_ = this;
+    signal(SIGTERM, handle_sigterm);
 }
 
 proxy_listener_t::~proxy_listener_t()
 {
+    flush();
+    if (instance_ == this)
+    {
+	signal(SIGTERM, SIG_DFL);
+	instance_ = 0;
+    }
+}
+
+void
+proxy_listener_t::handle_sigterm(int sig)
+{
+    if (instance_ && !instance_->flushing_ && !instance_->assembling_)
+	instance_->flush();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/*
+ * Returns a pointer to space for a call of @a len bytes at the end of
+ * the frame being assembled, sending the frame first if it's too full.
+ * Returns NULL if the call is too large to fit into any frame.
+ */
+char *
+proxy_listener_t::reserve(unsigned int len)
+{
+    if (sizeof(uint32_t) + framelen_ + len > FRAME_MAX)
+	flush();
+    if (sizeof(uint32_t) + len > FRAME_MAX)
+	return 0;
+    return frame_ + sizeof(uint32_t) + framelen_;
+}
+
+void
+proxy_listener_t::flush()
+{
+    if (!framelen_)
+	return;
+    flushing_ = true;
+    serialise_uint(frame_, framelen_);
+    send(frame_, sizeof(uint32_t) + framelen_);
+    framelen_ = 0;
+    flushing_ = false;
+}
+
+void
+proxy_listener_t::send(const char *p, unsigned int len)
+{
+    if (ring_ && !use_pipe_)
+    {
+	if (ring_->put(p, len))
+	{
+	    if (ring_->take_doorbell())
+	    {
+		static const char doorbell[sizeof(uint32_t)] = { 0 };
+		write_all(fd_, doorbell, sizeof(doorbell));
+	    }
+	    return;
+	}
+	/* The parent isn't keeping up.  Switching back to the ring
+	 * later could reorder calls, so stay on the pipe. */
+	use_pipe_ = true;
+    }
+    write_all(fd_, p, len);
 }
 
 void
@@ -168,58 +280,158 @@ proxy_listener_t::begin_job(const job_t *)
 }
 
 void
-proxy_listener_t::end_job(const job_t *j __attribute__((unused)),
-			  result_t res)
+proxy_listener_t::end_job(const job_t *j, result_t res)
+{
+    unsigned int len = 3 * sizeof(uint32_t) + job_t::PH_NUM * sizeof(int64_t);
+    char *p = reserve(len);
+    assembling_ = true;
+    p = serialise_uint(p, PROXY_PHASES);
+    for (int ph = 0 ; ph < job_t::PH_NUM ; ph++)
+	p = serialise_int64(p, j->get_phase_start((job_t::phase_t)ph));
+    p = serialise_uint(p, PROXY_FINISHED);
+    p = serialise_uint(p, res);
+    framelen_ += len;
+    assembling_ = false;
+    flush();
+}
+
+void
+proxy_listener_t::add_event(const job_t *j, const event_t *ev)
 {
-    serialise_uint(fd_, PROXY_FINISHED);
-    serialise_uint(fd_, res);
+    unsigned int len = event_length(ev);
+    char *p = reserve(len);
+    if (p)
+    {
+	/* a signal handler mustn't send the frame from under us */
+	assembling_ = true;
+	serialise_event(p, ev);
+	framelen_ += len;
+	assembling_ = false;
+	if (ev->get_result() == R_FAIL)
+	    flush();
+    }
+    else if (len <= FRAME_LIMIT)
+    {
+	/* too big to batch, send it in a frame by itself */
+	char *buf = (char *)np::util::xmalloc(sizeof(uint32_t) + len);
+	serialise_event(serialise_uint(buf, len), ev);
+	send(buf, sizeof(uint32_t) + len);
+	free(buf);
+    }
+    else
+    {
+	/* too big for the parent to accept, cut the description short */
+	static const char ellipsis[] = "...";
+	unsigned int over = len - FRAME_LIMIT + sizeof(ellipsis)-1;
+	unsigned int dlen = (ev->description ? strlen(ev->description) : 0);
+	if (over > dlen)
+	{
+	    fprintf(stderr, "np: event too large to send, dropping it\n");
+	    return;
+	}
+	std::string desc = std::string(ev->description, dlen - over) + ellipsis;
+	event_t cut(ev->which, desc.c_str());
+	cut.locflags = ev->locflags;
+	cut.filename = ev->filename;
+	cut.lineno = ev->lineno;
+	cut.function = ev->function;
+	cut.functype = ev->functype;
+	add_event(j, &cut);
+    }
 }
 
+/*
+ * Sends an event from a signal handler.  This only uses calls which
+ * are async-signal-safe: anything already batched is sent first
+ * (unless the signal interrupted us sending it or adding a call to
+ * it, when the frame isn't in a fit state to send), then the event in
+ * a frame of its own built in a static buffer.  The event isn't
+ * normalised here; the parent does that when it arrives.
+ */
 void
-proxy_listener_t::add_event(const job_t *j __attribute__((unused)),
-			    const event_t *ev)
+proxy_listener_t::add_event_from_signal(const event_t *ev)
 {
-    serialise_uint(fd_, PROXY_EVENT);
-    serialise_event(fd_, ev);
+    static char buf[4*FRAME_MAX];
+    proxy_listener_t *self = instance_;
+
+    if (!self)
+	return;
+    if (!self->flushing_ && !self->assembling_)
+	self->flush();
+    unsigned int len = event_length(ev);
+    if (sizeof(uint32_t) + len > sizeof(buf))
+	return;
+    serialise_event(serialise_uint(buf, len), ev);
+    self->send(buf, sizeof(uint32_t) + len);
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 /*
- * Handles input on the read end of the event pipe.  Returns false
- * when we should stop calling it, which might be due to a normal
- * end of test condition (FINISHED proxy call) or to some error.
- * Updates *@resp if necessary.
+ * Handles the frames at the start of a buffer which have fully arrived,
+ * from the event pipe or the ring, and sets *@usedp to the number of
+ * bytes they took up; any partial frame at the end is left for later.
+ * Returns false when we should stop calling it, which might be due to
+ * a normal end of test condition (FINISHED proxy call) or to some
+ * error.  Updates *@resp if necessary.
  */
 bool
-proxy_listener_t::handle_call(int fd, job_t *j, result_t *resp)
+proxy_listener_t::handle_frames(char *p, unsigned int len, unsigned int *usedp,
+				job_t *j, result_t *resp)
 {
-    unsigned int which;
+    frame_reader_t frames(p, len);
     event_t ev;
-    unsigned int res;
-    int r;
 
-    r = deserialise_uint(fd, &which);
-    if (r)
-	return false;
-    switch (which)
+    *usedp = 0;
+    while (len - *usedp >= sizeof(uint32_t))
     {
-    case PROXY_EVENT:
-	if ((r = deserialise_event(fd, &ev)))
-	    return false;    /* failed to decode */
-	*resp = merge(*resp, np::runner_t::running()->raise_event(j, &ev));
-	return true;	    /* call me again */
-    case PROXY_FINISHED:
-	if ((r = deserialise_uint(fd, &res)))
-	    return false;    /* failed to decode */
-	*resp = merge(*resp, (result_t)res);
-	return false;	      /* end of test, expect no more calls */
-    default:
-	fprintf(stderr,
-		"np: can't decode proxy call (which=%u)\n",
-		which);
-	return false;
+	unsigned int flen = frames.get_uint();
+	if (flen > FRAME_LIMIT)
+	{
+	    fprintf(stderr, "np: bad proxy frame length %u\n", flen);
+	    return false;
+	}
+	char *fp = frames.get_bytes(flen);
+	if (!fp)
+	    break;	/* the rest hasn't arrived yet */
+	*usedp += sizeof(uint32_t) + flen;
+
+	/* an empty frame is just a doorbell */
+	frame_reader_t fr(fp, flen);
+	while (!fr.at_end())
+	{
+	    unsigned int which = fr.get_uint();
+	    switch (which)
+	    {
+	    case PROXY_EVENT:
+		if (!deserialise_event(fr, &ev))
+		    return false;    /* failed to decode */
+		*resp = merge(*resp, np::runner_t::running()->raise_event(j, &ev));
+		break;
+	    case PROXY_PHASES:
+		for (int ph = 0 ; ph < job_t::PH_NUM ; ph++)
+		{
+		    int64_t t = fr.get_int64();
+		    if (j)
+			j->set_phase_start((job_t::phase_t)ph, t);
+		}
+		if (!fr.ok())
+		    return false;    /* failed to decode */
+		break;
+	    case PROXY_FINISHED:
+		*resp = merge(*resp, (result_t)fr.get_uint());
+		if (!fr.ok())
+		    return false;    /* failed to decode */
+		return false;	    /* end of test, expect no more calls */
+	    default:
+		fprintf(stderr,
+			"np: can't decode proxy call (which=%u)\n",
+			which);
+		return false;
+	    }
+	}
     }
+    return true;	    /* call me again */
 }
 
 // close the namespace
@@ -21,10 +21,31 @@
 
 namespace np {
 
+class ring_t;
+
+/*
+ * Passes events from the child process where a test runs back to the
+ * runner in the parent process, over a pipe.  Calls are sent in
+ * frames: a uint32 length followed by that many bytes of payload,
+ * holding one or more calls.  Each frame is written with a single
+ * write(); the parent reads whatever is available without blocking
+ * and handles the frames which have fully arrived.
+ *
+ * When given a ring_t shared with the parent, frames are put in the
+ * ring and the pipe only carries empty frames as doorbells, unless the
+ * ring fills up, when the child uses the pipe for the rest of the test.
+ * The parent always drains the ring before reading from the pipe, so
+ * calls arrive in order either way.
+ *
+ * Events which don't fail the test (e.g. syslog messages) are batched
+ * into the same frame until it fills, an event which does fail the
+ * test is raised, the test finishes, or the child is sent SIGTERM
+ * because it timed out.
+ */
 class proxy_listener_t : public listener_t
 {
 public:
-    proxy_listener_t(int);
+    proxy_listener_t(int, ring_t * = 0);
     ~proxy_listener_t();
 
     void begin();
@@ -33,11 +54,35 @@ public:
     void end_job(const job_t *, result_t);
     void add_event(const job_t *, const event_t *ev);
 
+    /* for the child's crash handler */
+    static void add_event_from_signal(const event_t *ev);
+
     /* proxyl.c */
-    static bool handle_call(int fd, job_t *, result_t *resp);
+    static bool handle_frames(char *p, unsigned int len, unsigned int *usedp,
+			      job_t *, result_t *resp);
+
+    /* small enough that the pipe write is atomic */
+    enum { FRAME_MAX = 4096 };
+    /* the parent rejects any bigger frame as garbage */
+    enum { FRAME_LIMIT = 1024*1024 };
 
 private:
+    char *reserve(unsigned int len);
+    void flush();
+    void send(const char *p, unsigned int len);
+    static void handle_sigterm(int sig);
+
+    static proxy_listener_t *instance_;
+
     int fd_;
+    ring_t *ring_;
+    bool use_pipe_;	/* the ring filled up */
+    /* frame being assembled; the first 4 bytes hold the length */
+    char frame_[FRAME_MAX];
+    volatile unsigned int framelen_;
+    volatile bool flushing_;
+    /* a call is half way into frame_ */
+    volatile bool assembling_;
 };
 
 // close the namespace
@@ -0,0 +1,347 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/resultlog.hxx"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+static inline uint64_t
+pad8(uint64_t n)
+{
+    return (n + 7) & ~(uint64_t)7;
+}
+
+result_log_t::result_log_t(const char *filename)
+ :  filename_(xstrdup(filename)),
+    fd_(-1),
+    size_(0),
+    run_(0),
+    last_run_(0),
+    base_(0),
+    mapped_(0)
+{
+}
+
+result_log_t::~result_log_t()
+{
+    if (base_)
+	munmap(base_, mapped_);
+    if (fd_ >= 0)
+	close(fd_);
+    xfree(filename_);
+}
+
+/*
+ * Walk the records in the file mapped at @a base, starting at offset
+ * @a off or, if that's 0, at the header.  When @a keep is true,
+ * pointers to the runs and jobs are kept for reading, otherwise the
+ * strings are remembered so we can append without duplicating them.
+ * Sets size_ to the length of the part of the file which holds
+ * complete records.
+ */
+bool
+result_log_t::scan(const char *base, uint64_t size, uint64_t off, bool keep)
+{
+    if (!off)
+    {
+	const header_t *hdr = (const header_t *)base;
+	off = pad8(sizeof(header_t));
+	if (size < off || hdr->magic_ != MAGIC || hdr->version_ != VERSION)
+	{
+	    fprintf(stderr, "np: %s is not a result log\n", filename_);
+	    return false;
+	}
+    }
+
+    while (off + sizeof(uint32_t) <= size)
+    {
+	const char *p = base + off;
+	uint64_t len;
+
+	switch (*(const uint32_t *)p)
+	{
+	case TAG_STRING:
+	    if (off + sizeof(string_record_t) > size)
+		goto done;
+	    len = pad8(sizeof(string_record_t) +
+		       ((const string_record_t *)p)->length_ + 1);
+	    if (off + len > size)
+		goto done;
+	    if (!keep)
+		strings_[string(p + sizeof(string_record_t))] = off;
+	    break;
+	case TAG_RUN:
+	    len = pad8(sizeof(run_record_t));
+	    if (off + len > size)
+		goto done;
+	    if (keep)
+		runs_.push_back((const run_record_t *)p);
+	    else
+		last_run_ = ((const run_record_t *)p)->run_;
+	    break;
+	case TAG_JOB:
+	    len = pad8(sizeof(job_record_t));
+	    if (off + len > size)
+		goto done;
+	    if (keep)
+		jobs_.push_back((const job_record_t *)p);
+	    break;
+	default:
+	    fprintf(stderr, "np: %s: bad record at offset %llu, ignoring the rest\n",
+		    filename_, (unsigned long long)off);
+	    goto done;
+	}
+	off += len;
+    }
+done:
+    size_ = off;
+    return true;
+}
+
+/* Called with the log locked, so size_ is the end of the file */
+bool
+result_log_t::append(const void *rec, size_t len, uint64_t *offp)
+{
+    const char *p = (const char *)rec;
+    size_t remain = len;
+
+    while (remain)
+    {
+	ssize_t r = write(fd_, p, remain);
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    perror(filename_);
+	    return false;
+	}
+	p += r;
+	remain -= r;
+    }
+    if (offp)
+	*offp = size_;
+    size_ += len;
+    return true;
+}
+
+uint64_t
+result_log_t::intern(const string &s)
+{
+    map<string, uint64_t>::iterator itr = strings_.find(s);
+    if (itr != strings_.end())
+	return itr->second;
+
+    size_t len = pad8(sizeof(string_record_t) + s.length() + 1);
+    char *buf = (char *)xmalloc(len);	/* zeroed, so NUL and padding */
+    string_record_t *rec = (string_record_t *)buf;
+    rec->tag_ = TAG_STRING;
+    rec->length_ = s.length();
+    memcpy(buf + sizeof(string_record_t), s.c_str(), s.length());
+
+    uint64_t off = 0;
+    if (append(buf, len, &off))
+	strings_[s] = off;
+    xfree(buf);
+    return off;
+}
+
+/*
+ * Lock the log exclusively, so that concurrent runs take turns to
+ * append to it, and take in any records they appended since we last
+ * held the lock, so that size_ is the end of the file again.
+ */
+bool
+result_log_t::lock()
+{
+    struct stat sb;
+
+    if (flock(fd_, LOCK_EX) < 0)
+    {
+	perror(filename_);
+	return false;
+    }
+    if (fstat(fd_, &sb) < 0)
+    {
+	perror(filename_);
+	goto error;
+    }
+    if ((uint64_t)sb.st_size != size_)
+    {
+	if ((uint64_t)sb.st_size < size_)
+	{
+	    /* not what we wrote, start again */
+	    strings_.clear();
+	    size_ = 0;
+	}
+	if (sb.st_size)
+	{
+	    void *base = mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+	    if (base == MAP_FAILED)
+	    {
+		perror(filename_);
+		goto error;
+	    }
+	    bool ok = scan((const char *)base, sb.st_size, size_, false);
+	    munmap(base, sb.st_size);
+	    if (!ok)
+		goto error;
+	}
+	/* drop any partial record left by a crash */
+	if ((off_t)size_ < sb.st_size && ftruncate(fd_, size_) < 0)
+	{
+	    perror(filename_);
+	    goto error;
+	}
+    }
+    if (lseek(fd_, size_, SEEK_SET) < 0)
+    {
+	perror(filename_);
+	goto error;
+    }
+    return true;
+
+error:
+    unlock();
+    return false;
+}
+
+void
+result_log_t::unlock()
+{
+    flock(fd_, LOCK_UN);
+}
+
+/*
+ * Open the log for appending, creating it if necessary, and start
+ * a new run.
+ */
+bool
+result_log_t::begin_run(const string &exe, const string &build_id)
+{
+    fd_ = open(filename_, O_RDWR|O_CREAT, 0666);
+    if (fd_ < 0)
+    {
+	perror(filename_);
+	return false;
+    }
+    fcntl(fd_, F_SETFD, FD_CLOEXEC);
+    if (!lock())
+	return false;
+
+    bool ok = true;
+    if (size_ == 0)
+    {
+	header_t hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic_ = MAGIC;
+	hdr.version_ = VERSION;
+	ok = append(&hdr, sizeof(hdr), 0);
+    }
+    if (ok)
+    {
+	/* numbered while locked, so concurrent runs get their own */
+	run_record_t rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.tag_ = TAG_RUN;
+	rec.run_ = run_ = last_run_ + 1;
+	rec.timestamp_ = abs_now();
+	rec.exe_ = intern(exe);
+	rec.build_id_ = intern(build_id);
+	ok = append(&rec, sizeof(rec), 0);
+    }
+    unlock();
+    return ok;
+}
+
+bool
+result_log_t::add_job(const string &name, const string &event,
+		      result_t res, int64_t start, int64_t elapsed,
+		      long peak_rss)
+{
+    if (fd_ < 0)
+	return false;
+
+    job_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.tag_ = TAG_JOB;
+    rec.run_ = run_;
+    rec.start_ = start;
+    rec.elapsed_ = elapsed;
+    rec.result_ = res;
+    rec.peak_rss_ = peak_rss;
+
+    if (!lock())
+	return false;
+    rec.name_ = intern(name);
+    rec.event_ = (event == "" ? 0 : intern(event));
+    bool ok = append(&rec, sizeof(rec), 0);
+    unlock();
+    return ok;
+}
+
+/*
+ * Map the whole log read-only, for the get_ functions.
+ */
+bool
+result_log_t::load()
+{
+    struct stat sb;
+
+    fd_ = open(filename_, O_RDONLY, 0);
+    if (fd_ < 0 || fstat(fd_, &sb) < 0)
+    {
+	perror(filename_);
+	return false;
+    }
+    if (sb.st_size == 0)
+    {
+	fprintf(stderr, "np: %s is not a result log\n", filename_);
+	return false;
+    }
+    void *base = mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (base == MAP_FAILED)
+    {
+	perror(filename_);
+	return false;
+    }
+    base_ = (char *)base;
+    mapped_ = sb.st_size;
+    return scan(base_, mapped_, 0, true);
+}
+
+const result_log_t::run_record_t *
+result_log_t::get_run(unsigned int run) const
+{
+    if (run < 1 || run > runs_.size())
+	return 0;
+    return runs_[run-1];
+}
+
+const char *
+result_log_t::get_string(uint64_t off) const
+{
+    if (!off || off + sizeof(string_record_t) > size_)
+	return "";
+    return base_ + off + sizeof(string_record_t);
+}
+
+// close the namespace
+};
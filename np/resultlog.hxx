@@ -0,0 +1,124 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_RESULTLOG_H__
+#define __NP_RESULTLOG_H__ 1
+
+#include "np/util/common.hxx"
+#include "np/types.hxx"
+#include <map>
+#include <vector>
+
+namespace np {
+
+/*
+ * A compact, append-only binary log of test results, which keeps
+ * every run so that results can be analysed over time.  The file
+ * starts with a header_t, followed by any number of records, each
+ * starting with a 32-bit tag and padded to a multiple of 8 bytes:
+ *
+ *  - a string_record_t holds a NUL-terminated string, and is written once
+ *    per distinct string in the file; other records refer to it by
+ *    its offset from the start of the file.
+ *  - a run_record_t starts each run.
+ *  - a job_record_t records the outcome of one job in the most recent run.
+ *
+ * Each record is written with a single write() so a file cut short
+ * by a crash loses at most the last record, and readers can map the
+ * file and use the records in place.  Writers hold an exclusive
+ * flock() while appending, so concurrent runs can share a log.  All numbers are in the byte
+ * order of the machine which wrote them.
+ */
+class result_log_t : public np::util::zalloc
+{
+public:
+    enum
+    {
+	MAGIC = 0x4c52504e,	/* "NPRL" */
+	VERSION = 1,
+	TAG_STRING = 0x53,	/* 'S' */
+	TAG_RUN = 0x52,		/* 'R' */
+	TAG_JOB = 0x4a,		/* 'J' */
+    };
+
+    struct header_t
+    {
+	uint32_t magic_;
+	uint32_t version_;
+    };
+    struct string_record_t
+    {
+	uint32_t tag_;
+	uint32_t length_;	/* not including the NUL */
+	/* followed by the characters and a NUL */
+    };
+    struct run_record_t
+    {
+	uint32_t tag_;
+	uint32_t run_;		/* counting from 1 */
+	int64_t timestamp_;	/* absolute, in nanoseconds */
+	uint64_t exe_;		/* string offset */
+	uint64_t build_id_;	/* string offset */
+    };
+    struct job_record_t
+    {
+	uint32_t tag_;
+	uint32_t run_;
+	uint64_t name_;		/* string offset */
+	uint64_t event_;	/* string offset of first failure, or 0 */
+	int64_t start_;		/* absolute, in nanoseconds */
+	int64_t elapsed_;	/* in nanoseconds */
+	uint32_t result_;	/* a result_t */
+	uint32_t peak_rss_;	/* in KiB, 0 if not known */
+    };
+
+    result_log_t(const char *filename);
+    ~result_log_t();
+
+    /* writing */
+    bool begin_run(const std::string &exe, const std::string &build_id);
+    bool add_job(const std::string &name, const std::string &event,
+		 result_t res, int64_t start, int64_t elapsed, long peak_rss);
+
+    /* reading */
+    bool load();
+    unsigned int get_nruns() const { return runs_.size(); }
+    const run_record_t *get_run(unsigned int run) const;
+    const std::vector<const job_record_t*> &get_jobs() const { return jobs_; }
+    const char *get_string(uint64_t off) const;
+
+private:
+    bool scan(const char *base, uint64_t size, uint64_t off, bool keep);
+    bool lock();
+    void unlock();
+    uint64_t intern(const std::string &s);
+    bool append(const void *rec, size_t len, uint64_t *offp);
+
+    char *filename_;
+    int fd_;
+    uint64_t size_;		/* of the valid part of the file */
+    std::map<std::string, uint64_t> strings_;	/* when writing */
+    uint32_t run_;		/* the run we're writing */
+    uint32_t last_run_;		/* the latest run in the file */
+    char *base_;		/* mapped, when reading */
+    uint64_t mapped_;
+    std::vector<const run_record_t*> runs_;
+    std::vector<const job_record_t*> jobs_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_RESULTLOG_H__ */
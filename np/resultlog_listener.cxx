@@ -0,0 +1,91 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/resultlog_listener.hxx"
+#include "np/resultlog.hxx"
+#include "np/job.hxx"
+#include "np/event.hxx"
+#include "np/spiegel/platform/common.hxx"
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+result_log_listener_t::result_log_listener_t(const char *filename)
+ :  log_(new result_log_t(filename))
+{
+}
+
+result_log_listener_t::~result_log_listener_t()
+{
+    delete log_;
+}
+
+void
+result_log_listener_t::begin()
+{
+    char *exe = np::spiegel::platform::self_exe();
+    string build_id = (exe ? np::spiegel::platform::get_build_id(exe) : string(""));
+
+    if (!log_->begin_run(xstr(exe), build_id))
+    {
+	fprintf(stderr, "np: cannot write result log, continuing without it\n");
+	delete log_;
+	log_ = 0;
+    }
+    xfree(exe);
+}
+
+void
+result_log_listener_t::end()
+{
+}
+
+void
+result_log_listener_t::begin_job(const job_t *j __attribute__((unused)))
+{
+}
+
+void
+result_log_listener_t::add_event(const job_t *j, const event_t *ev)
+{
+    if (!j || ev->get_result() != R_FAIL)
+	return;
+    string &s = failures_[j];
+    if (s == "")
+	s = ev->as_string();
+}
+
+void
+result_log_listener_t::end_job(const job_t *j, result_t res)
+{
+    string event;
+    map<const job_t*, string>::iterator itr = failures_.find(j);
+    if (itr != failures_.end())
+    {
+	event = itr->second;
+	failures_.erase(itr);
+    }
+
+    if (log_)
+	log_->add_job(j->as_string(), event, res,
+		      abs_now() - j->get_elapsed(), j->get_elapsed(),
+		      j->get_peak_rss());
+}
+
+// close the namespace
+};
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_RESULTLOG_LISTENER_H__
+#define __NP_RESULTLOG_LISTENER_H__ 1
+
+#include "np/listener.hxx"
+#include <map>
+
+namespace np {
+
+class result_log_t;
+
+/*
+ * Appends the results of each run to a result_log_t.
+ */
+class result_log_listener_t : public listener_t
+{
+public:
+    result_log_listener_t(const char *filename);
+    ~result_log_listener_t();
+
+    void begin();
+    void end();
+    void begin_job(const job_t *);
+    void end_job(const job_t *, result_t);
+    void add_event(const job_t *, const event_t *ev);
+
+private:
+    result_log_t *log_;
+    /* the first failing event of each running job */
+    std::map<const job_t*, std::string> failures_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_RESULTLOG_LISTENER_H__ */
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <sys/mman.h>
+#include "np/ring.hxx"
+
+namespace np {
+using namespace std;
+
+ring_t *
+ring_t::create()
+{
+    void *p = mmap(NULL, sizeof(ring_t), PROT_READ|PROT_WRITE,
+		   MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+	perror("np: mmap");
+	return 0;
+    }
+    /* fresh anonymous memory is already zeroed */
+    return (ring_t *)p;
+}
+
+void
+ring_t::destroy(ring_t *r)
+{
+    if (r)
+	munmap(r, sizeof(ring_t));
+}
+
+/*
+ * Append a record, returning false without touching the ring
+ * if there isn't room for the whole of it.
+ */
+bool
+ring_t::put(const char *p, unsigned int len)
+{
+    uint32_t head = head_;
+    if (len > SIZE - (head - tail_))
+	return false;
+
+    unsigned int off = head & (SIZE-1);
+    unsigned int n = min(len, (unsigned int)SIZE - off);
+    memcpy(data_ + off, p, n);
+    memcpy(data_, p + n, len - n);
+
+    __sync_synchronize();	/* data before head */
+    head_ = head + len;
+    return true;
+}
+
+/*
+ * Called by the child after put(); returns true if the parent may be
+ * asleep and needs to be woken to see the new record.
+ */
+bool
+ring_t::take_doorbell()
+{
+    __sync_synchronize();	/* head before waiting */
+    if (!waiting_)
+	return false;
+    waiting_ = 0;
+    return true;
+}
+
+/*
+ * Called by the parent just before sleeping; returns true if there
+ * is already something in the ring, i.e. it shouldn't sleep.
+ */
+bool
+ring_t::arm()
+{
+    waiting_ = 1;
+    __sync_synchronize();	/* waiting before head */
+    return head_ != tail_;
+}
+
+/*
+ * Append everything in the ring to @a buf, returning false if
+ * the ring was empty.
+ */
+bool
+ring_t::get(vector<char> &buf)
+{
+    uint32_t head = head_;
+    uint32_t tail = tail_;
+    if (head == tail)
+	return false;
+    __sync_synchronize();	/* head before data */
+
+    unsigned int len = head - tail;
+    unsigned int off = tail & (SIZE-1);
+    unsigned int n = min(len, (unsigned int)SIZE - off);
+    buf.insert(buf.end(), data_ + off, data_ + off + n);
+    buf.insert(buf.end(), data_, data_ + len - n);
+
+    __sync_synchronize();	/* data before tail */
+    tail_ = head;
+    return true;
+}
+
+// close the namespace
+};
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_RING_H__
+#define __NP_RING_H__ 1
+
+#include "np/util/common.hxx"
+#include <vector>
+
+namespace np {
+
+/*
+ * A single-producer single-consumer ring of bytes in memory shared
+ * between a child process (the producer) and the runner in the
+ * parent process (the consumer), created before the child is forked.
+ * Records are only ever published whole.
+ *
+ * The ring has no way to wake the parent by itself; instead the
+ * parent sets a flag just before it sleeps in poll(), and a child
+ * which sees the flag after publishing a record clears it and writes
+ * a doorbell to its event pipe.  Both sides do a full memory barrier
+ * between their store and their load, so either the parent sees the
+ * new record before sleeping or the child sees the flag and rings.
+ */
+class ring_t
+{
+public:
+    static ring_t *create();
+    static void destroy(ring_t *);
+
+    /* child side */
+    bool put(const char *p, unsigned int len);
+    bool take_doorbell();
+
+    /* parent side */
+    bool arm();
+    bool get(std::vector<char> &buf);
+
+    enum { SIZE = 64*1024 };	/* must be a power of 2 */
+
+private:
+    /* keep the producer and consumer ends on different cachelines */
+    volatile uint32_t head_;	/* written by the child */
+    char pad1_[64 - sizeof(uint32_t)];
+    volatile uint32_t tail_;	/* written by the parent */
+    volatile uint32_t waiting_;	/* parent is about to sleep */
+    char pad2_[64 - 2*sizeof(uint32_t)];
+    char data_[SIZE];
+};
+
+// close the namespace
+};
+
+#endif /* __NP_RING_H__ */
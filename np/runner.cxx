@@ -18,12 +18,21 @@
 #include "np/job.hxx"
 #include "np/plan.hxx"
 #include "np/text_listener.hxx"
+#include "np/grouped_listener.hxx"
 #include "np/proxy_listener.hxx"
 #include "np/junit_listener.hxx"
+#include "np/json_listener.hxx"
+#include "np/resultlog_listener.hxx"
+#include "np/trace_listener.hxx"
+#include "np/metrics.hxx"
 #include "np/child.hxx"
+#include "np/history.hxx"
+#include "np/journal.hxx"
+#include "np/ring.hxx"
 #include "np/spiegel/spiegel.hxx"
 #include "np_priv.h"
 #include "except.h"
+#include <sys/resource.h>
 #include <valgrind/memcheck.h>
 
 __np_exceptstate_t __np_exceptstate;
@@ -41,6 +50,10 @@ using namespace np::util;
 
 runner_t *runner_t::running_;
 
+/* how many jobs ahead of the oldest we consider when packing
+ * jobs into the memory budget */
+#define ADMISSION_WINDOW    64
+
 static int
 choose_timeout()
 {
@@ -59,11 +72,21 @@ runner_t::runner_t()
 {
     maxchildren_ = 1;
     timeout_ = choose_timeout();
+    output_keep_ = 64 * 1024;
+
+    const char *env = getenv("NOVAPROVA_HISTORY");
+    if (env && *env)
+	set_history_file(env);
 }
 
 runner_t::~runner_t()
 {
     destroy_listeners();
+    delete result_log_;
+    delete trace_;
+    delete metrics_;
+    delete history_;
+    delete journal_;
 }
 
 void
@@ -79,6 +102,72 @@ runner_t::set_concurrency(int n)
     maxchildren_ = n;
 }
 
+void
+runner_t::set_history_file(const char *filename)
+{
+    delete history_;
+    history_ = 0;
+    if (!filename)
+	return;
+    history_ = new history_t(filename);
+    history_->load();
+}
+
+void
+runner_t::set_adaptive_timeouts(float multiple, int floor, int ceiling)
+{
+    if (floor < 1)
+	floor = 1;
+    if (ceiling < floor)
+	ceiling = floor;
+    adaptive_multiple_ = (multiple > 0.0 ? multiple : 0.0);
+    adaptive_floor_ = floor;
+    adaptive_ceiling_ = ceiling;
+}
+
+void
+runner_t::set_memory_budget(int mb)
+{
+    memory_budget_ = (mb > 0 ? (long)mb * 1024 : 0);
+}
+
+void
+runner_t::set_output_limits(int keep_kb, int limit_kb)
+{
+    if (keep_kb >= 0)
+	output_keep_ = (unsigned int)keep_kb * 1024;
+    output_limit_ = (limit_kb > 0 ? (uint64_t)limit_kb * 1024 : 0);
+}
+
+void
+runner_t::set_result_log(const char *filename)
+{
+    delete result_log_;
+    result_log_ = (filename ? new result_log_listener_t(filename) : 0);
+}
+
+void
+runner_t::set_trace_file(const char *filename)
+{
+    delete trace_;
+    trace_ = (filename ? new trace_listener_t(filename) : 0);
+}
+
+void
+runner_t::set_metrics_socket(const char *path)
+{
+    delete metrics_;
+    metrics_ = (path ? new metrics_t(path) : 0);
+}
+
+void
+runner_t::set_journal_file(const char *filename, bool resume)
+{
+    delete journal_;
+    journal_ = new journal_t(filename);
+    resume_ = resume;
+}
+
 void
 runner_t::list_tests(plan_t *plan) const
 {
@@ -112,6 +201,7 @@ runner_t::list_tests(plan_t *plan) const
 int
 runner_t::run_tests(plan_t *plan)
 {
+    PROFILE;
     bool ourplan = false;
     if (!plan)
     {
@@ -123,16 +213,59 @@ runner_t::run_tests(plan_t *plan)
 
     if (!listeners_.size())
 	add_listener(new text_listener_t);
+    /* not counted above, these don't replace the default output */
+    if (result_log_)
+    {
+	add_listener(result_log_);
+	result_log_ = 0;
+    }
+    if (trace_)
+    {
+	add_listener(trace_);
+	trace_ = 0;
+    }
+
+    if (journal_ && !journal_->open(resume_))
+    {
+	fprintf(stderr, "np: cannot open journal, continuing without it\n");
+	delete journal_;
+	journal_ = 0;
+    }
 
+    if (metrics_ && !metrics_->listen())
+    {
+	fprintf(stderr, "np: cannot serve metrics, continuing without them\n");
+	delete metrics_;
+	metrics_ = 0;
+    }
+    if (metrics_)
+	metrics_->begin(plan, maxchildren_);
+
+    dispatch_listeners(set_plan, plan);
     begin();
     plan_t::iterator pitr = plan->begin();
     plan_t::iterator pend = plan->end();
+    deque<job_t*> pending;
+    job_t *j;
+    nbypassed_ = 0;
+    largest_estimate_ = (history_ ? history_->get_largest_peak_rss() : 0);
     for (;;)
     {
-	while (children_.size() < maxchildren_ && pitr != pend)
+	for (;;)
 	{
-	    begin_job(new job_t(pitr));
-	    ++pitr;
+	    /* top up the window of jobs we can choose from */
+	    while (pending.size() < ADMISSION_WINDOW && pitr != pend)
+	    {
+		j = new job_t(pitr);
+		++pitr;
+		if (resume_job(j))
+		    continue;
+		estimate_memory(j);
+		pending.push_back(j);
+	    }
+	    if (children_.size() >= maxchildren_ || !(j = admit_job(pending)))
+		break;
+	    begin_job(j);
 	}
 	if (!children_.size())
 	    break;
@@ -173,9 +306,12 @@ runner_t::set_listener(listener_t *l)
 }
 
 static volatile int caught_sigchld = 0;
+static volatile int64_t sigchld_time = 0;	/* for reap delay metrics */
 static void
 handle_sigchld(int sig __attribute__((unused)))
 {
+    if (!caught_sigchld)
+	sigchld_time = rel_now();
     caught_sigchld = 1;
 }
 
@@ -198,6 +334,10 @@ void
 runner_t::end()
 {
     dispatch_listeners(end);
+    if (metrics_)
+	metrics_->stop();
+    if (history_)
+	history_->compact();
     running_ = 0;
 }
 
@@ -206,24 +346,27 @@ result_t
 runner_t::raise_event(job_t *j, const event_t *ev)
 {
     ev = ev->normalise();
+    if (journal_)
+	journal_->add_event(j, ev);
     dispatch_listeners(add_event, j, ev);
     return ev->get_result();
 }
 
-static const char tmpfile_template[] = "/tmp/novaprova.out.XXXXXX";
-#define TMPFILE_MAX (sizeof(tmpfile_template))
-
 child_t *
 runner_t::fork_child(job_t *j)
 {
+    PROFILE;
     pid_t pid;
 #define PIPE_READ 0
 #define PIPE_WRITE 1
     int pipefd[2];
+    int outpipe[2] = { -1, -1 };
+    int errpipe[2] = { -1, -1 };
     int outfd = -1;
     int errfd = -1;
-    char outpath[TMPFILE_MAX];
-    char errpath[TMPFILE_MAX];
+    char outpath[PATH_MAX];
+    char errpath[PATH_MAX];
+    ring_t *ring;
     child_t *child;
     int delay_ms = 10;
     int max_sleeps = 20;
@@ -235,10 +378,28 @@ runner_t::fork_child(job_t *j)
 	perror("np: pipe");
 	exit(1);
     }
+    /* if we can't get a ring, the pipe will do */
+    ring = ring_t::create();
 
-    if (needs_stdout_)
+    if (needs_stdout_ && !journal_)
     {
-	strcpy(outpath, tmpfile_template);
+	/* capture output through pipes which we drain as the test
+	 * runs, see child_t::handle_poll() */
+	if (pipe(outpipe) < 0 || pipe(errpipe) < 0)
+	{
+	    perror("np: pipe");
+	    exit(1);
+	}
+	outfd = outpipe[PIPE_WRITE];
+	errfd = errpipe[PIPE_WRITE];
+    }
+    else if (needs_stdout_)
+    {
+	/* when journalling, keep the output in files where a
+	 * resumed run can find it */
+	string tmpl = journal_->get_output_directory() + "/out.XXXXXX";
+
+	snprintf(outpath, sizeof(outpath), "%s", tmpl.c_str());
 	outfd = mkstemp(outpath);
 	if (outfd < 0)
 	{
@@ -246,7 +407,7 @@ runner_t::fork_child(job_t *j)
 	    exit(1);
 	}
 
-	strcpy(errpath, tmpfile_template);
+	snprintf(errpath, sizeof(errpath), "%s", tmpl.c_str());
 	errfd = mkstemp(errpath);
 	if (errfd < 0)
 	{
@@ -278,8 +439,16 @@ runner_t::fork_child(job_t *j)
     if (!pid)
     {
 	/* child process: return, will run the test */
+	/* the daemon ignores SIGPIPE, tests get the default */
+	signal(SIGPIPE, SIG_DFL);
 	close(pipefd[PIPE_READ]);
 	event_pipe_ = pipefd[PIPE_WRITE];
+	event_ring_ = ring;
+	if (outpipe[PIPE_READ] >= 0)
+	{
+	    close(outpipe[PIPE_READ]);
+	    close(errpipe[PIPE_READ]);
+	}
 	if (needs_stdout_)
 	{
 	    dup2(outfd, STDOUT_FILENO);
@@ -295,15 +464,26 @@ runner_t::fork_child(job_t *j)
 //     fprintf(stderr, "np: spawned child process %d for %s\n",
 // 	    (int)pid, j->as_string().c_str());
     close(pipefd[PIPE_WRITE]);
-    child = new child_t(pid, pipefd[PIPE_READ], j);
-    if (timeout_)
-	child->set_deadline(j->get_start() + timeout_ * NANOSEC_PER_SEC);
+    child = new child_t(pid, pipefd[PIPE_READ], ring, j);
+    j->get_stdout_capture()->set_keep(output_keep_);
+    j->get_stderr_capture()->set_keep(output_keep_);
+    child->set_output_limit(output_limit_);
+    if (j->get_timeout())
+	child->set_deadline(j->get_start() + j->get_timeout() * NANOSEC_PER_SEC);
     if (needs_stdout_)
     {
 	close(outfd);
 	close(errfd);
+    }
+    if (outpipe[PIPE_READ] >= 0)
+    {
+	child->set_output_fds(outpipe[PIPE_READ], errpipe[PIPE_READ]);
+    }
+    else if (needs_stdout_)
+    {
 	j->set_stdout_path(outpath);
 	j->set_stderr_path(errpath);
+	j->set_keep_output(true);
     }
     children_.push_back(child);
 
@@ -325,19 +505,16 @@ runner_t::handle_events()
     {
 	int64_t start = rel_now();
 	int64_t timeout = -1;
+	bool ready = false;
 	pfd_.clear();
 	vector<child_t*>::iterator citr;
 	for (citr = children_.begin() ; citr != children_.end() ; ++citr)
 	{
-	    struct pollfd p;
-	    memset(&p, 0, sizeof(struct pollfd));
-	    int fd = (*citr)->get_input_fd();
-	    if (fd >= 0)
-	    {
-		p.fd = fd;
-		p.events |= POLLIN;
-	    }
-	    pfd_.push_back(p);
+	    struct pollfd p[child_t::NPOLLFDS];
+	    (*citr)->get_pollfds(p);
+	    pfd_.insert(pfd_.end(), p, p + child_t::NPOLLFDS);
+	    if ((*citr)->arm_ring())
+		ready = true;
 
 	    int64_t deadline = (*citr)->get_deadline();
 	    if (deadline)
@@ -350,6 +527,11 @@ runner_t::handle_events()
 	    }
 	}
 
+	/* metrics clients never affect the timeout */
+	unsigned int nchildfds = pfd_.size();
+	if (metrics_)
+	    metrics_->get_pollfds(pfd_);
+
 	if (timeout == 0)
 	{
 	    if (++nzeroes > 5)
@@ -360,6 +542,8 @@ runner_t::handle_events()
 	    nzeroes = 0;
 	}
 
+	if (ready)
+	    timeout = 0;	/* calls are waiting in a ring */
 	r = poll(pfd_.data(), pfd_.size(),
 		 (timeout < 0 ? -1 : (timeout+500000)/1000000));
 	if (r < 0)
@@ -381,23 +565,30 @@ runner_t::handle_events()
 	    /* poll indicated some fds are available */
 	    vector<struct pollfd>::iterator pitr;
 	    for (pitr = pfd_.begin(), citr = children_.begin() ;
-		 citr != children_.end() ; ++pitr, ++citr)
-		if ((pitr->revents & POLLIN))
-		    (*citr)->handle_input();
+		 citr != children_.end() ;
+		 pitr += child_t::NPOLLFDS, ++citr)
+		(*citr)->handle_poll(&*pitr);
+	    if (metrics_ && pfd_.size() > nchildfds)
+		metrics_->handle_poll(&pfd_[nchildfds]);
 	}
+	for (citr = children_.begin() ; citr != children_.end() ; ++citr)
+	    (*citr)->handle_ring();
     }
 }
 
 void
 runner_t::reap_children()
 {
+    PROFILE;
     pid_t pid;
     int status;
+    struct rusage ru;
     char msg[1024];
+    int64_t reap_delay = (caught_sigchld ? rel_now() - sigchld_time : -1);
 
     for (;;)
     {
-	pid = waitpid(-1, &status, WNOHANG);
+	pid = wait4(-1, &status, WNOHANG, &ru);
 	if (pid == 0)
 	    break;
 	if (pid < 0)
@@ -426,6 +617,8 @@ runner_t::reap_children()
 	    continue;	    /* whatever */
 	}
 	child_t *child = *itr;
+	child->get_job()->set_peak_rss(ru.ru_maxrss);
+	child->drain();
 
 	if (WIFEXITED(status))
 	{
@@ -454,6 +647,17 @@ runner_t::reap_children()
 	nfailed_ += (child->get_result() == R_FAIL);
 	nrun_++;
 	child->get_job()->post_run(true);
+	if (history_)
+	    history_->add_sample(child->get_job()->as_string(),
+				 child->get_job()->get_elapsed(),
+				 child->get_job()->get_peak_rss(),
+				 child->get_result());
+	if (journal_)
+	    journal_->end_job(child->get_job(), child->get_result());
+	if (metrics_)
+	    metrics_->end_job(child->get_result(),
+			      child->get_job()->get_elapsed(),
+			      reap_delay);
 	dispatch_listeners(end_job, child->get_job(), child->get_result());
 
 	/* detach and clean up */
@@ -573,10 +777,12 @@ runner_t::run_test_code(job_t *j)
     result_t res = R_UNKNOWN;
     event_t *ev;
 
+    j->begin_phase(job_t::PH_SETUP);
     j->pre_run(false);
 
     vector<string> prefds = np::spiegel::platform::get_file_descriptors();
 
+    j->begin_phase(job_t::PH_BEFORE);
     np_try
     {
 	run_fixtures(tn, FT_BEFORE);
@@ -589,6 +795,7 @@ runner_t::run_test_code(job_t *j)
 
     if (res == R_UNKNOWN)
     {
+	j->begin_phase(job_t::PH_TEST);
 	np_try
 	{
 	    run_function(FT_TEST, tn->get_function(FT_TEST));
@@ -599,6 +806,7 @@ runner_t::run_test_code(job_t *j)
 	    res = merge(res, raise_event(j, ev));
 	}
 
+	j->begin_phase(job_t::PH_AFTER);
 	np_try
 	{
 	    run_fixtures(tn, FT_AFTER);
@@ -616,15 +824,270 @@ runner_t::run_test_code(job_t *j)
 
     j->post_run(false);
 
+    j->begin_phase(job_t::PH_CHECK);
     res = descriptor_leaks(j, prefds, res);
     prefds.clear();
 
     res = valgrind_errors(j, res);
+    j->begin_phase(job_t::PH_DONE);
 
     return res;
 }
 
 
+/*
+ * In the child, catch signals which indicate the test code has crashed
+ * and send the parent an event describing where, before letting the
+ * signal kill us as usual.  This gives most of the useful information
+ * from a core dump without having to enable core dumps.
+ *
+ * The crash might have happened inside malloc() or stdio, so the
+ * handler only makes async-signal-safe calls, formatting into static
+ * buffers.  The stack trace is sent as bare addresses, which the
+ * parent describes when the event arrives (see event_t::normalise()).
+ */
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+#define NUM_CRASH_SIGNALS   (sizeof(crash_signals)/sizeof(crash_signals[0]))
+#define CRASH_STACK_SIZE    (256*1024)
+#define CRASH_MAX_FRAMES    64
+/* strsignal() isn't safe in the handler, so we ask it beforehand */
+static char crash_signal_names[NUM_CRASH_SIGNALS][64];
+
+static void
+handle_crash(int sig, siginfo_t *si, void *vuc)
+{
+    static volatile sig_atomic_t handling;
+    static char desc[1024];
+    static char trace[CRASH_MAX_FRAMES * (2*sizeof(np::spiegel::addr_t)+4)];
+    np::spiegel::addr_t stack[CRASH_MAX_FRAMES];
+
+    /* crashing again in here, perhaps with another signal,
+     * just kills us */
+    if (handling)
+	_exit(128+sig);
+    handling = 1;
+    signal(sig, SIG_DFL);
+
+    const char *name = "";
+    for (unsigned int i = 0 ; i < NUM_CRASH_SIGNALS ; i++)
+	if (crash_signals[i] == sig)
+	    name = crash_signal_names[i];
+
+    sigbuf_t d(desc, sizeof(desc));
+    d.str("Fatal signal ").dec(sig).str(" (").str(name).str(")");
+    if (si->si_code > 0 && sig != SIGABRT)
+	d.str(" at address ").hex((unsigned long)si->si_addr);
+    else
+	d.str(" sent by process ").dec(si->si_pid);
+    d.str("\n");
+    unsigned int n = d.length();
+    np::spiegel::platform::describe_registers(vuc, desc+n, sizeof(desc)-n);
+
+    sigbuf_t t(trace, sizeof(trace));
+    unsigned int nframes = np::spiegel::platform::get_stacktrace(vuc, stack,
+							       CRASH_MAX_FRAMES);
+    for (unsigned int i = 0 ; i < nframes ; i++)
+	t.hex(stack[i]).str("\n");
+
+    event_t ev(EV_SIGNAL, desc);
+    proxy_listener_t::add_event_from_signal(&ev.with_addresses(trace));
+
+    /* pending until we return, then kills us with the default action */
+    raise(sig);
+}
+
+static void
+install_crash_handler()
+{
+    static char *altstack;
+    stack_t ss;
+    struct sigaction act;
+
+    /* use an alternate stack so we can report stack overflows */
+    if (!altstack)
+	altstack = (char *)xmalloc(CRASH_STACK_SIZE);
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = altstack;
+    ss.ss_size = CRASH_STACK_SIZE;
+    if (sigaltstack(&ss, NULL) < 0)
+	perror("np: sigaltstack");
+
+    for (unsigned int i = 0 ; i < NUM_CRASH_SIGNALS ; i++)
+	snprintf(crash_signal_names[i], sizeof(crash_signal_names[i]),
+		 "%s", strsignal(crash_signals[i]));
+
+    memset(&act, 0, sizeof(act));
+    act.sa_sigaction = handle_crash;
+    act.sa_flags = SA_SIGINFO|SA_ONSTACK;
+    for (unsigned int i = 0 ; i < NUM_CRASH_SIGNALS ; i++)
+    {
+	if (sigaction(crash_signals[i], &act, NULL) < 0)
+	    perror("np: sigaction");
+    }
+}
+
+/*
+ * Decide how long the job may run before we kill it.  In order of
+ * precedence: timeouts are disabled entirely under a debugger; a
+ * timeout declared on the testnode with NP_TIMEOUT; an adaptive
+ * timeout which is a multiple of the job's p99 duration on previous
+ * runs, clamped to a floor and ceiling; or finally the default.
+ */
+void
+runner_t::choose_job_timeout(job_t *j)
+{
+    int scale = (RUNNING_ON_VALGRIND ? 3 : 1);
+    char reason[256];
+
+    if (!timeout_)
+    {
+	j->set_timeout(0, "disabled");
+	return;
+    }
+
+    int declared = j->get_node()->get_timeout();
+    if (declared)
+    {
+	j->set_timeout(declared * scale, "declared");
+	return;
+    }
+
+    int64_t p99;
+    unsigned int nsamples;
+    if (adaptive_multiple_ > 0.0 && history_ &&
+	(nsamples = history_->get_p99(j->as_string(), &p99)))
+    {
+	int64_t ns = (int64_t)(adaptive_multiple_ * p99);
+	int secs = (ns + NANOSEC_PER_SEC - 1) / NANOSEC_PER_SEC;
+	const char *clamp = "";
+	if (secs < adaptive_floor_ * scale)
+	{
+	    secs = adaptive_floor_ * scale;
+	    clamp = ", floor";
+	}
+	else if (secs > adaptive_ceiling_ * scale)
+	{
+	    secs = adaptive_ceiling_ * scale;
+	    clamp = ", ceiling";
+	}
+	snprintf(reason, sizeof(reason),
+		 "adaptive, %g x p99 %lld ms over %u runs%s",
+		 adaptive_multiple_, (long long)(p99 / 1000000),
+		 nsamples, clamp);
+	j->set_timeout(secs, reason);
+	return;
+    }
+
+    j->set_timeout(timeout_, "default");
+}
+
+/*
+ * Estimate the peak memory use of the job, from a declaration on
+ * the testnode with NP_MEMORY or failing that from the recorded
+ * history.  A job with neither could use anything, so it's assumed
+ * to be as big as the biggest job we know about, and at least
+ * MEMORY_ESTIMATE_FLOOR; otherwise on a first run with no history
+ * any number of jobs would fit in the budget.
+ */
+#define MEMORY_ESTIMATE_FLOOR	(64*1024)	/* KiB */
+
+void
+runner_t::estimate_memory(job_t *j)
+{
+    long kb = (long)j->get_node()->get_memory() * 1024;
+    if (!kb && history_)
+	history_->get_peak_rss(j->as_string(), &kb);
+    if (kb)
+	largest_estimate_ = max(largest_estimate_, kb);
+    else
+	kb = max(largest_estimate_, (long)MEMORY_ESTIMATE_FLOOR);
+    j->set_memory_estimate(kb);
+}
+
+long
+runner_t::running_memory() const
+{
+    long kb = 0;
+    vector<child_t*>::const_iterator itr;
+    for (itr = children_.begin() ; itr != children_.end() ; ++itr)
+	kb += (*itr)->get_job()->get_memory_estimate();
+    return kb;
+}
+
+/*
+ * Choose the next pending job to start, or return NULL if none can
+ * be started yet.  Without a memory budget this is always the oldest
+ * job.  With a budget, the oldest job is started if its estimate fits
+ * alongside the running jobs, otherwise the gap is filled with the
+ * first younger job which fits.  The oldest job can only be passed
+ * over maxchildren_ times before we stop filling gaps and wait for
+ * enough running jobs to finish, so it can't starve.  When nothing is
+ * running the oldest job is always started, even if it's too big.
+ */
+job_t *
+runner_t::admit_job(deque<job_t*> &pending)
+{
+    if (!pending.size())
+	return 0;
+
+    deque<job_t*>::iterator itr = pending.begin();
+    if (memory_budget_ && children_.size())
+    {
+	long avail = memory_budget_ - running_memory();
+	if ((*itr)->get_memory_estimate() > avail)
+	{
+	    if (nbypassed_ >= maxchildren_)
+		return 0;
+	    for (++itr ; itr != pending.end() ; ++itr)
+	    {
+		if ((*itr)->get_memory_estimate() <= avail)
+		    break;
+	    }
+	    if (itr == pending.end())
+		return 0;
+	    nbypassed_++;
+	}
+    }
+
+    if (itr == pending.begin())
+	nbypassed_ = 0;
+    job_t *j = *itr;
+    pending.erase(itr);
+    return j;
+}
+
+/*
+ * If the job completed in an earlier run which we're resuming, replay
+ * its journalled result to the listeners instead of running it again.
+ */
+bool
+runner_t::resume_job(job_t *j)
+{
+    const journal_t::record_t *rec = (journal_ ? journal_->find(j->as_string()) : 0);
+    if (!rec)
+	return false;
+
+    j->set_elapsed(rec->elapsed_);
+    j->set_stdout_path(rec->stdout_path_.c_str());
+    j->set_stderr_path(rec->stderr_path_.c_str());
+    j->set_keep_output(true);
+
+    dispatch_listeners(begin_job, j);
+    vector<event_t*>::const_iterator itr;
+    for (itr = rec->events_.begin() ; itr != rec->events_.end() ; ++itr)
+	dispatch_listeners(add_event, j, *itr);
+    nfailed_ += (rec->result_ == R_FAIL);
+    nrun_++;
+    if (metrics_)
+    {
+	metrics_->begin_job();
+	metrics_->end_job(rec->result_, rec->elapsed_, -1);
+    }
+    dispatch_listeners(end_job, j, rec->result_);
+    delete j;
+    return true;
+}
+
 void
 runner_t::begin_job(job_t *j)
 {
@@ -640,16 +1103,29 @@ runner_t::begin_job(job_t *j)
 //     fprintf(stderr, "%s: begin job %s\n",
 // 	    rel_timestamp(), j->as_string().c_str());
 
+    choose_job_timeout(j);
     dispatch_listeners(begin_job, j);
     j->pre_run(true);
+    if (metrics_)
+	metrics_->begin_job();
 
     child = fork_child(j);
     if (child)
 	return; /* parent process */
 
     /* child process */
-    set_listener(new proxy_listener_t(event_pipe_));
+    delete journal_;	/* only the parent writes to it */
+    journal_ = 0;
+    delete metrics_;	/* closes our copies of its sockets */
+    metrics_ = 0;
+    timeout_ = j->get_timeout();	/* for np_get_timeout() */
+    set_listener(new proxy_listener_t(event_pipe_, event_ring_));
+    install_crash_handler();
     res = run_test_code(j);
+    /* our exit() doesn't flush stdio, and the output needs
+     * to be captured before the runner reaps us */
+    fflush(stdout);
+    fflush(stderr);
     dispatch_listeners(end_job, j, res);
 //     fprintf(stderr, "np: child process %d (%s) finishing\n",
 // 	    (int)getpid(), j->as_string().c_str());
@@ -717,10 +1193,24 @@ np_list_tests(np_runner_t *runner, np_plan_t *plan)
  *    files in jUnit format, suitable for use with upstream processors
  *    which accept jUnit files, such as the Jenkins CI server.
  *
+ *  - @b "json" one JSON object per line is written to stdout for
+ *    the start and end of the run, the start and end of each test,
+ *    and each event, flushed as it happens.  Each object has a @c type
+ *    and a @c time in seconds since the start of the run; the objects
+ *    for tests carry the test's name, node and parameters, and the end
+ *    of each test carries its result, elapsed time, peak memory use
+ *    and captured output.
+ *
  *  - @b "text" a stream of tests and events is emitted to stdout,
  *    co-mingled with anything emitted to stdout by the test code.
  *    This is the default if @c np_set_output_format is not called.
  *
+ *  - @b "grouped" like "text", but each test's events and output are
+ *    held until the test finishes and then emitted together, so the
+ *    results of tests running in parallel are not interleaved.  When
+ *    stderr is a terminal, a progress line shows how many tests have
+ *    run, failed, and are still running.
+ *
  * Note that the function is a misnomer, it actually @b adds an output
  * format. Also note that if the C++ API were documented, you could
  * write your own output formats by deriving from @c np::listener_t.
@@ -735,11 +1225,21 @@ np_set_output_format(np_runner_t *runner, const char *fmt)
 	runner->add_listener(new junit_listener_t);
 	return true;
     }
+    else if (!strcmp(fmt, "json"))
+    {
+	runner->add_listener(new json_listener_t);
+	return true;
+    }
     else if (!strcmp(fmt, "text"))
     {
 	runner->add_listener(new text_listener_t);
 	return true;
     }
+    else if (!strcmp(fmt, "grouped"))
+    {
+	runner->add_listener(new grouped_listener_t);
+	return true;
+    }
     else
 	return false;
 }
@@ -762,6 +1262,171 @@ np_run_tests(np_runner_t *runner, np_plan_t *plan)
     return runner->run_tests(plan);
 }
 
+/**
+ * Set the file used to record test durations and results.
+ *
+ * @param runner	the runner object
+ * @param filename	name of the history file, or NULL
+ *
+ * The duration, peak memory use, and result of each test are appended
+ * to @a filename as the test finishes, and those recorded by previous
+ * runs of the same test executable are read from it.  Only the most
+ * recent 20 runs of each test are kept; the file is compacted at the
+ * end of a run when it has grown much larger than that.  The recorded
+ * durations of successful runs are used to choose adaptive timeouts,
+ * see @c np_set_adaptive_timeouts.  The history file can also be set
+ * using the @c NOVAPROVA_HISTORY environment variable.
+ */
+extern "C" void
+np_set_history_file(np_runner_t *runner, const char *filename)
+{
+    runner->set_history_file(filename);
+}
+
+/**
+ * Enable adaptive per-test timeouts.
+ *
+ * @param runner	the runner object
+ * @param multiple	multiple of the historical p99 duration,
+ *			or 0 to disable adaptive timeouts
+ * @param floor		minimum timeout in seconds
+ * @param ceiling	maximum timeout in seconds
+ *
+ * Instead of giving every test the same default timeout, choose each
+ * test's timeout to be @a multiple times the 99th percentile of its
+ * durations as recorded in the history file (see @c np_set_history_file),
+ * rounded up to whole seconds and clamped between @a floor and
+ * @a ceiling.  Tests with no recorded history get the default timeout,
+ * and timeouts declared with @c NP_TIMEOUT always take precedence.
+ * The reason for each test's timeout is reported when it times out.
+ */
+extern "C" void
+np_set_adaptive_timeouts(np_runner_t *runner, float multiple,
+			 int floor, int ceiling)
+{
+    runner->set_adaptive_timeouts(multiple, floor, ceiling);
+}
+
+/**
+ * Set a memory budget for running tests in parallel.
+ *
+ * @param runner	the runner object
+ * @param megabytes	the budget, or 0 to disable
+ *
+ * Limits which test jobs are started at the same time so that the sum
+ * of their expected peak memory use fits in @a megabytes.  A test's
+ * expected peak memory use comes from a declaration with @c NP_MEMORY
+ * or from the peak memory use recorded in the history file (see
+ * @c np_set_history_file); tests with neither are assumed to use no
+ * memory.  Smaller tests may be started out of order to fill gaps in
+ * the budget, but a larger test is never held back indefinitely.
+ */
+extern "C" void
+np_set_memory_budget(np_runner_t *runner, int megabytes)
+{
+    runner->set_memory_budget(megabytes);
+}
+
+/**
+ * Set limits on the output captured from each test.
+ *
+ * @param runner	the runner object
+ * @param keep_kb	kilobytes kept from each end of the output, 0
+ *			to keep all of it, or negative to leave it unchanged
+ * @param limit_kb	fail a test which writes more than this many
+ *			kilobytes, or 0 for no limit
+ *
+ * When output is captured for a report (e.g. the JUnit format), only
+ * the first and last @a keep_kb kilobytes of each of a test's stdout
+ * and stderr are kept, separated by a count of the bytes omitted, and
+ * a @c TRUNCATED event is reported.  The default is 64 KB.  A test
+ * which writes more than @a limit_kb kilobytes in total to stdout and
+ * stderr fails with an @c OUTLIMIT event, but keeps running.
+ */
+extern "C" void
+np_set_output_limits(np_runner_t *runner, int keep_kb, int limit_kb)
+{
+    runner->set_output_limits(keep_kb, limit_kb);
+}
+
+/**
+ * Set a journal file for checkpointing and resuming test runs.
+ *
+ * @param runner	the runner object
+ * @param filename	the journal file
+ * @param resume	if non-zero, resume from the journal
+ *
+ * As each test finishes its result, events, and elapsed time are
+ * appended to the journal @a filename, together with the location of
+ * its captured output (which is kept in a directory named after
+ * @a filename with a @c .d suffix).  If the run is interrupted, running
+ * again with @a resume non-zero skips the tests which already completed
+ * and reports their journalled results to the output formats as if
+ * they had just run.  Without @a resume any existing journal is
+ * discarded.  A journal written by a different build of the test
+ * executable is not resumed from.
+ */
+extern "C" void
+np_set_journal_file(np_runner_t *runner, const char *filename, int resume)
+{
+    runner->set_journal_file(filename, !!resume);
+}
+
+/**
+ * Set a binary log file to which every run's results are appended.
+ *
+ * @param runner	the runner object
+ * @param filename	the result log, or NULL to disable
+ *
+ * Each test's name, result, first failure, start time, elapsed time,
+ * and peak memory use are appended to @a filename in a compact binary
+ * format which keeps the results of every run, in addition to any
+ * other output formats.  The @c npresults tool reports the slowest
+ * tests, failure rates, and changes in duration between runs.
+ */
+extern "C" void
+np_set_result_log(np_runner_t *runner, const char *filename)
+{
+    runner->set_result_log(filename);
+}
+
+/**
+ * Write a timeline of the run to a file for viewing in a trace viewer.
+ *
+ * @param runner	the runner object
+ * @param filename	the trace file, or NULL to disable
+ *
+ * Each test is written to @a filename as a span in the Chrome trace
+ * event format, on the track of the concurrency slot which ran it,
+ * with nested spans for the phases of running it.  Load the file into
+ * chrome://tracing or https://ui.perfetto.dev to see how well the
+ * tests kept the machine busy.  This is in addition to any other
+ * output formats.
+ */
+extern "C" void
+np_set_trace_file(np_runner_t *runner, const char *filename)
+{
+    runner->set_trace_file(filename);
+}
+
+/**
+ * Serve live metrics about the run on a Unix domain socket.
+ *
+ * @param runner	the runner object
+ * @param path		filename of the socket, or NULL to disable
+ *
+ * While tests are running, counts of queued, running and finished
+ * tests, results, throughput, and histograms of test duration are
+ * available from @a path in the Prometheus text format, e.g. with
+ * @c "curl --unix-socket PATH http://localhost/metrics".  The socket
+ * is removed when the run finishes.
+ */
+extern "C" void
+np_set_metrics_socket(np_runner_t *runner, const char *path)
+{
+    runner->set_metrics_socket(path);
+}
+
 extern "C" int
 np_get_timeout()
 {
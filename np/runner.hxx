@@ -19,6 +19,7 @@
 #include "np/util/common.hxx"
 #include "np/types.hxx"
 #include <vector>
+#include <deque>
 
 namespace np { namespace spiegel { class function_t; }; };
 
@@ -30,6 +31,10 @@ class plan_t;
 class child_t;
 class testnode_t;
 class job_t;
+class history_t;
+class journal_t;
+class ring_t;
+class metrics_t;
 
 class runner_t : public np::util::zalloc
 {
@@ -38,12 +43,22 @@ public:
     ~runner_t();
 
     void set_concurrency(int n);
+    void set_history_file(const char *filename);
+    void set_adaptive_timeouts(float multiple, int floor, int ceiling);
+    void set_memory_budget(int mb);
+    void set_output_limits(int keep_kb, int limit_kb);
+    void set_journal_file(const char *filename, bool resume);
+    void set_result_log(const char *filename);
+    void set_metrics_socket(const char *path);
+    void set_trace_file(const char *filename);
     void add_listener(listener_t *);
     void list_tests(plan_t *) const;
     int run_tests(plan_t *);
     static runner_t *running() { return running_; }
     result_t raise_event(job_t *, const event_t *);
     int get_timeout() const { return timeout_; }
+    /* may be NULL if no history file was set */
+    const history_t *get_history() const { return history_; }
 
 private:
     void destroy_listeners();
@@ -58,6 +73,11 @@ private:
     result_t valgrind_errors(job_t *, result_t);
     result_t descriptor_leaks(job_t *j, const std::vector<std::string> &prefds, result_t res);
     result_t run_test_code(job_t *);
+    void choose_job_timeout(job_t *);
+    void estimate_memory(job_t *);
+    long running_memory() const;
+    job_t *admit_job(std::deque<job_t*> &pending);
+    bool resume_job(job_t *);
     void begin_job(job_t *);
     void wait();
 
@@ -68,11 +88,27 @@ private:
     unsigned int nrun_;
     unsigned int nfailed_;
     int event_pipe_;		/* only in child processes */
+    ring_t *event_ring_;	/* only in child processes */
     std::vector<child_t*> children_;	// only in the parent process
     unsigned int maxchildren_;
     std::vector<struct pollfd> pfd_;
     int timeout_;	/* in seconds, 0 to disable */
+    history_t *history_;
+    /* adaptive timeouts: a multiple of the job's historical p99 */
+    float adaptive_multiple_;	/* 0 to disable */
+    int adaptive_floor_;	/* in seconds */
+    int adaptive_ceiling_;	/* in seconds */
+    long memory_budget_;	/* in KiB, 0 to disable */
+    long largest_estimate_;	/* in KiB, of the jobs we know about */
+    unsigned int nbypassed_;	/* times the oldest pending job was passed over */
+    unsigned int output_keep_;	/* bytes kept at each end of captured output */
+    uint64_t output_limit_;	/* in bytes, 0 to disable */
+    journal_t *journal_;
+    bool resume_;
     bool needs_stdout_;
+    listener_t *result_log_;	/* added to listeners_ by run_tests() */
+    listener_t *trace_;		/* ditto */
+    metrics_t *metrics_;	/* only in the parent process */
 };
 
 #define np_raise(ev) \
@@ -15,28 +15,211 @@
  */
 #include "abbrev.hxx"
 #include "reader.hxx"
+#include "enumerations.hxx"
 
 namespace np { namespace spiegel { namespace dwarf {
 using namespace std;
 
+/* how far past the end of the array a code can be and still grow it */
+#define MAX_CODE_GAP	64
+
 bool
-abbrev_t::read(reader_t &r)
+abbrev_table_t::read(reader_t &r)
+{
+    std::vector<uint32_t> first_spec;
+    std::map<uint32_t, uint32_t> sparse_first_spec;
+    bool ok = true;
+
+    uint32_t code;
+    /* code 0 indicates end of table */
+    while (r.read_uleb128(code) && code)
+    {
+	if (code >= abbrevs_.size() &&
+	    code - abbrevs_.size() < MAX_CODE_GAP)
+	{
+	    abbrevs_.resize(code+1);
+	    first_spec.resize(code+1, 0);
+	}
+	abbrev_t *ap;
+	if (code < abbrevs_.size())
+	{
+	    ap = &abbrevs_[code];
+	    first_spec[code] = specs_.size();
+	}
+	else
+	{
+	    ap = &sparse_abbrevs_[code];
+	    sparse_first_spec[code] = specs_.size();
+	}
+	abbrev_t &a = *ap;
+	a.code = code;
+	a.nspecs = 0;
+	if (!r.read_uleb128(a.tag) ||
+	    !r.read_u8(a.children))
+	{
+	    ok = false;
+	    break;
+	}
+	for (;;)
+	{
+	    abbrev_t::attr_spec_t as;
+	    as.implicit_const = 0;
+	    as.offset = -1;
+	    if (!r.read_uleb128(as.name) ||
+		!r.read_uleb128(as.form))
+	    {
+		ok = false;
+		break;
+	    }
+	    if (!as.name && !as.form)
+		break;	    /* name=0, form=0 indicates end
+			     * of attribute specifications */
+	    /* DWARF5 keeps the value of an implicit_const
+	     * attribute here rather than in the entry */
+	    if (as.form == DW_FORM_implicit_const &&
+		!r.read_sleb128(as.implicit_const))
+	    {
+		ok = false;
+		break;
+	    }
+	    specs_.push_back(as);
+	    a.nspecs++;
+	}
+	if (!ok)
+	    break;
+    }
+
+    /* only now that specs_ has stopped moving */
+    for (uint32_t i = 0 ; i < abbrevs_.size() ; i++)
+    {
+	if (abbrevs_[i].nspecs)
+	    abbrevs_[i].specs = &specs_[first_spec[i]];
+	layout(abbrevs_[i], first_spec[i]);
+    }
+    map<uint32_t, abbrev_t>::iterator j;
+    for (j = sparse_abbrevs_.begin() ; j != sparse_abbrevs_.end() ; ++j)
+    {
+	uint32_t first = sparse_first_spec[j->first];
+	if (j->second.nspecs)
+	    j->second.specs = &specs_[first];
+	layout(j->second, first);
+    }
+    return ok;
+}
+
+const abbrev_t *
+abbrev_table_t::get_sparse_abbrev(uint32_t code) const
+{
+    map<uint32_t, abbrev_t>::const_iterator i = sparse_abbrevs_.find(code);
+    return (i == sparse_abbrevs_.end() ? 0 : &i->second);
+}
+
+int32_t
+abbrev_table_t::get_form_size(uint32_t form)
+{
+    switch (form)
+    {
+    case DW_FORM_flag_present:
+    case DW_FORM_implicit_const:
+	return 0;	    // nothing in the entry
+    case DW_FORM_data1:
+    case DW_FORM_flag:
+    case DW_FORM_ref1:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+	return 1;
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+	return 2;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+	return 3;
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_strp:
+    case DW_FORM_sec_offset:
+    case DW_FORM_line_strp:
+    case DW_FORM_strp_sup:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+	return 4;
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+	return 8;
+    case DW_FORM_data16:
+	return 16;
+    case DW_FORM_addr:
+	return _NP_ADDRSIZE;
+    default:
+	// LEB128s, strings, blocks and indirect forms vary, and
+	// DW_FORM_ref_addr depends on the unit's DWARF version,
+	// which this table may be shared between.
+	return -1;
+    }
+}
+
+void
+abbrev_table_t::layout(abbrev_t &a, uint32_t first)
+{
+    int32_t offset = 0;
+    a.nfixed = 0;
+    for (uint32_t i = 0 ; i < a.nspecs ; i++)
+    {
+	abbrev_t::attr_spec_t &as = specs_[first + i];
+	as.offset = offset;
+	int32_t size = get_form_size(as.form);
+	if (size < 0)
+	    break;
+	offset += size;
+	a.nfixed++;
+    }
+    a.size = (a.nfixed == a.nspecs ? offset : -1);
+}
+
+void
+abbrev_table_t::dump() const
+{
+    printf("Abbrevs {\n");
+
+    vector<abbrev_t>::const_iterator a;
+    for (a = abbrevs_.begin() ; a != abbrevs_.end() ; ++a)
+    {
+	if (a->code)
+	    dump_abbrev(*a);
+    }
+    map<uint32_t, abbrev_t>::const_iterator s;
+    for (s = sparse_abbrevs_.begin() ; s != sparse_abbrevs_.end() ; ++s)
+	dump_abbrev(s->second);
+    printf("}\n");
+}
+
+void
+abbrev_table_t::dump_abbrev(const abbrev_t &a)
 {
-    if (!r.read_uleb128(tag) ||
-	!r.read_u8(children))
-	return false;
-    for (;;)
+    printf("Code %u\n", a.code);
+    printf("    tag 0x%x (%s)\n", a.tag, tagnames.to_name(a.tag));
+    printf("    children %u (%s)\n",
+	    (unsigned)a.children,
+	    childvals.to_name(a.children));
+    printf("    attribute specifications {\n");
+
+    const abbrev_t::attr_spec_t *i;
+    for (i = a.specs_begin() ; i != a.specs_end() ; ++i)
     {
-	attr_spec_t as;
-	if (!r.read_uleb128(as.name) ||
-	    !r.read_uleb128(as.form))
-	    return false;
-	if (!as.name && !as.form)
-	    break;	    /* name=0, form=0 indicates end
-			 * of attribute specifications */
-	attr_specs.push_back(as);
+	printf("        name 0x%x (%s)",
+		i->name, attrnames.to_name(i->name));
+	printf(" form 0x%x (%s)",
+		i->form, formvals.to_name(i->form));
+	if (i->form == DW_FORM_implicit_const)
+	    printf(" value %d", i->implicit_const);
+	printf("\n");
     }
-    return true;
+    printf("    }\n");
 }
 
 // close namespaces
@@ -30,28 +30,80 @@ struct abbrev_t
     {
 	uint32_t name;
 	uint32_t form;
+	int32_t implicit_const;	// for DW_FORM_implicit_const only
+	// from the entry's first attribute, or -1 if it comes
+	// after one whose size differs from entry to entry
+	int32_t offset;
     };
 
     // default c'tor
     abbrev_t()
      :  code(0),
         tag(0),
-        children(0)
+        children(0),
+	specs(0),
+	nspecs(0),
+	nfixed(0),
+	size(-1)
     {}
 
-    // c'tor with code
-    abbrev_t(uint32_t c)
-     :  code(c),
-        tag(0),
-	children(0)
-    {}
-
-    bool read(reader_t &r);
+    const attr_spec_t *specs_begin() const { return specs; }
+    const attr_spec_t *specs_end() const { return specs + nspecs; }
 
     uint32_t code;
     uint32_t tag;
     uint8_t children;
-    std::vector<attr_spec_t> attr_specs;
+    // in the table's array of all its attribute specifications
+    const attr_spec_t *specs;
+    uint32_t nspecs;
+    // how many of the specs, from the first, have fixed sizes;
+    // the offsets of all of those and of the one after are known
+    uint32_t nfixed;
+    // of all the attributes, or -1 if it differs
+    int32_t size;
+};
+
+/*
+ * All the abbreviations at one offset in .debug_abbrev, which are
+ * shared by every compile unit using that offset.  The abbrevs and
+ * their attribute specifications are each kept in one array, which
+ * is a lot cheaper than allocating them all separately.  Each abbrev
+ * also gets a layout of where its attributes are in an entry, so
+ * that an entry can mostly be skipped in one step and an attribute
+ * found without decoding the ones before it.
+ *
+ * Abbrev codes are normally numbered from 1 up, but nothing says
+ * they have to be, so a code far beyond those seen so far is kept
+ * in a map instead of growing the array out to it.
+ */
+class abbrev_table_t
+{
+public:
+    abbrev_table_t() {}
+    ~abbrev_table_t() {}
+
+    bool read(reader_t &r);
+    void dump() const;
+
+    const abbrev_t *get_abbrev(uint32_t code) const
+    {
+	if (code < abbrevs_.size() && abbrevs_[code].code)
+	    return &abbrevs_[code];
+	return get_sparse_abbrev(code);
+    }
+
+    // the size of an attribute in this form, or -1 if it
+    // differs from entry to entry
+    static int32_t get_form_size(uint32_t form);
+
+private:
+    const abbrev_t *get_sparse_abbrev(uint32_t code) const;
+    void layout(abbrev_t &a, uint32_t first);
+    static void dump_abbrev(const abbrev_t &a);
+
+    std::vector<abbrev_t> abbrevs_;	// indexed by code
+    std::map<uint32_t, abbrev_t> sparse_abbrevs_;
+    std::vector<abbrev_t::attr_spec_t> specs_;
 };
 
 // close namespaces
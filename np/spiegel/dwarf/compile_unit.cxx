@@ -17,6 +17,7 @@
 #include "state.hxx"
 #include "compile_unit.hxx"
 #include "walker.hxx"
+#include "entry.hxx"
 #include "enumerations.hxx"
 
 namespace np { namespace spiegel { namespace dwarf {
@@ -27,25 +28,50 @@ bool
 compile_unit_t::read_header(reader_t &r)
 {
     reader_ = r;	    // sample offset of start of header
+    offset_ = r.get_offset();
 
     uint32_t length;
-    uint16_t version;
     if (!r.read_u32(length))
 	return false;
     if (length > r.get_remains())
 	fatal("Bad DWARF compilation unit length %u", length);
 
-    if (!r.read_u16(version))
+    if (!r.read_u16(version_))
 	return false;
-    if (version != 2)
-	fatal("Bad DWARF version %u, expecting 2", version);
-    if (length < header_length-6/*read so far*/)
-	fatal("Bad DWARF compilation unit length %u", length);
+    if (version_ < 2 || version_ > 5)
+	fatal("Bad DWARF version %u, expecting 2 to 5", version_);
 
     uint8_t addrsize;
-    if (!r.read_u32(abbrevs_offset_) ||
-	!r.read_u8(addrsize))
-	return false;
+    uint8_t unit_type = DW_UT_compile;
+    if (version_ >= 5)
+    {
+	/* DWARF5 added the unit type and swapped the order */
+	if (!r.read_u8(unit_type) ||
+	    !r.read_u8(addrsize) ||
+	    !r.read_u32(abbrevs_offset_))
+	    return false;
+	header_length_ = 12;
+	switch (unit_type)
+	{
+	case DW_UT_skeleton:
+	case DW_UT_split_compile:
+	    header_length_ += 8;	// dwo_id
+	    break;
+	case DW_UT_type:
+	case DW_UT_split_type:
+	    header_length_ += 12;	// type_signature, type_offset
+	    break;
+	}
+    }
+    else
+    {
+	if (!r.read_u32(abbrevs_offset_) ||
+	    !r.read_u8(addrsize))
+	    return false;
+	header_length_ = 11;
+    }
+    if (length < header_length_-4/*the length field*/)
+	fatal("Bad DWARF compilation unit length %u", length);
     if (addrsize != _NP_ADDRSIZE)
 	fatal("Bad DWARF addrsize %u, expecting %u",
 	      addrsize, _NP_ADDRSIZE);
@@ -53,7 +79,8 @@ compile_unit_t::read_header(reader_t &r)
 #if 0
     printf("compilation unit\n");
     printf("    length %u\n", (unsigned)length);
-    printf("    version %u\n", (unsigned)version);
+    printf("    version %u\n", (unsigned)version_);
+    printf("    unit_type %u\n", (unsigned)unit_type);
     printf("    abbrevs %u\n", (unsigned)abbrevs_offset_);
     printf("    addrsize %u\n", (unsigned)addrsize);
 #endif
@@ -65,61 +92,74 @@ compile_unit_t::read_header(reader_t &r)
     reader_ = reader_.initial_subset(length);
 
     // skip the outer reader over the body
-    r.skip(length - header_length);
+    r.seek(offset_ + length);
 
     return true;
 }
 
-void
-compile_unit_t::read_abbrevs(reader_t &r)
+/*
+ * The DWARF5 strx, addrx and rnglistx forms are indexes into tables
+ * whose locations are given by attributes of the unit's own entry,
+ * and those attributes may come after ones which use the forms.  So
+ * we pick out the bases first, then read the entry properly.
+ */
+bool
+compile_unit_t::read_compile_unit_entry()
 {
-    r.seek(abbrevs_offset_);
+    reader_t r = get_contents();
+    uint32_t acode;
+    if (!r.read_uleb128(acode))
+	return false;
+    const abbrev_t *a = get_abbrev(acode);
+    if (!a)
+	return false;
 
-    uint32_t code;
-    /* code 0 indicates end of compile unit */
-    while (r.read_uleb128(code) && code)
+    const abbrev_t::attr_spec_t *i;
+    for (i = a->specs_begin() ; i != a->specs_end() ; ++i)
     {
-	abbrev_t *a = new abbrev_t(code);
-	if (!a->read(r))
+	uint32_t *base = 0;
+	switch (i->name)
 	{
-	    delete a;
-	    break;
+	case DW_AT_str_offsets_base: base = &str_offsets_base_; break;
+	case DW_AT_addr_base: base = &addr_base_; break;
+	case DW_AT_rnglists_base: base = &rnglists_base_; break;
 	}
-	if (a->code >= abbrevs_.size())
-	    abbrevs_.resize(a->code+1, 0);
-	abbrevs_[a->code] = a;
+	if (base && i->form == DW_FORM_sec_offset)
+	{
+	    if (!r.read_u32(*base))
+		return false;
+	}
+	else if (!skip_form(r, i->form))
+	    return false;
     }
-}
 
+    walker_t w(this);
+    const entry_t *e = w.move_next();
+    if (!e)
+	return false;
+    base_address_ = e->get_address_attribute(DW_AT_low_pc);
+    return true;
+}
 
+/*
+ * Abbreviations are read when the unit is first walked, as most
+ * units never are, and shared with any other unit using the same
+ * offset in .debug_abbrev.  Nothing here is locked, so before units
+ * are walked on several threads state_t::prepare_compile_units()
+ * must have read them all.
+ */
 void
-compile_unit_t::dump_abbrevs() const
+compile_unit_t::read_abbrevs()
 {
-    printf("Abbrevs {\n");
+    abbrevs_ = state_t::instance()->get_abbrev_table(loindex_, abbrevs_offset_);
+    read_compile_unit_entry();
+}
 
-    vector<abbrev_t*>::const_iterator itr;
-    for (itr = abbrevs_.begin() ; itr != abbrevs_.end() ; ++itr)
-    {
-	abbrev_t *a = *itr;
-	if (!a) continue;
-	printf("Code %u\n", a->code);
-	printf("    tag 0x%x (%s)\n", a->tag, tagnames.to_name(a->tag));
-	printf("    children %u (%s)\n",
-		(unsigned)a->children,
-		childvals.to_name(a->children));
-	printf("    attribute specifications {\n");
-
-	vector<abbrev_t::attr_spec_t>::iterator i;
-	for (i = a->attr_specs.begin() ; i != a->attr_specs.end() ; ++i)
-	{
-	    printf("        name 0x%x (%s)",
-		    i->name, attrnames.to_name(i->name));
-	    printf(" form 0x%x (%s)\n",
-		    i->form, formvals.to_name(i->form));
-	}
-	printf("    }\n");
-    }
-    printf("}\n");
+void
+compile_unit_t::dump_abbrevs()
+{
+    prepare();
+    abbrevs_->dump();
 }
 
 const char *
@@ -136,5 +176,490 @@ compile_unit_t::get_section(uint32_t i) const
     return &lo->sections_[i];
 }
 
+bool
+compile_unit_t::skip_form(reader_t &r, uint32_t form) const
+{
+    switch (form)
+    {
+    case DW_FORM_flag_present:
+    case DW_FORM_implicit_const:
+	return true;	    // nothing in the entry
+    case DW_FORM_data1:
+    case DW_FORM_flag:
+    case DW_FORM_ref1:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+	return r.skip_u8();
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+	return r.skip_u16();
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+	return r.skip(3);
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_strp:
+    case DW_FORM_sec_offset:
+    case DW_FORM_line_strp:
+    case DW_FORM_strp_sup:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+	return r.skip_u32();
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+	return r.skip_u64();
+    case DW_FORM_data16:
+	return r.skip(16);
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+	return r.skip_uleb128();
+    case DW_FORM_sdata:
+	return r.skip_sleb128();
+    case DW_FORM_addr:
+	return r.skip_addr();
+    case DW_FORM_ref_addr:
+	// DWARF2 made these address sized, later versions offset sized
+	return (version_ == 2 ? r.skip_addr() : r.skip_u32());
+    case DW_FORM_string:
+	return r.skip_string();
+    case DW_FORM_block1:
+	{
+	    uint8_t len;
+	    return r.read_u8(len) && r.skip_bytes(len);
+	}
+    case DW_FORM_block2:
+	{
+	    uint16_t len;
+	    return r.read_u16(len) && r.skip_bytes(len);
+	}
+    case DW_FORM_block4:
+	{
+	    uint32_t len;
+	    return r.read_u32(len) && r.skip_bytes(len);
+	}
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+	{
+	    uint32_t len;
+	    return r.read_uleb128(len) && r.skip_bytes(len);
+	}
+    case DW_FORM_indirect:
+	{
+	    uint32_t f;
+	    return r.read_uleb128(f) && skip_form(r, f);
+	}
+    default:
+	// TODO: bad DWARF info - throw an exception
+	fatal("XXX can't handle %s\n", formvals.to_name(form));
+	return false;
+    }
+}
+
+static bool
+read_index(reader_t &r, uint32_t form, uint32_t &idx)
+{
+    switch (form)
+    {
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+	{
+	    uint8_t v;
+	    if (!r.read_u8(v))
+		return false;
+	    idx = v;
+	    return true;
+	}
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+	{
+	    uint16_t v;
+	    if (!r.read_u16(v))
+		return false;
+	    idx = v;
+	    return true;
+	}
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+	{
+	    uint16_t lo;
+	    uint8_t hi;
+	    if (!r.read_u16(lo) || !r.read_u8(hi))
+		return false;
+	    idx = lo | ((uint32_t)hi << 16);
+	    return true;
+	}
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+	return r.read_u32(idx);
+    default:
+	return r.read_uleb128(idx);
+    }
+}
+
+/*
+ * Decode an attribute in the given form from the unit's entries.
+ * Returns false if it can't, or if we don't support the form.
+ */
+bool
+compile_unit_t::read_form(reader_t &r, const abbrev_t::attr_spec_t &as,
+			  uint32_t form, value_t &val) const
+{
+    switch (form)
+    {
+    case DW_FORM_data1:
+	{
+	    uint8_t v;
+	    if (!r.read_u8(v))
+		return false;
+	    val = value_t::make_uint32(v);
+	    break;
+	}
+    case DW_FORM_data2:
+	{
+	    uint16_t v;
+	    if (!r.read_u16(v))
+		return false;
+	    val = value_t::make_uint32(v);
+	    break;
+	}
+    case DW_FORM_data4:
+	{
+	    uint32_t v;
+	    if (!r.read_u32(v))
+		return false;
+	    val = value_t::make_uint32(v);
+	    break;
+	}
+    case DW_FORM_data8:
+	{
+	    uint64_t v;
+	    if (!r.read_u64(v))
+		return false;
+	    val = value_t::make_uint64(v);
+	    break;
+	}
+    case DW_FORM_udata:
+	{
+	    uint32_t v;
+	    if (!r.read_uleb128(v))
+		return false;
+	    val = value_t::make_uint32(v);
+	    break;
+	}
+    case DW_FORM_sdata:
+	{
+	    int32_t v;
+	    if (!r.read_sleb128(v))
+		return false;
+	    val = value_t::make_sint32(v);
+	    break;
+	}
+    case DW_FORM_addr:
+	{
+	    if (sizeof(unsigned long) == 4)
+	    {
+		uint32_t v;
+		if (!r.read_u32(v))
+		    return false;
+		val = value_t::make_uint32(v);
+	    }
+	    else if (sizeof(unsigned long) == 8)
+	    {
+		uint64_t v;
+		if (!r.read_u64(v))
+		    return false;
+		val = value_t::make_uint64(v);
+	    }
+	    else
+	    {
+		fatal("Strange addrsize %u", (unsigned)sizeof(unsigned long));
+	    }
+	    break;
+	}
+    case DW_FORM_flag:
+	{
+	    uint8_t v;
+	    if (!r.read_u8(v))
+		return false;
+	    val = value_t::make_uint32(v);
+	    break;
+	}
+    case DW_FORM_ref1:
+	{
+	    uint8_t off;
+	    if (!r.read_u8(off))
+		return false;
+	    val = value_t::make_ref(make_reference(off));
+	    break;
+	}
+    case DW_FORM_ref2:
+	{
+	    uint16_t off;
+	    if (!r.read_u16(off))
+		return false;
+	    val = value_t::make_ref(make_reference(off));
+	    break;
+	}
+    case DW_FORM_ref4:
+	{
+	    uint32_t off;
+	    if (!r.read_u32(off))
+		return false;
+	    val = value_t::make_ref(make_reference(off));
+	    break;
+	}
+    case DW_FORM_ref8:
+	{
+	    uint64_t off;
+	    if (!r.read_u64(off))
+		return false;
+	    // TODO: detect truncation
+	    val = value_t::make_ref(make_reference(off));
+	    break;
+	}
+    case DW_FORM_string:
+	{
+	    const char *v;
+	    if (!r.read_string(v))
+		return false;
+	    val = value_t::make_string(v);
+	    break;
+	}
+    case DW_FORM_strp:
+	{
+	    uint32_t off;
+	    if (!r.read_u32(off))
+		return false;
+	    const char *v = get_section(DW_sec_str)->offset_as_string(off);
+	    if (!v)
+		return false;
+	    val = value_t::make_string(v);
+	    break;
+	}
+    case DW_FORM_block1:
+	{
+	    uint8_t len;
+	    const unsigned char *v;
+	    if (!r.read_u8(len) ||
+		!r.read_bytes(v, len))
+		return false;
+	    val = value_t::make_bytes(v, len);
+	    break;
+	}
+    case DW_FORM_block2:
+	{
+	    uint16_t len;
+	    const unsigned char *v;
+	    if (!r.read_u16(len) ||
+		!r.read_bytes(v, len))
+		return false;
+	    val = value_t::make_bytes(v, len);
+	    break;
+	}
+    case DW_FORM_block4:
+	{
+	    uint32_t len;
+	    const unsigned char *v;
+	    if (!r.read_u32(len) ||
+		!r.read_bytes(v, len))
+		return false;
+	    val = value_t::make_bytes(v, len);
+	    break;
+	}
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+	{
+	    uint32_t len;
+	    const unsigned char *v;
+	    if (!r.read_uleb128(len) ||
+		!r.read_bytes(v, len))
+		return false;
+	    val = value_t::make_bytes(v, len);
+	    break;
+	}
+    case DW_FORM_ref_udata:
+	{
+	    uint32_t off;
+	    if (!r.read_uleb128(off))
+		return false;
+	    val = value_t::make_ref(make_reference(off));
+	    break;
+	}
+    case DW_FORM_ref_addr:
+	{
+	    // an offset into .debug_info, which may be
+	    // in a different compile unit
+	    np::spiegel::addr_t off;
+	    if (get_version() == 2)
+	    {
+		if (!r.read_addr(off))
+		    return false;
+	    }
+	    else
+	    {
+		uint32_t off32;
+		if (!r.read_u32(off32))
+		    return false;
+		off = off32;
+	    }
+	    const compile_unit_t *cu = state_t::instance()->find_compile_unit(
+				loindex_, off);
+	    if (!cu)
+		return false;
+	    val = value_t::make_ref(cu->make_reference(off - cu->get_offset()));
+	    break;
+	}
+    case DW_FORM_sec_offset:
+	{
+	    uint32_t v;
+	    if (!r.read_u32(v))
+		return false;
+	    val = value_t::make_uint32(v);
+	    break;
+	}
+    case DW_FORM_flag_present:
+	val = value_t::make_uint32(1);
+	break;
+    case DW_FORM_implicit_const:
+	// The form doesn't say whether the constant is signed,
+	// and most of the attributes which use it are unsigned.
+	if (as.implicit_const >= 0)
+	    val = value_t::make_uint32(as.implicit_const);
+	else
+	    val = value_t::make_sint32(as.implicit_const);
+	break;
+    case DW_FORM_line_strp:
+	{
+	    uint32_t off;
+	    if (!r.read_u32(off))
+		return false;
+	    const char *v = get_section(DW_sec_line_str)->offset_as_string(off);
+	    if (!v)
+		return false;
+	    val = value_t::make_string(v);
+	    break;
+	}
+    case DW_FORM_strx:
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4:
+	{
+	    uint32_t idx;
+	    if (!read_index(r, form, idx))
+		return false;
+	    const char *v = get_indexed_string(idx);
+	    if (!v)
+		return false;
+	    val = value_t::make_string(v);
+	    break;
+	}
+    case DW_FORM_addrx:
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4:
+	{
+	    uint32_t idx;
+	    np::spiegel::addr_t v;
+	    if (!read_index(r, form, idx) ||
+		!get_indexed_address(idx, v))
+		return false;
+	    val = value_t::make_address(v);
+	    break;
+	}
+    case DW_FORM_rnglistx:
+	{
+	    // Resolve the index now, so that DW_AT_ranges
+	    // is always an offset into .debug_rnglists
+	    uint32_t idx;
+	    uint32_t off;
+	    if (!r.read_uleb128(idx) ||
+		!get_rnglist_offset(idx, off))
+		return false;
+	    val = value_t::make_uint32(off);
+	    break;
+	}
+    case DW_FORM_loclistx:
+	{
+	    uint32_t v;
+	    if (!r.read_uleb128(v))
+		return false;
+	    val = value_t::make_uint32(v);
+	    break;
+	}
+    case DW_FORM_ref_sig8:
+	{
+	    // We don't read type units, so all
+	    // we can keep is the type signature
+	    uint64_t v;
+	    if (!r.read_u64(v))
+		return false;
+	    val = value_t::make_uint64(v);
+	    break;
+	}
+    case DW_FORM_data16:
+	{
+	    const unsigned char *v;
+	    if (!r.read_bytes(v, 16))
+		return false;
+	    val = value_t::make_bytes(v, 16);
+	    break;
+	}
+    case DW_FORM_strp_sup:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_ref_sup8:
+	// These point into a supplementary object file, which
+	// we don't support, so they're as good as missing.
+	return false;
+    default:
+	// TODO: bad DWARF info - throw an exception
+	fatal("XXX can't handle %s\n",
+	      formvals.to_name(form));
+    }
+    return true;
+}
+
+
+const char *
+compile_unit_t::get_indexed_string(uint32_t idx) const
+{
+    reader_t r = get_section(DW_sec_str_offsets)->get_contents();
+    uint32_t off;
+    if (!r.seek(str_offsets_base_ + idx * 4) ||
+	!r.read_u32(off))
+	return 0;
+    return get_section(DW_sec_str)->offset_as_string(off);
+}
+
+bool
+compile_unit_t::get_indexed_address(uint32_t idx, np::spiegel::addr_t &addr) const
+{
+    reader_t r = get_section(DW_sec_addr)->get_contents();
+    return r.seek(addr_base_ + idx * _NP_ADDRSIZE) &&
+	   r.read_addr(addr);
+}
+
+bool
+compile_unit_t::get_rnglist_offset(uint32_t idx, uint32_t &off) const
+{
+    reader_t r = get_section(DW_sec_rnglists)->get_contents();
+    if (!r.seek(rnglists_base_ + idx * 4) ||
+	!r.read_u32(off))
+	return false;
+    /* the offsets table is relative to its own start */
+    off += rnglists_base_;
+    return true;
+}
+
 // close namespaces
 }; }; };
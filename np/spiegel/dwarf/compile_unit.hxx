@@ -19,35 +19,60 @@
 #include "np/spiegel/common.hxx"
 #include "reference.hxx"
 #include "reader.hxx"
+#include "abbrev.hxx"
+#include "value.hxx"
 
 namespace np {
 namespace spiegel {
 namespace dwarf {
 
-class abbrev_t;
 class walker_t;
 class section_t;
 
 class compile_unit_t
 {
-private:
-    enum { header_length = 11 };	    // this might depend on version
 public:
     compile_unit_t(uint32_t idx, uint32_t loidx)
      :  index_(idx),
-        loindex_(loidx)
+        loindex_(loidx),
+	offset_(0),
+	header_length_(0),
+	version_(0),
+	str_offsets_base_(0),
+	addr_base_(0),
+	rnglists_base_(0),
+	base_address_(0),
+	abbrevs_offset_(0),
+	abbrevs_(0)
     {}
 
     ~compile_unit_t()
     {}
 
     bool read_header(reader_t &r);
-    bool read_compile_unit_entry(walker_t &w);
-    void read_abbrevs(reader_t &r);
-    void dump_abbrevs() const;
+    bool read_compile_unit_entry();
+    void dump_abbrevs();
+    bool skip_form(reader_t &r, uint32_t form) const;
+    bool read_form(reader_t &r, const abbrev_t::attr_spec_t &as,
+		   uint32_t form, value_t &val) const;
 
     uint32_t get_index() const { return index_; }
     uint32_t get_link_object_index() const { return loindex_; }
+    uint16_t get_version() const { return version_; }
+    // offset and length of the whole unit in .debug_info
+    uint32_t get_offset() const { return offset_; }
+    uint32_t get_length() const { return reader_.get_remains(); }
+    // the DWARF5 tables which the strx, addrx and rnglistx
+    // forms index into start at these offsets
+    uint32_t get_str_offsets_base() const { return str_offsets_base_; }
+    uint32_t get_addr_base() const { return addr_base_; }
+    uint32_t get_rnglists_base() const { return rnglists_base_; }
+    // DW_AT_low_pc of the unit, which address ranges are relative to
+    np::spiegel::addr_t get_base_address() const { return base_address_; }
+
+    const char *get_indexed_string(uint32_t idx) const;
+    bool get_indexed_address(uint32_t idx, np::spiegel::addr_t &addr) const;
+    bool get_rnglist_offset(uint32_t idx, uint32_t &off) const;
     const char *get_executable() const;
     const section_t *get_section(uint32_t) const;
 
@@ -62,28 +87,46 @@ public:
     {
 	reference_t ref;
 	ref.cu = index_;
-	ref.offset = header_length;
+	ref.offset = header_length_;
 	return ref;
     }
 
     reader_t get_contents() const
     {
 	reader_t r = reader_;
-	r.skip(header_length);
+	r.skip(header_length_);
 	return r;
     }
 
-    const abbrev_t *get_abbrev(uint32_t code) const
+    // read the abbreviations and the unit's own entry, if
+    // that hasn't been done yet
+    void prepare()
+    {
+	if (!abbrevs_)
+	    read_abbrevs();
+    }
+
+    const abbrev_t *get_abbrev(uint32_t code)
     {
-	return (code >= abbrevs_.size() ? 0 : abbrevs_[code]);
+	prepare();
+	return abbrevs_->get_abbrev(code);
     }
 
 private:
     uint32_t index_;
     uint32_t loindex_;
     reader_t reader_;	    // for whole including header
+    uint32_t offset_;	    // of the header in .debug_info
+    uint32_t header_length_;	// depends on version and unit type
+    uint16_t version_;
+    uint32_t str_offsets_base_;
+    uint32_t addr_base_;
+    uint32_t rnglists_base_;
+    np::spiegel::addr_t base_address_;
     uint32_t abbrevs_offset_;
-    std::vector<abbrev_t*> abbrevs_;
+    const abbrev_table_t *abbrevs_;	// or 0 until needed
+
+    void read_abbrevs();
 };
 
 // close namespaces
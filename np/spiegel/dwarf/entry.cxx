@@ -14,11 +14,127 @@
  * limitations under the License.
  */
 #include "entry.hxx"
+#include "compile_unit.hxx"
 #include "enumerations.hxx"
 
 namespace np { namespace spiegel { namespace dwarf {
 using namespace std;
 
+static bool
+is_constant_form(uint32_t form)
+{
+    switch (form)
+    {
+    case DW_FORM_data1:
+    case DW_FORM_data2:
+    case DW_FORM_data4:
+    case DW_FORM_data8:
+    case DW_FORM_udata:
+    case DW_FORM_sdata:
+    case DW_FORM_implicit_const:
+	return true;
+    default:
+	return false;
+    }
+}
+
+static addr_t
+as_address(const value_t &v)
+{
+    if (v.type == value_t::T_UINT32)
+	return (addr_t)v.val.uint32;
+    else if (v.type == value_t::T_UINT64)
+	return (addr_t)v.val.uint64;
+    else
+	return 0;
+}
+
+/*
+ * Decode the i'th attribute, finding it from the abbrev's
+ * layout or from where the walker noted it starts.
+ */
+bool
+entry_t::decode(uint32_t i, value_t &val) const
+{
+    const abbrev_t::attr_spec_t *as = abbrev_->specs + i;
+    reader_t r = attrs_;
+
+    if (as->offset >= 0)
+    {
+	r.skip(as->offset);
+    }
+    else if (i < MAX_SPECS)
+    {
+	r.skip(positions_[i]);
+    }
+    else
+    {
+	// the walker didn't note this one, so
+	// skip forward from the last it did
+	uint32_t j = MAX_SPECS-1;
+	if (abbrev_->nfixed > j)
+	    j = abbrev_->nfixed;
+	if (abbrev_->specs[j].offset >= 0)
+	    r.skip(abbrev_->specs[j].offset);
+	else
+	    r.skip(positions_[j]);
+	for ( ; j < i ; j++)
+	{
+	    if (!compile_unit_->skip_form(r, abbrev_->specs[j].form))
+		return false;
+	}
+    }
+
+    uint32_t form = as->form;
+    // the real form of an indirect attribute is in the entry
+    if (form == DW_FORM_indirect && !r.read_uleb128(form))
+	return false;
+    value_t v;
+    if (!compile_unit_->read_form(r, *as, form, v))
+	return false;
+
+    // Since DWARF4, a constant high_pc is the length
+    // of the range rather than the address of its end
+    if (as->name == DW_AT_high_pc && is_constant_form(form))
+    {
+	const value_t *lo = get_attribute(DW_AT_low_pc);
+	if (lo)
+	    v = value_t::make_address(as_address(*lo) + as_address(v));
+    }
+    val = v;
+    return true;
+}
+
+const value_t *
+entry_t::get_attribute(uint32_t name) const
+{
+    if (!abbrev_)
+	return 0;
+
+    for (uint32_t i = 0 ; i < abbrev_->nspecs ; i++)
+    {
+	if (abbrev_->specs[i].name != name)
+	    continue;
+	if (i >= MAX_SPECS)
+	{
+	    // each gets its own slot, so values already
+	    // returned for this entry aren't overwritten
+	    if (extra_values_.size() < abbrev_->nspecs - MAX_SPECS)
+		extra_values_.resize(abbrev_->nspecs - MAX_SPECS);
+	    value_t &v = extra_values_[i - MAX_SPECS];
+	    return (decode(i, v) ? &v : 0);
+	}
+	if (!(decoded_ & (1U<<i)))
+	{
+	    if (!decode(i, values_[i]))
+		return 0;
+	    decoded_ |= (1U<<i);
+	}
+	return &values_[i];
+    }
+    return 0;
+}
+
 void
 entry_t::dump() const
 {
@@ -30,8 +146,8 @@ entry_t::dump() const
 	level_,
 	tagnames.to_name(abbrev_->tag));
 
-    vector<abbrev_t::attr_spec_t>::const_iterator i;
-    for (i = abbrev_->attr_specs.begin() ; i != abbrev_->attr_specs.end() ; ++i)
+    const abbrev_t::attr_spec_t *i;
+    for (i = abbrev_->specs_begin() ; i != abbrev_->specs_end() ; ++i)
     {
 	printf("    %s = ", attrnames.to_name(i->name));
 	const value_t *v = get_attribute(i->name);
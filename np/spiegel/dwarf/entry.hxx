@@ -18,6 +18,7 @@
 
 #include "np/spiegel/common.hxx"
 #include "value.hxx"
+#include "reader.hxx"
 #include "abbrev.hxx"
 #include "enumerations.hxx"
 
@@ -26,7 +27,15 @@ namespace spiegel {
 namespace dwarf {
 
 class abbrev_t;
+class compile_unit_t;
 
+/*
+ * One entry in the DWARF info, as read by a walker_t.  The walker
+ * only finds where the entry's attributes are; each attribute is
+ * decoded when it's first asked for, and kept until the walker
+ * moves on.  Most entries a walk passes over are never asked for
+ * more than a name or a sibling, so this saves a lot of work.
+ */
 class entry_t
 {
 public:
@@ -34,17 +43,20 @@ public:
      :  offset_(0),
 	level_(0),
 	abbrev_(0),
-	latest_(0)
+	compile_unit_(0),
+	decoded_(0)
     {
-	memset(generation_, 0x0, sizeof(generation_));
     }
 
-    void setup(size_t offset, unsigned level, const abbrev_t *a)
+    void setup(size_t offset, unsigned level, const abbrev_t *a,
+	       const compile_unit_t *cu, const reader_t &attrs)
     {
 	offset_ = offset;
 	level_ = level;
 	abbrev_ = a;
-	latest_++;
+	compile_unit_ = cu;
+	attrs_ = attrs;
+	decoded_ = 0;
     }
     void partial_setup(const entry_t &o)
     {
@@ -58,20 +70,12 @@ public:
 	level_ = lev;
 	abbrev_ = 0;
     }
-    void partial_setup(uint32_t off, uint32_t lev, const abbrev_t *a)
-    {
-	offset_ = off;
-	level_ = lev;
-	abbrev_ = a;
-    }
-
-    void add_attribute(uint32_t name, const value_t &val)
+    // where the i'th attribute starts, relative to the first,
+    // for those the abbrev's layout doesn't know
+    void set_position(uint32_t i, uint32_t pos)
     {
-	int i = name_to_index(name);
-	if (i < 0)
-	    return;	// silently ignore this
-	values_[i] = val;
-	generation_[i] = latest_;
+	if (i < MAX_SPECS)
+	    positions_[i] = pos;
     }
 
     unsigned get_offset() const { return offset_; }
@@ -81,11 +85,7 @@ public:
     bool has_children() const { return abbrev_->children; }
     void dump() const;
 
-    const value_t *get_attribute(uint32_t name) const
-    {
-	int i = name_to_index(name);
-	return (i >= 0 && generation_[i] == latest_ ? &values_[i] : 0);
-    }
+    const value_t *get_attribute(uint32_t name) const;
     const char *get_string_attribute(uint32_t name) const
     {
 	const value_t *v = get_attribute(name);
@@ -134,27 +134,24 @@ public:
 private:
     enum
     {
-	// we oversupply space, because entry_t is never
-	// allocated and stored but handling a sparse mapping
-	// was taking up too many cycles.
-	MAX_VALUES = DW_AT_max_basic + (DW_AT_max_user - DW_AT_lo_user)
+	// Abbrevs with more attributes than this are rare
+	// enough that their later attributes can be found
+	// the slow way, and decoded every time they're asked for.
+	MAX_SPECS = 32
     };
-    static int name_to_index(int name)
-    {
-	if (name < DW_AT_max_basic)
-	    return name;
-	else if (name >= DW_AT_lo_user && name < DW_AT_max_user)
-	    return DW_AT_max_basic+name-DW_AT_lo_user;
-	else
-	    return -1;
-    }
+
+    bool decode(uint32_t i, value_t &val) const;
 
     unsigned offset_;
     unsigned level_;
     const abbrev_t *abbrev_;
-    uint32_t latest_;
-    uint32_t generation_[MAX_VALUES];
-    value_t values_[MAX_VALUES];
+    const compile_unit_t *compile_unit_;
+    reader_t attrs_;		// at the first attribute
+    uint32_t positions_[MAX_SPECS];
+    mutable uint32_t decoded_;	// bitmask of values_ we have
+    mutable value_t values_[MAX_SPECS];	    // by spec
+    // by spec after the first MAX_SPECS, grown as needed
+    mutable std::vector<value_t> extra_values_;
 };
 
 
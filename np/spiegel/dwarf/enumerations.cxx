@@ -21,7 +21,9 @@ using namespace std;
 static const char * const _secnames[DW_sec_num+1] = {
     ".debug_aranges", ".debug_pubnames", ".debug_info",
     ".debug_abbrev", ".debug_line", ".debug_frame",
-    ".debug_str", ".debug_loc", ".debug_ranges", ".plt", 0
+    ".debug_str", ".debug_loc", ".debug_ranges",
+    ".debug_str_offsets", ".debug_addr", ".debug_line_str",
+    ".debug_rnglists", ".debug_names", ".gdb_index", ".plt", 0
 };
 string_table_t secnames("", _secnames);
 
@@ -54,6 +56,28 @@ static const char * const _formvals[] = {
     "ref8", /* 0x14, */
     "ref_udata", /* 0x15, */
     "indirect", /* 0x16 */
+    "sec_offset", /* 0x17 */
+    "exprloc", /* 0x18 */
+    "flag_present", /* 0x19 */
+    "strx", /* 0x1a */
+    "addrx", /* 0x1b */
+    "ref_sup4", /* 0x1c */
+    "strp_sup", /* 0x1d */
+    "data16", /* 0x1e */
+    "line_strp", /* 0x1f */
+    "ref_sig8", /* 0x20 */
+    "implicit_const", /* 0x21 */
+    "loclistx", /* 0x22 */
+    "rnglistx", /* 0x23 */
+    "ref_sup8", /* 0x24 */
+    "strx1", /* 0x25 */
+    "strx2", /* 0x26 */
+    "strx3", /* 0x27 */
+    "strx4", /* 0x28 */
+    "addrx1", /* 0x29 */
+    "addrx2", /* 0x2a */
+    "addrx3", /* 0x2b */
+    "addrx4", /* 0x2c */
     0
 };
 string_table_t formvals("DW_FORM_", _formvals);
@@ -124,6 +148,17 @@ static const char * const _tagnames[] = {
     "",
     "condition",	    /* 0x3f */
     "shared_type",	    /* 0x40 */
+    "type_unit",	    /* 0x41 */
+    "rvalue_reference_type", /* 0x42 */
+    "template_alias",	    /* 0x43 */
+    "coarray_type",	    /* 0x44 */
+    "generic_subrange",	    /* 0x45 */
+    "dynamic_type",	    /* 0x46 */
+    "atomic_type",	    /* 0x47 */
+    "call_site",	    /* 0x48 */
+    "call_site_parameter",  /* 0x49 */
+    "skeleton_unit",	    /* 0x4a */
+    "immutable_type",	    /* 0x4b */
     0
 };
 string_table_t tagnames("DW_TAG_", _tagnames);
@@ -234,6 +269,42 @@ static const char * const _attrnames[] = {
     "elemental",	/* 0x66, */
     "pure",		/* 0x67, */
     "recursive",	/* 0x68, */
+    "signature",	/* 0x69, */
+    "main_subprogram",	/* 0x6a, */
+    "data_bit_offset",	/* 0x6b, */
+    "const_expr",	/* 0x6c, */
+    "enum_class",	/* 0x6d, */
+    "linkage_name",	/* 0x6e, */
+    "string_length_bit_size",/* 0x6f, */
+    "string_length_byte_size",/* 0x70, */
+    "rank",		/* 0x71, */
+    "str_offsets_base",	/* 0x72, */
+    "addr_base",	/* 0x73, */
+    "rnglists_base",	/* 0x74, */
+    "",
+    "dwo_name",		/* 0x76, */
+    "reference",	/* 0x77, */
+    "rvalue_reference",	/* 0x78, */
+    "macros",		/* 0x79, */
+    "call_all_calls",	/* 0x7a, */
+    "call_all_source_calls",/* 0x7b, */
+    "call_all_tail_calls",/* 0x7c, */
+    "call_return_pc",	/* 0x7d, */
+    "call_value",	/* 0x7e, */
+    "call_origin",	/* 0x7f, */
+    "call_parameter",	/* 0x80, */
+    "call_pc",		/* 0x81, */
+    "call_tail_call",	/* 0x82, */
+    "call_target",	/* 0x83, */
+    "call_target_clobbered",/* 0x84, */
+    "call_data_location",/* 0x85, */
+    "call_data_value",	/* 0x86, */
+    "noreturn",		/* 0x87, */
+    "alignment",	/* 0x88, */
+    "export_symbols",	/* 0x89, */
+    "deleted",		/* 0x8a, */
+    "defaulted",	/* 0x8b, */
+    "loclists_base",	/* 0x8c, */
     0,
 };
 string_table_t attrnames("DW_AT_", _attrnames);
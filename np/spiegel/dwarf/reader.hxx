@@ -124,7 +124,30 @@ public:
 #endif
     }
 
+    /*
+     * LEB128 numbers are mostly a single byte, which is handled
+     * straight away.  Longer ones are found by loading the next
+     * eight bytes at once and looking at all their top bits
+     * together.  Near the end of the data, or for numbers which
+     * don't fit in 32 bits, these fall back to the _slow versions,
+     * which go a byte at a time.
+     */
     bool read_uleb128(uint32_t &v)
+    {
+	if (p_ < end_ && !(*p_ & 0x80))
+	{
+	    v = *p_++;
+	    return true;
+	}
+	uint64_t w;
+	unsigned len;
+	if (!load_leb128(w, len) || len > 5)
+	    return read_uleb128_slow(v);
+	v = compact_leb128(w);
+	p_ += len;
+	return true;
+    }
+    bool read_uleb128_slow(uint32_t &v)
     {
 	const unsigned char *pp = p_;
 	uint32_t vv = 0;
@@ -133,7 +156,8 @@ public:
 	{
 	    if (pp == end_)
 		return false;
-	    vv |= ((*pp) & 0x7f) << shift;
+	    if (shift < 32)
+		vv |= ((*pp) & 0x7f) << shift;
 	    shift += 7;
 	} while ((*pp++) & 0x80);
 	p_ = pp;
@@ -142,6 +166,18 @@ public:
     }
     bool skip_uleb128()
     {
+	if (p_ < end_ && !(*p_ & 0x80))
+	{
+	    p_++;
+	    return true;
+	}
+	uint64_t w;
+	unsigned len;
+	if (load_leb128(w, len))
+	{
+	    p_ += len;
+	    return true;
+	}
 	const unsigned char *pp = p_;
 	do
 	{
@@ -153,6 +189,27 @@ public:
     }
 
     bool read_sleb128(int32_t &v)
+    {
+	if (p_ < end_ && !(*p_ & 0x80))
+	{
+	    // sign extend from bit 6
+	    v = (int32_t)((uint32_t)*p_++ << 25) >> 25;
+	    return true;
+	}
+	uint64_t w;
+	unsigned len;
+	if (!load_leb128(w, len) || len > 5)
+	    return read_sleb128_slow(v);
+	uint32_t vv = compact_leb128(w);
+	unsigned shift = 7 * len;
+	// sign extend the result, from the last encoded bit
+	if (shift < 32 && (w >> (8*len-2)) & 1)
+	    vv |= (~0U << shift);
+	v = vv;
+	p_ += len;
+	return true;
+    }
+    bool read_sleb128_slow(int32_t &v)
     {
 	const unsigned char *pp = p_;
 	uint32_t vv = 0;
@@ -162,12 +219,13 @@ public:
 	{
 	    if (pp == end_)
 		return false;
-	    vv |= ((*pp) & 0x7f) << shift;
+	    if (shift < 32)
+		vv |= ((*pp) & 0x7f) << shift;
 	    shift += 7;
 	} while ((*pp++) & 0x80);
 
 	// sign extend the result, from the last encoded bit
-	if (pp[-1] & 0x40)
+	if (shift < 32 && (pp[-1] & 0x40))
 	    v = vv | (~0U << shift);
 	else
 	    v = vv;
@@ -176,14 +234,7 @@ public:
     }
     bool skip_sleb128()
     {
-	const unsigned char *pp = p_;
-	do
-	{
-	    if (pp == end_)
-		return false;
-	} while ((*pp++) & 0x80);
-	p_ = pp;
-	return true;
+	return skip_uleb128();
     }
 
     bool read_u16(uint16_t &v)
@@ -247,6 +298,36 @@ public:
     }
 
 private:
+    /* Loads the LEB128 number at p_ into w, in the byte order it's
+     * stored in, with the bytes after it cleared.  Fails if there
+     * aren't eight bytes left or the number is longer than that. */
+    bool load_leb128(uint64_t &w, unsigned &len) const
+    {
+	if (end_ - p_ < 8)
+	    return false;
+	memcpy(&w, p_, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	w = __builtin_bswap64(w);
+#endif
+	// the last byte is the first without its top bit set
+	uint64_t stops = ~w & 0x8080808080808080ULL;
+	if (!stops)
+	    return false;
+	len = (__builtin_ctzll(stops) + 1) / 8;
+	w &= ~0ULL >> (64 - 8*len);
+	return true;
+    }
+    /* Gathers the 7 bit groups of a number of up to 5 bytes
+     * loaded by load_leb128(), dropping any beyond 32 bits */
+    static uint32_t compact_leb128(uint64_t w)
+    {
+	return (uint32_t)((w & 0x7fULL) |
+			  ((w >> 1) & (0x7fULL << 7)) |
+			  ((w >> 2) & (0x7fULL << 14)) |
+			  ((w >> 3) & (0x7fULL << 21)) |
+			  ((w >> 4) & (0x7fULL << 28)));
+    }
+
     const unsigned char *p_;
     const unsigned char *end_;
     const unsigned char *base_;
@@ -15,12 +15,15 @@
  */
 #include "np/spiegel/common.hxx"
 #include <sys/fcntl.h>
+#include <sys/stat.h>
 #include <bfd.h>
+#include <pthread.h>
 #include "state.hxx"
 #include "reader.hxx"
 #include "compile_unit.hxx"
 #include "walker.hxx"
 #include "np/spiegel/platform/common.hxx"
+#include "np/util/parallel.hxx"
 
 namespace np { namespace spiegel { namespace dwarf {
 using namespace std;
@@ -29,6 +32,8 @@ using namespace np::util;
 state_t *state_t::instance_ = 0;
 
 state_t::state_t()
+ :  function_index_read_(false),
+    function_index_valid_(false)
 {
     assert(!instance_);
     instance_ = this;
@@ -48,6 +53,7 @@ state_t::~state_t()
 bool
 state_t::linkobj_t::map_sections()
 {
+    PROFILE;
     int fd = -1;
     vector<section_t>::iterator m;
     bool r = true;
@@ -196,7 +202,9 @@ bool
 state_t::read_compile_units(linkobj_t *lo)
 {
     reader_t infor = lo->sections_[DW_sec_info].get_contents();
-    reader_t abbrevr = lo->sections_[DW_sec_abbrev].get_contents();
+
+    lo->first_cu_ = compile_units_.size();
+    lo->ncus_ = 0;
 
     compile_unit_t *cu = 0;
     for (;;)
@@ -205,14 +213,408 @@ state_t::read_compile_units(linkobj_t *lo)
 	if (!cu->read_header(infor))
 	    break;
 
-	cu->read_abbrevs(abbrevr);
 
 	compile_units_.push_back(cu);
+	lo->ncus_++;
     }
     delete cu;
     return true;
 }
 
+compile_unit_t *
+state_t::find_compile_unit(uint32_t loindex, uint32_t off) const
+{
+    const linkobj_t *lo = linkobjs_[loindex];
+
+    /* binary search, as the units are in .debug_info order */
+    uint32_t first = lo->first_cu_;
+    uint32_t last = lo->first_cu_ + lo->ncus_;
+    while (first < last)
+    {
+	uint32_t mid = (first + last) / 2;
+	compile_unit_t *cu = compile_units_[mid];
+	if (off < cu->get_offset())
+	    last = mid;
+	else if (off >= cu->get_offset() + cu->get_length())
+	    first = mid+1;
+	else
+	    return cu;
+    }
+    return 0;
+}
+
+const abbrev_table_t *
+state_t::get_abbrev_table(uint32_t loindex, uint32_t off)
+{
+    linkobj_t *lo = linkobjs_[loindex];
+    abbrev_table_t *table;
+
+    // units being walked on different threads may share a table
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock(&lock);
+
+    map<uint32_t, abbrev_table_t*>::iterator i = lo->abbrev_tables_.find(off);
+    if (i != lo->abbrev_tables_.end())
+    {
+	table = i->second;
+    }
+    else
+    {
+	table = new abbrev_table_t();
+	reader_t r = lo->sections_[DW_sec_abbrev].get_contents();
+	if (r.seek(off))
+	    table->read(r);
+	lo->abbrev_tables_[off] = table;
+    }
+
+    pthread_mutex_unlock(&lock);
+    return table;
+}
+
+/*
+ * Strip any scope qualifiers and parameters from a C++
+ * name in .gdb_index, leaving what would be in DW_AT_name.
+ */
+static string
+unqualified_name(const char *name)
+{
+    string s = name;
+    size_t p = s.find('(');
+    if (p != string::npos)
+	s.resize(p);
+    p = s.rfind("::");
+    if (p != string::npos)
+	s.erase(0, p+2);
+    return s;
+}
+
+static bool
+read_index_value(reader_t &r, const abbrev_t::attr_spec_t &as, uint64_t &v)
+{
+    switch (as.form)
+    {
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+	{
+	    uint8_t v8;
+	    if (!r.read_u8(v8))
+		return false;
+	    v = v8;
+	    return true;
+	}
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+	{
+	    uint16_t v16;
+	    if (!r.read_u16(v16))
+		return false;
+	    v = v16;
+	    return true;
+	}
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+	{
+	    uint32_t v32;
+	    if (!r.read_u32(v32))
+		return false;
+	    v = v32;
+	    return true;
+	}
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+	return r.read_u64(v);
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+	{
+	    uint32_t v32;
+	    if (!r.read_uleb128(v32))
+		return false;
+	    v = v32;
+	    return true;
+	}
+    case DW_FORM_flag_present:
+	v = 1;
+	return true;
+    case DW_FORM_implicit_const:
+	v = as.implicit_const;
+	return true;
+    default:
+	return false;
+    }
+}
+
+/* like abbrev_t but without the children flag */
+struct name_abbrev_t
+{
+    uint32_t tag;
+    vector<abbrev_t::attr_spec_t> specs;
+};
+
+/*
+ * Read the DWARF5 name index, returning false unless
+ * it covers every compile unit in the link object.
+ */
+bool
+state_t::read_debug_names(linkobj_t *lo, function_index_t &index)
+{
+    reader_t r = lo->sections_[DW_sec_names].get_contents();
+    const section_t *strs = &lo->sections_[DW_sec_str];
+    uint32_t ncus = 0;
+
+    while (r.get_remains())
+    {
+	uint32_t length;
+	uint16_t version;
+	uint32_t cu_count;
+	uint32_t local_tu_count;
+	uint32_t foreign_tu_count;
+	uint32_t bucket_count;
+	uint32_t name_count;
+	uint32_t abbrev_size;
+	uint32_t augmentation_size;
+
+	if (!r.read_u32(length) || length > r.get_remains())
+	    return false;
+	reader_t u = r.initial_subset(length);
+	r.skip(length);
+
+	if (!u.read_u16(version) || version != 5 ||
+	    !u.skip_u16() /*padding*/ ||
+	    !u.read_u32(cu_count) ||
+	    !u.read_u32(local_tu_count) ||
+	    !u.read_u32(foreign_tu_count) ||
+	    !u.read_u32(bucket_count) ||
+	    !u.read_u32(name_count) ||
+	    !u.read_u32(abbrev_size) ||
+	    !u.read_u32(augmentation_size) ||
+	    !u.skip(augmentation_size))
+	    return false;
+
+	vector<compile_unit_t*> cus;
+	for (uint32_t i = 0 ; i < cu_count ; i++)
+	{
+	    uint32_t off;
+	    if (!u.read_u32(off))
+		return false;
+	    compile_unit_t *cu = find_compile_unit(lo->index_, off);
+	    if (!cu)
+		return false;
+	    cus.push_back(cu);
+	}
+	ncus += cu_count;
+
+	/* skip the type unit lists and the hash table,
+	 * we want every name not a particular one */
+	if (!u.skip(local_tu_count * 4 + foreign_tu_count * 8 +
+		    bucket_count * 4 + (bucket_count ? name_count * 4 : 0)))
+	    return false;
+
+	reader_t stroffs = u;
+	reader_t entryoffs = u;
+	if (!entryoffs.skip(name_count * 4) ||
+	    !u.skip(name_count * 8))
+	    return false;
+
+	map<uint32_t, name_abbrev_t> abbrevs;
+	reader_t ar = u.initial_subset(abbrev_size);
+	if (!u.skip(abbrev_size))
+	    return false;
+	uint32_t code;
+	while (ar.read_uleb128(code) && code)
+	{
+	    name_abbrev_t &a = abbrevs[code];
+	    if (!ar.read_uleb128(a.tag))
+		return false;
+	    for (;;)
+	    {
+		abbrev_t::attr_spec_t as;
+		as.implicit_const = 0;
+		if (!ar.read_uleb128(as.name) ||
+		    !ar.read_uleb128(as.form))
+		    return false;
+		if (!as.name && !as.form)
+		    break;
+		if (as.form == DW_FORM_implicit_const &&
+		    !ar.read_sleb128(as.implicit_const))
+		    return false;
+		a.specs.push_back(as);
+	    }
+	}
+
+	/* entry offsets are relative to the start of the pool */
+	reader_t pool = u.initial_subset(u.get_remains());
+
+	for (uint32_t i = 0 ; i < name_count ; i++)
+	{
+	    uint32_t stroff;
+	    uint32_t entryoff;
+	    if (!stroffs.read_u32(stroff) ||
+		!entryoffs.read_u32(entryoff) ||
+		!pool.seek(entryoff))
+		return false;
+	    const char *name = strs->offset_as_string(stroff);
+	    if (!name)
+		return false;
+
+	    /* a series of entries ends with a 0 code */
+	    while (pool.read_uleb128(code) && code)
+	    {
+		map<uint32_t, name_abbrev_t>::const_iterator a = abbrevs.find(code);
+		if (a == abbrevs.end())
+		    return false;
+
+		/* with a single unit, entries needn't say which */
+		uint64_t cuidx = (cu_count == 1 ? 0 : cu_count);
+		bool is_type_unit = false;
+		vector<abbrev_t::attr_spec_t>::const_iterator as;
+		for (as = a->second.specs.begin() ; as != a->second.specs.end() ; ++as)
+		{
+		    uint64_t v;
+		    if (!read_index_value(pool, *as, v))
+			return false;
+		    if (as->name == DW_IDX_compile_unit)
+			cuidx = v;
+		    else if (as->name == DW_IDX_type_unit)
+			is_type_unit = true;
+		}
+		if (a->second.tag == DW_TAG_subprogram &&
+		    !is_type_unit && cuidx < cu_count)
+		    index[name].push_back(cus[cuidx]->get_index());
+	    }
+	}
+    }
+
+    return (ncus == lo->ncus_);
+}
+
+/*
+ * Read the index which gdb-add-index and the gold and lld
+ * linkers build, returning false unless it covers every
+ * compile unit in the link object.
+ */
+bool
+state_t::read_gdb_index(linkobj_t *lo, function_index_t &index)
+{
+    const section_t *sec = &lo->sections_[DW_sec_gdb_index];
+    reader_t r = sec->get_contents();
+    uint32_t version;
+    uint32_t cu_list;
+    uint32_t types_list;
+    uint32_t address_area;
+    uint32_t symtab;
+    uint32_t pool;
+
+    if (!r.read_u32(version) ||
+	!r.read_u32(cu_list) ||
+	!r.read_u32(types_list) ||
+	!r.read_u32(address_area) ||
+	!r.read_u32(symtab) ||
+	!r.read_u32(pool))
+	return false;
+    /* before version 7 the index didn't say which
+     * symbols are functions */
+    if (version < 7 || version > 8)
+	return false;
+    if (cu_list > types_list || symtab > pool)
+	return false;
+
+    uint32_t ncus = (types_list - cu_list) / 16;
+    if (ncus != lo->ncus_)
+	return false;
+    vector<compile_unit_t*> cus;
+    r.seek(cu_list);
+    for (uint32_t i = 0 ; i < ncus ; i++)
+    {
+	uint64_t off;
+	if (!r.read_u64(off) || !r.skip_u64() /*length*/)
+	    return false;
+	compile_unit_t *cu = find_compile_unit(lo->index_, off);
+	if (!cu)
+	    return false;
+	cus.push_back(cu);
+    }
+
+    enum { KIND_NONE = 0, KIND_FUNCTION = 3 };
+    uint32_t nslots = (pool - symtab) / 8;
+    r.seek(symtab);
+    for (uint32_t i = 0 ; i < nslots ; i++)
+    {
+	uint32_t nameoff;
+	uint32_t vecoff;
+	if (!r.read_u32(nameoff) || !r.read_u32(vecoff))
+	    return false;
+	if (!nameoff && !vecoff)
+	    continue;	    /* empty slot */
+	const char *name = sec->offset_as_string(pool + nameoff);
+	if (!name)
+	    return false;
+
+	reader_t vr = sec->get_contents();
+	uint32_t count;
+	if (!vr.seek(pool + vecoff) || !vr.read_u32(count))
+	    return false;
+	while (count--)
+	{
+	    uint32_t e;
+	    if (!vr.read_u32(e))
+		return false;
+	    uint32_t cuidx = e & 0xffffff;
+	    uint32_t kind = (e >> 28) & 0x7;
+	    /* gold doesn't record the kind, so that might be a function */
+	    if ((kind == KIND_FUNCTION || kind == KIND_NONE) && cuidx < ncus)
+		index[unqualified_name(name)].push_back(cus[cuidx]->get_index());
+	}
+    }
+
+    return true;
+}
+
+const state_t::function_index_t *
+state_t::get_function_index()
+{
+    PROFILE;
+    if (!function_index_read_)
+    {
+	function_index_read_ = true;
+	function_index_valid_ = true;
+
+	vector<linkobj_t*>::iterator i;
+	for (i = linkobjs_.begin() ; i != linkobjs_.end() ; ++i)
+	{
+	    linkobj_t *lo = *i;
+	    function_index_t index;
+
+	    if (!lo->ncus_)
+		continue;   /* nothing to find there anyway */
+
+	    bool found = false;
+	    if (lo->sections_[DW_sec_names].get_size())
+		found = read_debug_names(lo, index);
+	    if (!found && lo->sections_[DW_sec_gdb_index].get_size())
+	    {
+		index.clear();
+		found = read_gdb_index(lo, index);
+	    }
+	    if (!found)
+	    {
+		function_index_valid_ = false;
+		function_index_.clear();
+		break;
+	    }
+
+	    function_index_t::iterator j;
+	    for (j = index.begin() ; j != index.end() ; ++j)
+	    {
+		vector<uint32_t> &v = function_index_[j->first];
+		v.insert(v.end(), j->second.begin(), j->second.end());
+	    }
+	}
+    }
+    return (function_index_valid_ ? &function_index_ : 0);
+}
+
 static bool
 filename_is_ignored(const char *filename)
 {
@@ -238,6 +640,7 @@ filename_is_ignored(const char *filename)
 bool
 state_t::add_self()
 {
+    PROFILE;
     char *exe = np::spiegel::platform::self_exe();
     bool r = false;
 
@@ -443,6 +846,7 @@ state_t::dump_structs()
 		switch (e->get_tag())
 		{
 		case DW_TAG_member:
+		case DW_TAG_variable:	// a static member, in DWARF5
 		    printf("    /*member*/ ");
 		    describe_type(w);
 		    printf(" %s;\n", name);
@@ -604,28 +1008,22 @@ state_t::dump_abbrevs()
     printf("\n\n");
 }
 
+/*
+ * Read the address ranges in the list at the given offset, which
+ * DW_AT_ranges points into .debug_ranges or since DWARF5 into the
+ * more compact .debug_rnglists.
+ */
 void
-state_t::insert_ranges(const walker_t &w, reference_t funcref)
+state_t::read_ranges(const compile_unit_t *cu, uint32_t off,
+		     vector<pair<addr_t, addr_t> > &ranges) const
 {
-    const entry_t *e = w.get_entry();
-    bool has_lo = (e->get_attribute(DW_AT_low_pc) != 0);
-    uint64_t lo = e->get_uint64_attribute(DW_AT_low_pc);
-    bool has_hi = (e->get_attribute(DW_AT_high_pc) != 0);
-    uint64_t hi = e->get_uint64_attribute(DW_AT_high_pc);
-    // DW_AT_ranges is a DWARF3 attribute, but g++ generates
-    // it (despite only claiming DWARF2 compliance).
-    uint64_t ranges = e->get_uint64_attribute(DW_AT_ranges);
+    np::spiegel::addr_t base = cu->get_base_address();
+    np::spiegel::addr_t start, end;
 
-    if (has_lo && has_hi)
-    {
-	address_index_.insert(lo, hi, funcref);
-    }
-    else if (ranges)
+    if (cu->get_version() < 5)
     {
-	reader_t r = w.get_section_contents(DW_sec_ranges);
-	r.skip(ranges);
-	np::spiegel::addr_t base = 0; // TODO: compile unit base
-	np::spiegel::addr_t start, end;
+	reader_t r = cu->get_section(DW_sec_ranges)->get_contents();
+	r.skip(off);
 	for (;;)
 	{
 	    if (!r.read_addr(start) || !r.read_addr(end))
@@ -639,37 +1037,217 @@ state_t::insert_ranges(const walker_t &w, reference_t funcref)
 		base = end;
 		continue;
 	    }
-	    start += base;
-	    end += base;
-	    address_index_.insert(start, end, funcref);
+	    ranges.push_back(make_pair(start + base, end + base));
 	}
+	return;
+    }
+
+    reader_t r = cu->get_section(DW_sec_rnglists)->get_contents();
+    r.skip(off);
+    for (;;)
+    {
+	uint8_t kind;
+	uint32_t i, j;
+	if (!r.read_u8(kind) || kind == DW_RLE_end_of_list)
+	    break;
+	switch (kind)
+	{
+	case DW_RLE_base_addressx:
+	    if (!r.read_uleb128(i) ||
+		!cu->get_indexed_address(i, base))
+		return;
+	    continue;
+	case DW_RLE_startx_endx:
+	    if (!r.read_uleb128(i) || !r.read_uleb128(j) ||
+		!cu->get_indexed_address(i, start) ||
+		!cu->get_indexed_address(j, end))
+		return;
+	    break;
+	case DW_RLE_startx_length:
+	    if (!r.read_uleb128(i) || !r.read_uleb128(j) ||
+		!cu->get_indexed_address(i, start))
+		return;
+	    end = start + j;
+	    break;
+	case DW_RLE_offset_pair:
+	    if (!r.read_uleb128(i) || !r.read_uleb128(j))
+		return;
+	    start = base + i;
+	    end = base + j;
+	    break;
+	case DW_RLE_base_address:
+	    if (!r.read_addr(base))
+		return;
+	    continue;
+	case DW_RLE_start_end:
+	    if (!r.read_addr(start) || !r.read_addr(end))
+		return;
+	    break;
+	case DW_RLE_start_length:
+	    if (!r.read_addr(start) || !r.read_uleb128(j))
+		return;
+	    end = start + j;
+	    break;
+	default:
+	    /* can't tell how long it is, so can't go on */
+	    return;
+	}
+	ranges.push_back(make_pair(start, end));
+    }
+}
+
+void
+state_t::get_function_ranges(const walker_t &w, reference_t funcref,
+			     vector<address_range_t> &ranges) const
+{
+    const entry_t *e = w.get_entry();
+    bool has_lo = (e->get_attribute(DW_AT_low_pc) != 0);
+    uint64_t lo = e->get_uint64_attribute(DW_AT_low_pc);
+    bool has_hi = (e->get_attribute(DW_AT_high_pc) != 0);
+    uint64_t hi = e->get_uint64_attribute(DW_AT_high_pc);
+    // DW_AT_ranges is a DWARF3 attribute, but g++ generates
+    // it (despite only claiming DWARF2 compliance).
+    bool has_ranges = (e->get_attribute(DW_AT_ranges) != 0);
+    uint64_t off = e->get_uint64_attribute(DW_AT_ranges);
+
+    if (has_lo && has_hi)
+    {
+	ranges.push_back(address_range_t(lo, hi, funcref));
+    }
+    else if (has_ranges)
+    {
+	vector<pair<addr_t, addr_t> > rr;
+	read_ranges(w.get_compile_unit(), off, rr);
+	vector<pair<addr_t, addr_t> >::iterator i;
+	for (i = rr.begin() ; i != rr.end() ; ++i)
+	    ranges.push_back(address_range_t(i->first, i->second, funcref));
     }
     else if (has_lo)
     {
-	address_index_.insert(lo, funcref);
+	ranges.push_back(address_range_t(lo, lo, funcref));
     }
 }
 
+/*
+ * Called on one of several threads to find the address ranges of
+ * all the functions in the i'th compile unit.  This only reads the
+ * unit's own DWARF info, so the threads don't need to coordinate.
+ */
 void
-state_t::prepare_address_index()
+state_t::scan_function_ranges(unsigned int i, void *closure)
 {
+    vector<vector<address_range_t> > &ranges =
+	*(vector<vector<address_range_t> > *)closure;
+    const state_t *state = instance_;
     reference_t funcref;
 
+    walker_t w(state->compile_units_[i]);
+    // Functions can be nested in these but not in, say, enums or
+    // arrays.  Member functions of local classes are defined inside
+    // the class, so classes have to be searched too.
+    tagset_t descend;
+    descend.add(DW_TAG_compile_unit)
+	   .add(DW_TAG_partial_unit)
+	   .add(DW_TAG_namespace_type)
+	   .add(DW_TAG_module)
+	   .add(DW_TAG_class_type)
+	   .add(DW_TAG_structure_type)
+	   .add(DW_TAG_union_type)
+	   .add(DW_TAG_subprogram)
+	   .add(DW_TAG_lexical_block)
+	   .add(DW_TAG_inlined_subroutine);
+    w.set_filter_tags(tagset_t().add(DW_TAG_subprogram), descend);
+    while (const entry_t *e = w.move_preorder())
+    {
+	assert(e->get_tag() == DW_TAG_subprogram);
+	if (e->get_attribute(DW_AT_specification))
+	    funcref = e->get_reference_attribute(DW_AT_specification);
+	else
+	    funcref = w.get_reference();
+	state->get_function_ranges(w, funcref, ranges[i]);
+    }
+}
+
+/*
+ * A walk can follow references into other units, so all of them are
+ * prepared, not just the ones about to be walked.
+ */
+void
+state_t::prepare_compile_units()
+{
     vector<compile_unit_t*>::iterator i;
     for (i = compile_units_.begin() ; i != compile_units_.end() ; ++i)
+	(*i)->prepare();
+}
+
+void
+state_t::prepare_address_index()
+{
+    PROFILE;
+
+    // Walk the units in parallel, then build the index in
+    // unit order so it comes out the same as walking serially.
+    prepare_compile_units();
+    vector<vector<address_range_t> > ranges(compile_units_.size());
+    np::util::parallel_for(compile_units_.size(), scan_function_ranges, &ranges);
+
+    vector<vector<address_range_t> >::iterator i;
+    for (i = ranges.begin() ; i != ranges.end() ; ++i)
     {
-	walker_t w(*i);
-	w.set_filter_tag(DW_TAG_subprogram);
-	while (const entry_t *e = w.move_preorder())
+	vector<address_range_t>::iterator j;
+	for (j = i->begin() ; j != i->end() ; ++j)
+	    address_index_.insert(j->lo_, j->hi_, j->funcref_);
+    }
+}
+
+void
+state_t::get_address_index(vector<address_range_t> &ranges) const
+{
+    np::util::rangetree<addr_t, reference_t>::const_iterator i;
+    for (i = address_index_.begin() ; i != address_index_.end() ; ++i)
+	ranges.push_back(address_range_t(i->first.lo, i->first.hi, i->second));
+}
+
+void
+state_t::set_address_index(const vector<address_range_t> &ranges)
+{
+    address_index_.clear();
+    vector<address_range_t>::const_iterator i;
+    for (i = ranges.begin() ; i != ranges.end() ; ++i)
+	address_index_.insert(i->lo_, i->hi_, i->funcref_);
+}
+
+string
+state_t::get_identity() const
+{
+    string id;
+    vector<linkobj_t*>::const_iterator i;
+    for (i = linkobjs_.begin() ; i != linkobjs_.end() ; ++i)
+    {
+	/* not a real file, like the vDSO, so no DWARF info either */
+	struct stat sb;
+	if (stat((*i)->filename_, &sb) < 0)
+	    continue;
+
+	id += (*i)->filename_;
+	id += " ";
+	string build_id = np::spiegel::platform::get_build_id((*i)->filename_);
+	if (build_id != "")
+	{
+	    id += build_id;
+	}
+	else
 	{
-	    assert(e->get_tag() == DW_TAG_subprogram);
-	    if (e->get_attribute(DW_AT_specification))
-		funcref = e->get_reference_attribute(DW_AT_specification);
-	    else
-		funcref = w.get_reference();
-	    insert_ranges(w, funcref);
+	    /* no build ID, this is the best we can cheaply do */
+	    char buf[64];
+	    snprintf(buf, sizeof(buf), "%llu.%llu",
+		     (unsigned long long)sb.st_size,
+		     (unsigned long long)sb.st_mtime);
+	    id += buf;
 	}
+	id += "\n";
     }
+    return id;
 }
 
 bool
@@ -683,6 +1261,7 @@ state_t::is_within(np::spiegel::addr_t addr, const walker_t &w,
     uint64_t hi = e->get_uint64_attribute(DW_AT_high_pc);
     // DW_AT_ranges is a DWARF3 attribute, but g++ generates
     // it (despite only claiming DWARF2 compliance).
+    bool has_ranges = (e->get_attribute(DW_AT_ranges) != 0);
     uint64_t ranges = e->get_uint64_attribute(DW_AT_ranges);
     if (has_lo && has_hi)
     {
@@ -693,30 +1272,16 @@ state_t::is_within(np::spiegel::addr_t addr, const walker_t &w,
 	}
 	return false;
     }
-    if (ranges)
+    if (has_ranges)
     {
-	reader_t r = w.get_section_contents(DW_sec_ranges);
-	r.skip(ranges);
-	np::spiegel::addr_t base = 0; // TODO: compile unit base
-	np::spiegel::addr_t start, end;
-	for (;;)
+	vector<pair<addr_t, addr_t> > rr;
+	read_ranges(w.get_compile_unit(), ranges, rr);
+	vector<pair<addr_t, addr_t> >::iterator i;
+	for (i = rr.begin() ; i != rr.end() ; ++i)
 	{
-	    if (!r.read_addr(start) || !r.read_addr(end))
-		break;
-	    /* (0,0) marks the end of the list */
-	    if (!start && !end)
-		break;
-	    /* (~0,base) marks a new base address */
-	    if (start == _NP_MAXADDR)
-	    {
-		base = end;
-		continue;
-	    }
-	    start += base;
-	    end += base;
-	    if (addr >= start && addr < end)
+	    if (addr >= i->first && addr < i->second)
 	    {
-		offset = addr - base;
+		offset = addr - i->first;
 		return true;
 	    }
 	}
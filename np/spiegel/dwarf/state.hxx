@@ -21,6 +21,7 @@
 #include "np/util/rangetree.hxx"
 #include "section.hxx"
 #include "reference.hxx"
+#include "abbrev.hxx"
 #include "enumerations.hxx"
 
 namespace np {
@@ -50,6 +51,25 @@ public:
      * if you don't need to build stack traces. */
     void prepare_address_index();
 
+    /* The address index as a list of ranges, so that it can be
+     * saved and later restored instead of being prepared again. */
+    struct address_range_t
+    {
+	address_range_t() {}
+	address_range_t(addr_t lo, addr_t hi, reference_t ref)
+	 :  lo_(lo), hi_(hi), funcref_(ref) {}
+	addr_t lo_;
+	addr_t hi_;	    // same as lo_ for a single address
+	reference_t funcref_;
+    };
+    void get_address_index(std::vector<address_range_t> &ranges) const;
+    void set_address_index(const std::vector<address_range_t> &ranges);
+
+    /* Changes whenever any of the link objects does, so anything
+     * saved from reading their DWARF info can be thrown away.  Uses
+     * build IDs where the objects have them. */
+    std::string get_identity() const;
+
     bool describe_address(np::spiegel::addr_t addr,
 			  reference_t &curef,
 			  unsigned int &lineno,
@@ -61,40 +81,71 @@ public:
     static state_t *instance() { return instance_; }
 
     const std::vector<compile_unit_t*> &get_compile_units() const { return compile_units_; }
+    /* Read every unit's abbreviations and bases, which is otherwise
+     * done lazily, so that units can be walked on several threads. */
+    void prepare_compile_units();
     compile_unit_t *get_compile_unit(reference_t ref) const
     {
 	return compile_units_[ref.cu];
     }
+    // the compile unit in the link object containing
+    // the given offset into its .debug_info section
+    compile_unit_t *find_compile_unit(uint32_t loindex, uint32_t off) const;
+
+    /* Maps the names of functions defined in the program to
+     * the indexes of the compile units which define them, as
+     * read from the .debug_names or .gdb_index sections which
+     * some toolchains add.  Returns 0 unless every link object
+     * has one, in which case callers must walk the compile units. */
+    typedef std::map<std::string, std::vector<uint32_t> > function_index_t;
+    const function_index_t *get_function_index();
 
 private:
     struct linkobj_t
     {
 	linkobj_t(const char *n, uint32_t idx)
 	 :  filename_(np::util::xstrdup(n)),
-	    index_(idx)
+	    index_(idx),
+	    first_cu_(0),
+	    ncus_(0)
 	{
 	    memset(sections_, 0, sizeof(sections_));
 	}
 	~linkobj_t()
 	{
+	    std::map<uint32_t, abbrev_table_t*>::iterator i;
+	    for (i = abbrev_tables_.begin() ; i != abbrev_tables_.end() ; ++i)
+		delete i->second;
 	    unmap_sections();
 	    free(filename_);
 	}
 
 	char *filename_;
 	uint32_t index_;
+	// our compile units are compile_units_[first_cu_,first_cu_+ncus_)
+	uint32_t first_cu_;
+	uint32_t ncus_;
 	section_t sections_[DW_sec_num];
 	std::vector<section_t> mappings_;
 	std::vector<np::spiegel::mapping_t> system_mappings_;
+	// keyed by offset into .debug_abbrev
+	std::map<uint32_t, abbrev_table_t*> abbrev_tables_;
 
 	bool map_sections();
 	void unmap_sections();
     };
 
     linkobj_t *get_linkobj(const char *filename);
+    const abbrev_table_t *get_abbrev_table(uint32_t loindex, uint32_t off);
     bool read_linkobjs();
     bool read_compile_units(linkobj_t *);
-    void insert_ranges(const walker_t &w, reference_t funcref);
+    bool read_debug_names(linkobj_t *, function_index_t &);
+    bool read_gdb_index(linkobj_t *, function_index_t &);
+    void read_ranges(const compile_unit_t *cu, uint32_t off,
+		     std::vector<std::pair<addr_t, addr_t> > &ranges) const;
+    void get_function_ranges(const walker_t &w, reference_t funcref,
+			     std::vector<address_range_t> &ranges) const;
+    static void scan_function_ranges(unsigned int i, void *closure);
     bool is_within(np::spiegel::addr_t addr, const walker_t &w,
 		   unsigned int &offset) const;
 
@@ -103,6 +154,9 @@ private:
     std::vector<linkobj_t*> linkobjs_;
     std::vector<compile_unit_t*> compile_units_;
     np::util::rangetree<addr_t, reference_t> address_index_;
+    bool function_index_read_;
+    bool function_index_valid_;
+    function_index_t function_index_;
 
     friend class walker_t;
     friend class compile_unit_t;
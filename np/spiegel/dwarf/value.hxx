@@ -87,6 +87,14 @@ struct value_t
 	val.val.sint64 = v;
 	return val;
     }
+    static value_t make_address(np::spiegel::addr_t v)
+    {
+#if _NP_ADDRSIZE == 4
+	return make_uint32(v);
+#else
+	return make_uint64(v);
+#endif
+    }
     static value_t make_bytes(const unsigned char *b, size_t l)
     {
 	value_t val;
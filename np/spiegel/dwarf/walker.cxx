@@ -73,19 +73,18 @@ walker_t::read_entry()
 	fatal("XXX wtf - no abbrev for code 0x%x\n", acode);
     }
 
-    int r = RE_OK;
-
-    if (filter_tag_ && a->tag != filter_tag_)
-    {
-	entry_.partial_setup(offset, level_, a);
-	r = skip_attributes();
-	if (r == RE_OK)
-	    r = RE_FILTERED;
-    }
-    else
+    entry_.setup(offset, level_, a, compile_unit_, reader_);
+    int r = skip_attributes();
+    if (r == RE_OK && !filter_tags_.empty() && !filter_tags_.contains(a->tag))
     {
-	entry_.setup(offset, level_, a);
-	r = read_attributes();
+	r = RE_FILTERED;
+	// nothing we want can be under here, so don't look
+	if (a->children && !descend_tags_.contains(a->tag))
+	{
+	    if (skip_children() == RE_EOF)
+		return RE_EOF;
+	    return r;
+	}
     }
 
     if (a->children)
@@ -103,316 +102,82 @@ walker_t::read_entry()
     return r;
 }
 
+/*
+ * Move past the entry's attributes, using the abbrev's layout to
+ * jump straight over the fixed size ones, and noting where each
+ * of the others starts so that the entry can decode it later.
+ */
 int
-walker_t::read_attributes()
+walker_t::skip_attributes()
 {
     const abbrev_t *a = entry_.get_abbrev();
-    vector<abbrev_t::attr_spec_t>::const_iterator i;
-    for (i = a->attr_specs.begin() ; i != a->attr_specs.end() ; ++i)
+    if (a->size >= 0)
+	return (reader_.skip(a->size) ? RE_OK : RE_EOF);
+
+    size_t start = reader_.get_offset();
+    const abbrev_t::attr_spec_t *i = a->specs_begin() + a->nfixed;
+    if (!reader_.skip(i->offset))
+	return RE_EOF;
+    for ( ; i != a->specs_end() ; ++i)
     {
-	switch (i->form)
-	{
-	case DW_FORM_data1:
-	    {
-		uint8_t v;
-		if (!reader_.read_u8(v))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_uint32(v));
-		break;
-	    }
-	case DW_FORM_data2:
-	    {
-		uint16_t v;
-		if (!reader_.read_u16(v))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_uint32(v));
-		break;
-	    }
-	case DW_FORM_data4:
-	    {
-		uint32_t v;
-		if (!reader_.read_u32(v))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_uint32(v));
-		break;
-	    }
-	case DW_FORM_data8:
-	    {
-		uint64_t v;
-		if (!reader_.read_u64(v))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_uint64(v));
-		break;
-	    }
-	case DW_FORM_udata:
-	    {
-		uint32_t v;
-		if (!reader_.read_uleb128(v))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_uint32(v));
-		break;
-	    }
-	case DW_FORM_sdata:
-	    {
-		int32_t v;
-		if (!reader_.read_sleb128(v))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_sint32(v));
-		break;
-	    }
-	case DW_FORM_addr:
-	    {
-		if (sizeof(unsigned long) == 4)
-		{
-		    uint32_t v;
-		    if (!reader_.read_u32(v))
-			return RE_EOF;
-		    entry_.add_attribute(i->name, value_t::make_uint32(v));
-		}
-		else if (sizeof(unsigned long) == 8)
-		{
-		    uint64_t v;
-		    if (!reader_.read_u64(v))
-			return RE_EOF;
-		    entry_.add_attribute(i->name, value_t::make_uint64(v));
-		}
-		else
-		{
-		    fatal("Strange addrsize %u", (unsigned)sizeof(unsigned long));
-		}
-		break;
-	    }
-	case DW_FORM_flag:
-	    {
-		uint8_t v;
-		if (!reader_.read_u8(v))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_uint32(v));
-		break;
-	    }
-	case DW_FORM_ref1:
-	    {
-		uint8_t off;
-		if (!reader_.read_u8(off))
-		    return RE_EOF;
-		entry_.add_attribute(i->name,
-			value_t::make_ref(compile_unit_->make_reference(off)));
-		break;
-	    }
-	case DW_FORM_ref2:
-	    {
-		uint16_t off;
-		if (!reader_.read_u16(off))
-		    return RE_EOF;
-		entry_.add_attribute(i->name,
-			value_t::make_ref(compile_unit_->make_reference(off)));
-		break;
-	    }
-	case DW_FORM_ref4:
-	    {
-		uint32_t off;
-		if (!reader_.read_u32(off))
-		    return RE_EOF;
-		entry_.add_attribute(i->name,
-			value_t::make_ref(compile_unit_->make_reference(off)));
-		break;
-	    }
-	case DW_FORM_ref8:
-	    {
-		uint64_t off;
-		if (!reader_.read_u64(off))
-		    return RE_EOF;
-		// TODO: detect truncation
-		entry_.add_attribute(i->name,
-			value_t::make_ref(compile_unit_->make_reference(off)));
-		break;
-	    }
-	case DW_FORM_string:
-	    {
-		const char *v;
-		if (!reader_.read_string(v))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_string(v));
-		break;
-	    }
-	case DW_FORM_strp:
-	    {
-		uint32_t off;
-		if (!reader_.read_u32(off))
-		    return RE_EOF;
-		const char *v = compile_unit_->get_section(DW_sec_str)->offset_as_string(off);
-		if (!v)
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_string(v));
-		break;
-	    }
-	case DW_FORM_block1:
-	    {
-		uint8_t len;
-		const unsigned char *v;
-		if (!reader_.read_u8(len) ||
-		    !reader_.read_bytes(v, len))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_bytes(v, len));
-		break;
-	    }
-	case DW_FORM_block2:
-	    {
-		uint16_t len;
-		const unsigned char *v;
-		if (!reader_.read_u16(len) ||
-		    !reader_.read_bytes(v, len))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_bytes(v, len));
-		break;
-	    }
-	case DW_FORM_block4:
-	    {
-		uint32_t len;
-		const unsigned char *v;
-		if (!reader_.read_u32(len) ||
-		    !reader_.read_bytes(v, len))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_bytes(v, len));
-		break;
-	    }
-	case DW_FORM_block:
-	    {
-		uint32_t len;
-		const unsigned char *v;
-		if (!reader_.read_uleb128(len) ||
-		    !reader_.read_bytes(v, len))
-		    return RE_EOF;
-		entry_.add_attribute(i->name, value_t::make_bytes(v, len));
-		break;
-	    }
-	default:
-	    // TODO: bad DWARF info - throw an exception
-	    fatal("XXX can't handle %s\n",
-		  formvals.to_name(i->form));
-	}
+	entry_.set_position(i - a->specs_begin(), reader_.get_offset() - start);
+	if (!compile_unit_->skip_form(reader_, i->form))
+	    return RE_EOF;
     }
     return RE_OK;
 }
 
+/*
+ * Move past all the descendants of the entry just read, jumping
+ * straight to its DW_AT_sibling if it has one.  This clobbers the
+ * entry, and leaves level_ as if the entry had no children.
+ */
 int
-walker_t::skip_attributes()
+walker_t::skip_children()
 {
-    const abbrev_t *a = entry_.get_abbrev();
-    vector<abbrev_t::attr_spec_t>::const_iterator i;
-    for (i = a->attr_specs.begin() ; i != a->attr_specs.end() ; ++i)
+    const value_t *sib = entry_.get_attribute(DW_AT_sibling);
+    if (sib && sib->type == value_t::T_REF &&
+	sib->val.ref.cu == compile_unit_->get_index() &&
+	sib->val.ref.offset > reader_.get_offset())
+	return (reader_.seek(sib->val.ref.offset) ? RE_OK : RE_EOF);
+
+    for (;;)
     {
-	switch (i->form)
-	{
-	case DW_FORM_data1:
-	    if (!reader_.skip_u8())
-		return EOF;
-		break;
-	case DW_FORM_data2:
-	    if (!reader_.skip_u16())
-		return EOF;
-		break;
-	case DW_FORM_data4:
-	    if (!reader_.skip_u32())
-		return EOF;
-	    break;
-	case DW_FORM_data8:
-	    if (!reader_.skip_u64())
-		return EOF;
-	    break;
-	case DW_FORM_udata:
-	    if (!reader_.skip_uleb128())
-		return EOF;
-	    break;
-	case DW_FORM_sdata:
-	    if (!reader_.skip_sleb128())
-		return EOF;
-	    break;
-	case DW_FORM_addr:
-	    if (sizeof(unsigned long) == 4)
-	    {
-		if (!reader_.skip_u32())
-		    return EOF;
-	    }
-	    else if (sizeof(unsigned long) == 8)
-	    {
-		if (!reader_.skip_u64())
-		    return EOF;
-	    }
-	    else
-	    {
-		fatal("Strange addrsize %u", (unsigned)sizeof(unsigned long));
-	    }
-	    break;
-	case DW_FORM_flag:
-	    if (!reader_.skip_u8())
-		return EOF;
-	    break;
-	case DW_FORM_ref1:
-	    if (!reader_.skip_u8())
-		return EOF;
-	    break;
-	case DW_FORM_ref2:
-	    if (!reader_.skip_u16())
-		return EOF;
-	    break;
-	case DW_FORM_ref4:
-	    if (!reader_.skip_u32())
-		return EOF;
-	    break;
-	case DW_FORM_ref8:
-	    if (!reader_.skip_u64())
-		return EOF;
-	    break;
-	case DW_FORM_string:
-	    if (!reader_.skip_string())
-		return EOF;
-	    break;
-	case DW_FORM_strp:
-	    if (!reader_.skip_u32())
-		return EOF;
-	    break;
-	case DW_FORM_block1:
-	    {
-		uint8_t len;
-		if (!reader_.read_u8(len) ||
-		    !reader_.skip_bytes(len))
-		    return EOF;
-		break;
-	    }
-	case DW_FORM_block2:
-	    {
-		uint16_t len;
-		if (!reader_.read_u16(len) ||
-		    !reader_.skip_bytes(len))
-		    return EOF;
-		break;
-	    }
-	case DW_FORM_block4:
-	    {
-		uint32_t len;
-		if (!reader_.read_u32(len) ||
-		    !reader_.skip_bytes(len))
-		    return EOF;
-		break;
-	    }
-	case DW_FORM_block:
-	    {
-		uint32_t len;
-		if (!reader_.read_uleb128(len) ||
-		    !reader_.skip_bytes(len))
-		    return EOF;
-	    }
-	    break;
-	default:
-	    // TODO: bad DWARF info - throw an exception
-	    fatal("XXX can't handle %s\n",
-		  formvals.to_name(i->form));
-	}
+	size_t offset = reader_.get_offset();
+	uint32_t acode;
+	if (!reader_.read_uleb128(acode))
+	    return RE_EOF;
+	if (!acode)
+	    return RE_OK;	// end of the children
+
+	const abbrev_t *a = compile_unit_->get_abbrev(acode);
+	if (!a)
+	    fatal("XXX wtf - no abbrev for code 0x%x\n", acode);
+	entry_.setup(offset, level_, a, compile_unit_, reader_);
+	int r = skip_attributes();
+	if (r == RE_OK && a->children)
+	    r = skip_children();
+	if (r != RE_OK)
+	    return r;
     }
-    return RE_OK;
 }
 
+/*
+ * If we haven't yet gone down into the current entry's children,
+ * move past them without reading them.
+ */
+int
+walker_t::skip_unread_children()
+{
+    if (!entry_.get_abbrev() ||
+	!entry_.has_children() ||
+	level_ <= entry_.get_level())
+	return RE_OK;
+    int r = skip_children();
+    if (r == RE_OK)
+	level_--;
+    return r;
+}
 
 vector<reference_t>
 walker_t::get_path() const
@@ -464,7 +229,12 @@ walker_t::get_path() const
 const entry_t *
 walker_t::move_preorder()
 {
-    int r;
+    int r = 0;
+    if (!filter_tags_.empty() &&
+	entry_.get_abbrev() &&
+	!descend_tags_.contains(entry_.get_tag()) &&
+	skip_unread_children() == RE_EOF)
+	RETURN(0);
     do
     {
 	if ((r = read_entry()) == RE_EOF)
@@ -482,6 +252,8 @@ walker_t::move_next()
 
     unsigned target_level = entry_.get_level();
     int r = 0;
+    if (skip_unread_children() == RE_EOF)
+	RETURN(0);
     for (;;)
     {
 	if (level_ < target_level)
@@ -25,26 +25,56 @@ namespace np {
 namespace spiegel {
 namespace dwarf {
 
+// A set of DW_TAG_* values, for filtering walks.  Vendor
+// tags are too big to go in the set and are never in it.
+class tagset_t
+{
+public:
+    tagset_t() { memset(bits_, 0, sizeof(bits_)); }
+
+    tagset_t &add(uint32_t tag)
+    {
+	if (tag < MAX_TAG)
+	    bits_[tag/32] |= (1U<<(tag%32));
+	return *this;
+    }
+    bool contains(uint32_t tag) const
+    {
+	return (tag < MAX_TAG && (bits_[tag/32] & (1U<<(tag%32))));
+    }
+    bool empty() const
+    {
+	for (unsigned i = 0 ; i < MAX_TAG/32 ; i++)
+	    if (bits_[i])
+		return false;
+	return true;
+    }
+
+private:
+    enum { MAX_TAG = 128 };
+    uint32_t bits_[MAX_TAG/32];
+};
+
 class walker_t
 {
 public:
     walker_t(compile_unit_t *cu)
-     :  id_(next_id_++),
+     :  id_(__sync_fetch_and_add(&next_id_, 1)),
 	compile_unit_(cu),
 	reader_(cu->get_contents()),
-	level_(0),
-	filter_tag_(0)
+	level_(0)
     {
     }
 
     walker_t(const walker_t &o)
-     :  id_(next_id_++),
+     :  id_(__sync_fetch_and_add(&next_id_, 1)),
 	compile_unit_(o.compile_unit_),
 	reader_(o.reader_),
 	// Note: we don't clone the entry, on the assumption
 	// that it's about to be clobbered anyway
 	level_(o.level_),
-	filter_tag_(o.filter_tag_)
+	filter_tags_(o.filter_tags_),
+	descend_tags_(o.descend_tags_)
     {
 	// but we need the entry's level for the move
 	// operations to work correctly
@@ -52,13 +82,13 @@ public:
     }
 
     walker_t(reference_t ref)
-     :  id_(next_id_++),
-	filter_tag_(0)
+     :  id_(__sync_fetch_and_add(&next_id_, 1))
     {
 	seek(ref);
     }
 
     const entry_t *get_entry() const { return &entry_; }
+    const compile_unit_t *get_compile_unit() const { return compile_unit_; }
     reference_t get_reference() const
     {
 	return compile_unit_->make_reference(entry_.get_offset());
@@ -79,7 +109,15 @@ public:
     const entry_t *move_to(reference_t);
     const entry_t *move_up();
 
-    void set_filter_tag(unsigned tag) { filter_tag_ = tag; }
+    // Make move_preorder() return only entries with one of the
+    // tags in want.  The children of entries whose tags are not
+    // in descend are skipped without being read, so descend needs
+    // every tag whose subtree might hold a wanted entry.
+    void set_filter_tags(const tagset_t &want, const tagset_t &descend)
+    {
+	filter_tags_ = want;
+	descend_tags_ = descend;
+    }
 
 private:
     enum read_entry_results_t
@@ -92,10 +130,12 @@ private:
 
     void seek(reference_t ref);
     int read_entry();
-    int read_attributes();
     int skip_attributes();
+    int skip_children();
+    int skip_unread_children();
 
-    // for debugging only
+    // for debugging only; bumped atomically as discovery
+    // makes walkers on several threads
     static uint32_t next_id_;
     uint32_t id_;
 
@@ -103,7 +143,8 @@ private:
     reader_t reader_;
     entry_t entry_;
     unsigned level_;
-    unsigned filter_tag_;
+    tagset_t filter_tags_;
+    tagset_t descend_tags_;
 };
 
 
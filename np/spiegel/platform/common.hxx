@@ -24,6 +24,7 @@ namespace np { namespace spiegel { namespace platform {
 
 extern bool get_argv(int *argcp, char ***argvp);
 extern char *self_exe();
+extern std::string get_build_id(const char *filename);
 
 struct linkobj_t
 {
@@ -58,6 +59,20 @@ extern int uninstall_intercept(np::spiegel::addr_t,
 			     /*return*/std::string &err);
 
 extern std::vector<np::spiegel::addr_t> get_stacktrace();
+extern std::vector<np::spiegel::addr_t> get_stacktrace(np::spiegel::addr_t pc,
+						       unsigned long fp);
+extern unsigned int get_stacktrace(np::spiegel::addr_t pc,
+				   unsigned long fp,
+				   np::spiegel::addr_t *stack,
+				   unsigned int max);
+/* These take a ucontext_t from a SA_SIGINFO signal handler.  They
+ * are async-signal-safe, filling in the caller's buffers, and return
+ * how many frames or characters they used. */
+extern unsigned int get_stacktrace(const void *ucontext,
+				   np::spiegel::addr_t *stack,
+				   unsigned int max);
+extern unsigned int describe_registers(const void *ucontext,
+				       char *buf, unsigned int len);
 
 extern bool is_running_under_debugger();
 
@@ -27,6 +27,9 @@
 #include <sys/mman.h>
 #include <valgrind/valgrind.h>
 #include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <ctype.h>
 
 #ifndef MIN
@@ -328,6 +331,39 @@ out:
     }
 #endif
 
+/* deeper than this and the test has bigger problems */
+#define MAX_FRAMES  1024
+
+/* Doesn't allocate, so it's safe in a signal handler */
+static unsigned int
+walk_frame_pointers(unsigned long bp,
+		    np::spiegel::addr_t *stack,
+		    unsigned int max)
+{
+    unsigned int n = 0;
+    while (n < max)
+    {
+	stack[n++] = ((unsigned long *)bp)[1]-_NP_ADDRSIZE-1;
+	unsigned long nextbp = ((unsigned long *)bp)[0];
+	if (!nextbp)
+	    break;
+	if (nextbp < bp)
+	    break;	// moving in the wrong direction
+	if ((nextbp - bp) > 16384)
+	    break;	// moving a heuristic "too far"
+	bp = nextbp;
+    };
+    return n;
+}
+
+static void
+walk_frame_pointers(unsigned long bp, vector<np::spiegel::addr_t> &stack)
+{
+    np::spiegel::addr_t frames[MAX_FRAMES];
+    unsigned int n = walk_frame_pointers(bp, frames, MAX_FRAMES);
+    stack.insert(stack.end(), frames, frames+n);
+}
+
 vector<np::spiegel::addr_t> get_stacktrace()
 {
     /* This only works if a frame pointer is used, i.e. it breaks
@@ -349,21 +385,39 @@ vector<np::spiegel::addr_t> get_stacktrace()
 #else
     __asm__ volatile("movq %%rbp, %0" : "=r"(bp));
 #endif
-    for (;;)
-    {
-	stack.push_back(((unsigned long *)bp)[1]-_NP_ADDRSIZE-1);
-	unsigned long nextbp = ((unsigned long *)bp)[0];
-	if (!nextbp)
-	    break;
-	if (nextbp < bp)
-	    break;	// moving in the wrong direction
-	if ((nextbp - bp) > 16384)
-	    break;	// moving a heuristic "too far"
-	bp = nextbp;
-    };
+    walk_frame_pointers(bp, stack);
     return stack;
 }
 
+/* Stacktrace starting at an arbitrary instruction and frame
+ * pointer, e.g. from a signal context.  A zero frame pointer
+ * gives a stacktrace with just the instruction. */
+vector<np::spiegel::addr_t> get_stacktrace(np::spiegel::addr_t pc,
+					   unsigned long bp)
+{
+    vector<np::spiegel::addr_t> stack;
+
+    stack.push_back(pc);
+    if (bp)
+	walk_frame_pointers(bp, stack);
+    return stack;
+}
+
+/* The same, into the caller's array; returns how many it used */
+unsigned int get_stacktrace(np::spiegel::addr_t pc,
+			    unsigned long bp,
+			    np::spiegel::addr_t *stack,
+			    unsigned int max)
+{
+    unsigned int n = 0;
+
+    if (max)
+	stack[n++] = pc;
+    if (bp)
+	n += walk_frame_pointers(bp, stack+n, max-n);
+    return n;
+}
+
 /* Return the process id of any process which is ptrace()ing us, or 0 if
  * not being ptrace'd, or -1 on error. */
 static pid_t
@@ -507,6 +561,73 @@ vector<string> get_file_descriptors()
     return fds;
 }
 
+/* Returns the GNU build-id of the given ELF file as a hex
+ * string, or an empty string if it doesn't have one. */
+string get_build_id(const char *filename)
+{
+    int fd;
+    struct stat sb;
+    void *map;
+    string id;
+
+    fd = open(filename, O_RDONLY, 0);
+    if (fd < 0)
+	return id;
+    if (fstat(fd, &sb) < 0 || (size_t)sb.st_size < sizeof(ElfW(Ehdr)))
+    {
+	close(fd);
+	return id;
+    }
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+	return id;
+
+    const char *base = (const char *)map;
+    const char *end = base + sb.st_size;
+    const ElfW(Ehdr) *eh = (const ElfW(Ehdr) *)base;
+    if (memcmp(eh->e_ident, ELFMAG, SELFMAG) ||
+	eh->e_shentsize != sizeof(ElfW(Shdr)) ||
+	base + eh->e_shoff + eh->e_shnum * sizeof(ElfW(Shdr)) > end)
+	goto out;
+
+    for (unsigned int i = 0 ; i < eh->e_shnum && id == "" ; i++)
+    {
+	const ElfW(Shdr) *sh = (const ElfW(Shdr) *)(base + eh->e_shoff) + i;
+	if (sh->sh_type != SHT_NOTE)
+	    continue;
+	const char *p = base + sh->sh_offset;
+	const char *pend = p + sh->sh_size;
+	if (pend > end)
+	    continue;
+	while (p + sizeof(ElfW(Nhdr)) <= pend)
+	{
+	    const ElfW(Nhdr) *nh = (const ElfW(Nhdr) *)p;
+	    const char *name = p + sizeof(ElfW(Nhdr));
+	    const unsigned char *desc = (const unsigned char *)
+					name + ((nh->n_namesz + 3) & ~3);
+	    p = (const char *)desc + ((nh->n_descsz + 3) & ~3);
+	    if (p > pend)
+		break;
+	    if (nh->n_type == NT_GNU_BUILD_ID &&
+		nh->n_namesz == 4 && !memcmp(name, "GNU", 4))
+	    {
+		for (unsigned int j = 0 ; j < nh->n_descsz ; j++)
+		{
+		    char buf[3];
+		    snprintf(buf, sizeof(buf), "%02x", desc[j]);
+		    id += buf;
+		}
+		break;
+	    }
+	}
+    }
+
+out:
+    munmap(map, sb.st_size);
+    return id;
+}
+
 // close namespaces
 }; }; };
 
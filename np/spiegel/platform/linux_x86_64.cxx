@@ -73,6 +73,7 @@ static ucontext_t fpuc;
 static np::spiegel::platform::intstate_t *tramp_intstate;
 static bool hack1 = false;
 static bool using_int3 = false;
+static struct sigaction prev_act;
 
 static unsigned long
 intercept_tramp(void)
@@ -381,13 +382,71 @@ handle_signal(int sig, siginfo_t *si, void *vuc)
     return;
 
 wtf:
-    struct sigaction act;
-    memset(&act, 0, sizeof(act));
-    act.sa_handler = SIG_DFL;
-    sigaction(sig, &act, NULL);
+    /* Not one of ours: hand it on to whatever was handling the signal
+     * before we were installed, e.g. the runner's crash reporter.  A
+     * genuine fault will happen again when we return; a signal sent
+     * by a process needs to be re-raised. */
+    sigaction(sig, &prev_act, NULL);
+    if (si->si_code <= 0)
+	raise(sig);
 }
 
 
+unsigned int
+get_stacktrace(const void *vuc, np::spiegel::addr_t *stack, unsigned int max)
+{
+    const ucontext_t *uc = (const ucontext_t *)vuc;
+    unsigned long pc = uc->uc_mcontext.gregs[REG_RIP];
+    unsigned long sp = uc->uc_mcontext.gregs[REG_RSP];
+    unsigned long bp = uc->uc_mcontext.gregs[REG_RBP];
+
+    /* Only follow the frame pointer if it plausibly points into the
+     * stack, we're about to dereference it in a signal handler. */
+    if (bp < sp || bp - sp > 1024*1024 || (bp & 7))
+	bp = 0;
+    return get_stacktrace(pc, bp, stack, max);
+}
+
+unsigned int
+describe_registers(const void *vuc, char *buf, unsigned int len)
+{
+    static const struct
+    {
+	const char *name;
+	int reg;
+    } regs[] = {
+	{ "rip", REG_RIP },
+	{ "rsp", REG_RSP },
+	{ "rbp", REG_RBP },
+	{ "efl", REG_EFL },
+	{ "rax", REG_RAX },
+	{ "rbx", REG_RBX },
+	{ "rcx", REG_RCX },
+	{ "rdx", REG_RDX },
+	{ "rsi", REG_RSI },
+	{ "rdi", REG_RDI },
+	{ "r8", REG_R8 },
+	{ "r9", REG_R9 },
+	{ "r10", REG_R10 },
+	{ "r11", REG_R11 },
+	{ "r12", REG_R12 },
+	{ "r13", REG_R13 },
+	{ "r14", REG_R14 },
+	{ "r15", REG_R15 },
+    };
+    const ucontext_t *uc = (const ucontext_t *)vuc;
+    np::util::sigbuf_t s(buf, len);
+
+    for (unsigned int i = 0 ; i < sizeof(regs)/sizeof(regs[0]) ; i++)
+    {
+	s.str(i % 4 ? " " : (i ? "\n" : ""));
+	s.str(regs[i].name);
+	s.str("=");
+	s.hex((unsigned long)uc->uc_mcontext.gregs[regs[i].reg], 16);
+    }
+    return s.length();
+}
+
 int
 install_intercept(np::spiegel::addr_t addr, intstate_t &state, std::string &err)
 {
@@ -416,23 +475,27 @@ install_intercept(np::spiegel::addr_t addr, intstate_t &state, std::string &err)
 	return -1;
     }
 
-    static bool installed_sigaction = false;
-    if (!installed_sigaction)
+    if (RUNNING_ON_VALGRIND)
+	using_int3 = true;
+    int sig = (using_int3 ? SIGTRAP : SIGSEGV);
+    struct sigaction act;
+    sigaction(sig, NULL, &act);
+    if (!(act.sa_flags & SA_SIGINFO) || act.sa_sigaction != handle_signal)
     {
-	struct sigaction act;
+	/* Either we haven't installed the handler in this process yet,
+	 * or someone has installed theirs over the top of ours since.
+	 * Remember theirs so we can pass on signals that aren't ours. */
+	prev_act = act;
 	memset(&act, 0, sizeof(act));
 	act.sa_sigaction = handle_signal;
 	act.sa_flags |= SA_SIGINFO;
-	if (RUNNING_ON_VALGRIND)
-	    using_int3 = true;
-	sigaction((using_int3 ? SIGTRAP : SIGSEGV), &act, NULL);
+	r = sigaction(sig, &act, NULL);
 	if (r < 0)
 	{
 	    perror("np: sigaction");
 	    err = "cannot install signal handler";
 	    return -1;
 	}
-	installed_sigaction = true;
     }
 
     /* TODO: install the sig handler only when there are
@@ -19,6 +19,8 @@
 #include "np/spiegel/dwarf/entry.hxx"
 #include "np/spiegel/dwarf/enumerations.hxx"
 #include "np/spiegel/platform/common.hxx"
+#include "np/util/parallel.hxx"
+#include <set>
 
 namespace np {
 namespace spiegel {
@@ -362,6 +364,51 @@ get_compile_units()
     return res;
 }
 
+bool
+get_function_names(vector<string> &names)
+{
+    const np::spiegel::dwarf::state_t::function_index_t *index =
+	np::spiegel::dwarf::state_t::instance()->get_function_index();
+    if (!index)
+	return false;
+
+    np::spiegel::dwarf::state_t::function_index_t::const_iterator i;
+    for (i = index->begin() ; i != index->end() ; ++i)
+	names.push_back(i->first);
+    return true;
+}
+
+vector<compile_unit_t *>
+get_compile_units(const vector<string> &fnames)
+{
+    np::spiegel::dwarf::state_t *state = np::spiegel::dwarf::state_t::instance();
+    const np::spiegel::dwarf::state_t::function_index_t *index =
+	state->get_function_index();
+    if (!index)
+	return get_compile_units();
+
+    // a set, to keep the units in the same order as above
+    set<uint32_t> cus;
+    vector<string>::const_iterator n;
+    for (n = fnames.begin() ; n != fnames.end() ; ++n)
+    {
+	np::spiegel::dwarf::state_t::function_index_t::const_iterator i = index->find(*n);
+	if (i != index->end())
+	    cus.insert(i->second.begin(), i->second.end());
+    }
+
+    vector<np::spiegel::compile_unit_t *> res;
+    const vector<np::spiegel::dwarf::compile_unit_t*> &units = state->get_compile_units();
+    set<uint32_t>::const_iterator i;
+    for (i = cus.begin() ; i != cus.end() ; ++i)
+    {
+	compile_unit_t *cu = _cacher_t::make_compile_unit(units[*i]->make_root_reference());
+	if (cu)
+	    res.push_back(cu);
+    }
+    return res;
+}
+
 bool
 compile_unit_t::populate()
 {
@@ -409,6 +456,69 @@ compile_unit_t::get_functions()
     return res;
 }
 
+struct function_scan_t
+{
+    vector<np::spiegel::dwarf::reference_t> units_;
+    bool (*filter_)(const char *, void *);
+    void *closure_;
+    // the functions found, for each unit
+    vector<vector<np::spiegel::dwarf::reference_t> > found_;
+};
+
+/*
+ * Called on one of several threads to find the wanted functions
+ * in the i'th unit.  This only reads DWARF info; the function_t
+ * objects are made afterward, back on the calling thread.
+ */
+static void
+scan_functions(unsigned int i, void *closure)
+{
+    function_scan_t *scan = (function_scan_t *)closure;
+
+    // only the unit's top level functions, skipping everything else
+    np::spiegel::dwarf::walker_t w(scan->units_[i]);
+    np::spiegel::dwarf::tagset_t descend;
+    descend.add(DW_TAG_compile_unit).add(DW_TAG_partial_unit);
+    w.set_filter_tags(np::spiegel::dwarf::tagset_t().add(DW_TAG_subprogram),
+		      descend);
+
+    while (const np::spiegel::dwarf::entry_t *e = w.move_preorder())
+    {
+	const char *name = e->get_string_attribute(DW_AT_name);
+	if (!name || !e->get_attribute(DW_AT_low_pc))
+	    continue;
+	if (scan->filter_(name, scan->closure_))
+	    scan->found_[i].push_back(w.get_reference());
+    }
+}
+
+vector<function_t *>
+get_functions(const vector<compile_unit_t *> &units,
+	      bool (*filter)(const char *name, void *closure),
+	      void *closure)
+{
+    function_scan_t scan;
+    vector<compile_unit_t *>::const_iterator i;
+    for (i = units.begin() ; i != units.end() ; ++i)
+	scan.units_.push_back((*i)->ref_);
+    scan.filter_ = filter;
+    scan.closure_ = closure;
+    scan.found_.resize(units.size());
+
+    np::spiegel::dwarf::state_t::instance()->prepare_compile_units();
+    np::util::parallel_for(units.size(), scan_functions, &scan);
+
+    vector<function_t *> res;
+    vector<vector<np::spiegel::dwarf::reference_t> >::iterator j;
+    for (j = scan.found_.begin() ; j != scan.found_.end() ; ++j)
+    {
+	vector<np::spiegel::dwarf::reference_t>::iterator k;
+	for (k = j->begin() ; k != j->end() ; ++k)
+	    res.push_back(_cacher_t::make_function(*k));
+    }
+    return res;
+}
+
 const char *
 compile_unit_t::get_executable() const
 {
@@ -692,10 +802,14 @@ _cacher_t::make_function(np::spiegel::dwarf::reference_t ref)
 }
 
 std::string describe_stacktrace()
+{
+    return describe_stacktrace(np::spiegel::platform::get_stacktrace());
+}
+
+std::string describe_stacktrace(const vector<addr_t> &stack)
 {
     string s;
-    vector<addr_t> stack = np::spiegel::platform::get_stacktrace();
-    vector<addr_t>::iterator i;
+    vector<addr_t>::const_iterator i;
     bool first = true;
     bool done = false;
     for (i = stack.begin() ; !done && i != stack.end() ; ++i)
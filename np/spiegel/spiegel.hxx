@@ -68,6 +68,9 @@ public:
     _cacheable_t(np::spiegel::dwarf::reference_t ref) : ref_(ref) {}
     ~_cacheable_t() {}
 
+    // stable for as long as the program is unchanged
+    np::spiegel::dwarf::reference_t get_reference() const { return ref_; }
+
 protected:
     np::spiegel::dwarf::reference_t ref_;
 
@@ -102,9 +105,25 @@ private:
     friend class member_t;
     friend class np::spiegel::dwarf::state_t;
     friend class _cacher_t;
+    friend std::vector<function_t *> get_functions(
+		const std::vector<compile_unit_t *> &,
+		bool (*)(const char *, void *), void *);
 };
 
 std::vector<compile_unit_t *> get_compile_units();
+// Names of all the functions defined in the program, from the DWARF
+// name indexes; returns false if the program doesn't have them.
+bool get_function_names(std::vector<std::string> &names);
+// Just the compile units defining functions with any of the given
+// names, or all of them if the program doesn't have name indexes.
+std::vector<compile_unit_t *> get_compile_units(const std::vector<std::string> &fnames);
+// The functions defined in any of the units whose names pass the
+// filter, in the order get_functions() on each unit would give.
+// The units are walked on several threads, so the filter must
+// be safe to call on any of them.
+std::vector<function_t *> get_functions(const std::vector<compile_unit_t *> &units,
+					 bool (*filter)(const char *name, void *closure),
+					 void *closure);
 
 class type_t : public _cacheable_t
 {
@@ -344,6 +363,7 @@ private:
 };
 
 extern std::string describe_stacktrace();
+extern std::string describe_stacktrace(const std::vector<addr_t> &stack);
 
 // close the namespaces
 }; };
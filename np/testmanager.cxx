@@ -17,6 +17,7 @@
 #include "np/testmanager.hxx"
 #include "np/testnode.hxx"
 #include "np/classifier.hxx"
+#include "np/discovery_cache.hxx"
 #include "np/spiegel/spiegel.hxx"
 #include "np/spiegel/dwarf/state.hxx"
 
@@ -72,9 +73,9 @@ testmanager_t::instance()
 void
 testmanager_t::print_banner()
 {
-    printf("np: NovaProva Copyright (c) Gregory Banks\n");
-    printf("np: Built for O/S "_NP_OS" architecture "_NP_ARCH"\n");
-    fflush(stdout);
+    fprintf(stderr, "np: NovaProva Copyright (c) Gregory Banks\n");
+    fprintf(stderr, "np: Built for O/S "_NP_OS" architecture "_NP_ARCH"\n");
+    fflush(stderr);
 }
 
 functype_t
@@ -125,10 +126,12 @@ testmanager_t::setup_classifiers()
     add_classifier("^mock_(.*)", false, FT_MOCK);
     add_classifier("^[mM]ock([A-Z].*)", false, FT_MOCK);
     add_classifier("^__np_parameter_(.*)", false, FT_PARAM);
+    add_classifier("^__np_timeout_?(.*)", false, FT_TIMEOUT);
+    add_classifier("^__np_memory_?(.*)", false, FT_MEMORY);
 }
 
 static string
-test_name(np::spiegel::function_t *fn, char *submatch)
+test_name(np::spiegel::function_t *fn, const char *submatch)
 {
     string name = fn->get_compile_unit()->get_absolute_path();
 
@@ -149,7 +152,8 @@ test_name(np::spiegel::function_t *fn, char *submatch)
 np::spiegel::function_t *
 testmanager_t::find_mock_target(string name)
 {
-    vector<np::spiegel::compile_unit_t *> units = np::spiegel::get_compile_units();
+    vector<string> names(1, name);
+    vector<np::spiegel::compile_unit_t *> units = np::spiegel::get_compile_units(names);
     vector<np::spiegel::compile_unit_t *>::iterator i;
     for (i = units.begin() ; i != units.end() ; ++i)
     {
@@ -172,87 +176,252 @@ get_param_dec(np::spiegel::function_t *fn)
     return (const struct __np_param_dec *)ret.val.vpointer;
 }
 
+static int
+get_int_dec(np::spiegel::function_t *fn)
+{
+    vector<np::spiegel::value_t> args;
+    np::spiegel::value_t ret = fn->invoke(args);
+    return ret.val.vsint;
+}
+
+/* called on the discovery threads, but the classifiers don't change */
+bool
+testmanager_t::is_interesting(const char *func, void *closure)
+{
+    testmanager_t *tm = (testmanager_t *)closure;
+    return (tm->classify_function(func, 0, 0) != FT_UNKNOWN);
+}
+
+/*
+ * Walk the DWARF info to find the functions we want, adding them to
+ * the test tree and, if we have one, the discovery cache.
+ */
+void
+testmanager_t::find_functions(discovery_cache_t *cache)
+{
+    // If the program has name indexes, we need only walk the
+    // compile units defining functions we might be interested in
+    vector<np::spiegel::compile_unit_t *> units;
+    vector<string> names;
+    if (np::spiegel::get_function_names(names))
+    {
+	vector<string> wanted;
+	vector<string>::iterator n;
+	for (n = names.begin() ; n != names.end() ; ++n)
+	{
+	    if (classify_function(n->c_str(), 0, 0) != FT_UNKNOWN)
+		wanted.push_back(*n);
+	}
+	units = np::spiegel::get_compile_units(wanted);
+    }
+    else
+    {
+	units = np::spiegel::get_compile_units();
+    }
+    // Walking the units is the slow part, so that happens on several
+    // threads; the functions come back in unit order, so the tests
+    // are named and ordered just as if we'd walked them one by one.
+    vector<np::spiegel::function_t *> fns =
+	np::spiegel::get_functions(units, is_interesting, this);
+    vector<np::spiegel::function_t *>::iterator j;
+    for (j = fns.begin() ; j != fns.end() ; ++j)
+    {
+	np::spiegel::function_t *fn = *j;
+	np::spiegel::function_t *target = 0;
+	functype_t type;
+	char submatch[512];
+
+	// We want functions which are defined in this compile unit
+	if (!fn->get_address())
+	    continue;
+
+	type = classify_function(fn->get_name().c_str(),
+				 submatch, sizeof(submatch));
+	switch (type)
+	{
+	case FT_UNKNOWN:
+	    continue;
+	case FT_TEST:
+	    // Test functions need a node name
+	    if (!submatch[0])
+		continue;
+	    // Test function return void
+	    if (fn->get_return_type()->get_classification() != np::spiegel::type_t::TC_VOID)
+		continue;
+	    // Test functions take no arguments
+	    if (fn->get_parameter_types().size() != 0)
+		continue;
+	    break;
+	case FT_BEFORE:
+	case FT_AFTER:
+	    // Before/after functions go into the parent node
+	    assert(!submatch[0]);
+	    // Before/after functions return int
+	    if (fn->get_return_type()->get_classification() != np::spiegel::type_t::TC_SIGNED_INT)
+		continue;
+	    // Before/after take no arguments
+	    if (fn->get_parameter_types().size() != 0)
+		continue;
+	    break;
+	case FT_MOCK:
+	    // Mock functions need a target name
+	    if (!submatch[0])
+		continue;
+	    target = find_mock_target(submatch);
+	    if (!target)
+		continue;
+	    break;
+	case FT_PARAM:
+	    // Parameters need a name
+	    if (!submatch[0])
+		continue;
+	    break;
+	case FT_TIMEOUT:
+	case FT_MEMORY:
+	    break;
+	}
+
+	add_function(type, fn, submatch, target);
+	if (cache)
+	    cache->add_function(type, fn->get_reference(),
+				(target ? target->get_reference() :
+					  np::spiegel::dwarf::reference_t::null),
+				submatch);
+    }
+}
+
+/*
+ * Add the functions remembered in the discovery cache to the
+ * test tree, or return false if the cache can't be used.
+ */
+bool
+testmanager_t::load_functions(discovery_cache_t *cache)
+{
+    if (!cache->load())
+	return false;
+
+    // Check everything in the cache still makes sense
+    // before we start building the tree.
+    const vector<discovery_cache_t::function_t> &cached = cache->get_functions();
+    const vector<np::spiegel::dwarf::compile_unit_t*> &units =
+	spiegel_->get_compile_units();
+    vector<np::spiegel::function_t *> fns;
+    vector<np::spiegel::function_t *> targets;
+    vector<discovery_cache_t::function_t>::const_iterator i;
+    for (i = cached.begin() ; i != cached.end() ; ++i)
+    {
+	if (i->function_.cu >= units.size() ||
+	    (i->type_ == FT_MOCK && i->target_.cu >= units.size()))
+	    return false;
+	np::spiegel::function_t *fn = np::spiegel::_cacher_t::make_function(i->function_);
+	np::spiegel::function_t *target = 0;
+	if (i->type_ == FT_MOCK)
+	    target = np::spiegel::_cacher_t::make_function(i->target_);
+	if (!fn || (i->type_ == FT_MOCK && !target))
+	    return false;
+	fns.push_back(fn);
+	targets.push_back(target);
+    }
+
+    spiegel_->set_address_index(cache->get_ranges());
+    for (unsigned int j = 0 ; j < fns.size() ; j++)
+	add_function(cached[j].type_, fns[j], cached[j].submatch_.c_str(), targets[j]);
+    return true;
+}
+
+/*
+ * Add a function which discovery found to the test tree.
+ */
+void
+testmanager_t::add_function(functype_t type,
+			    np::spiegel::function_t *fn,
+			    const char *submatch,
+			    np::spiegel::function_t *target)
+{
+    switch (type)
+    {
+    case FT_UNKNOWN:
+	break;
+    case FT_TEST:
+    case FT_BEFORE:
+    case FT_AFTER:
+	root_->make_path(test_name(fn, submatch))->set_function(type, fn);
+	break;
+    case FT_MOCK:
+	root_->make_path(test_name(fn, 0))->add_mock(target, fn);
+	break;
+    case FT_PARAM:
+	{
+	    const struct __np_param_dec *dec = get_param_dec(fn);
+	    root_->make_path(test_name(fn, 0))->add_parameter(
+			    submatch, dec->var, dec->values);
+	}
+	break;
+    case FT_TIMEOUT:
+	{
+	    // Timeouts go into the file's node, or the named test's
+	    int secs = get_int_dec(fn);
+	    if (secs <= 0)
+	    {
+		fprintf(stderr, "np: WARNING: ignoring bad timeout %d "
+				"declared in %s\n", secs,
+				fn->get_compile_unit()->get_absolute_path().c_str());
+		break;
+	    }
+	    root_->make_path(test_name(fn, submatch))->set_timeout(secs);
+	}
+	break;
+    case FT_MEMORY:
+	{
+	    // Memory goes into the file's node, or the named test's
+	    int mb = get_int_dec(fn);
+	    if (mb <= 0)
+	    {
+		fprintf(stderr, "np: WARNING: ignoring bad memory %d "
+				"declared in %s\n", mb,
+				fn->get_compile_unit()->get_absolute_path().c_str());
+		break;
+	    }
+	    root_->make_path(test_name(fn, submatch))->set_memory(mb);
+	}
+	break;
+    }
+}
+
 void
 testmanager_t::discover_functions()
 {
+    PROFILE;
     if (!spiegel_)
     {
 	spiegel_ = new np::spiegel::dwarf::state_t();
 	spiegel_->add_self();
-	spiegel_->prepare_address_index();
 	root_ = new testnode_t(0);
     }
     // else: splice common_ and root_ back together
 
-    vector<np::spiegel::compile_unit_t *> units = np::spiegel::get_compile_units();
-    vector<np::spiegel::compile_unit_t *>::iterator i;
-    for (i = units.begin() ; i != units.end() ; ++i)
+    // Running an unchanged program again, we can skip walking
+    // its DWARF info by remembering what we found last time.
+    discovery_cache_t *cache = 0;
+    const char *env = getenv("NOVAPROVA_DISCOVERY_CACHE");
+    if (env && *env)
     {
-// fprintf(stderr, "discover_functions: compile unit %s\n", (*i)->get_absolute_path().c_str());
-	vector<np::spiegel::function_t *> fns = (*i)->get_functions();
-	vector<np::spiegel::function_t *>::iterator j;
-	for (j = fns.begin() ; j != fns.end() ; ++j)
-	{
-	    np::spiegel::function_t *fn = *j;
-	    functype_t type;
-	    char submatch[512];
-
-	    // We want functions which are defined in this compile unit
-	    if (!fn->get_address())
-		continue;
+	string identity = spiegel_->get_identity();
+	if (identity != "")
+	    cache = new discovery_cache_t(env, identity);
+    }
 
-	    type = classify_function(fn->get_name().c_str(),
-				     submatch, sizeof(submatch));
-	    switch (type)
-	    {
-	    case FT_UNKNOWN:
-		continue;
-	    case FT_TEST:
-		// Test functions need a node name
-		if (!submatch[0])
-		    continue;
-		// Test function return void
-		if (fn->get_return_type()->get_classification() != np::spiegel::type_t::TC_VOID)
-		    continue;
-		// Test functions take no arguments
-		if (fn->get_parameter_types().size() != 0)
-		    continue;
-		root_->make_path(test_name(fn, submatch))->set_function(type, fn);
-		break;
-	    case FT_BEFORE:
-	    case FT_AFTER:
-		// Before/after functions go into the parent node
-		assert(!submatch[0]);
-		// Before/after functions return int
-		if (fn->get_return_type()->get_classification() != np::spiegel::type_t::TC_SIGNED_INT)
-		    continue;
-		// Before/after take no arguments
-		if (fn->get_parameter_types().size() != 0)
-		    continue;
-		root_->make_path(test_name(fn, submatch))->set_function(type, fn);
-		break;
-	    case FT_MOCK:
-		// Mock functions need a target name
-		if (!submatch[0])
-		    continue;
-		{
-		    np::spiegel::function_t *target = find_mock_target(submatch);
-		    if (!target)
-			continue;
-		    root_->make_path(test_name(fn, 0))->add_mock(target, fn);
-		}
-		break;
-	    case FT_PARAM:
-		// Parameters need a name
-		if (!submatch[0])
-		    continue;
-		const struct __np_param_dec *dec = get_param_dec(fn);
-		root_->make_path(test_name(fn, 0))->add_parameter(
-				submatch, dec->var, dec->values);
-		break;
-	    }
+    if (!cache || !load_functions(cache))
+    {
+	spiegel_->prepare_address_index();
+	find_functions(cache);
+	if (cache)
+	{
+	    spiegel_->get_address_index(cache->get_ranges());
+	    cache->save();
 	}
     }
+    delete cache;
 
     // Calculate the effective root_ and common_
     common_ = root_;
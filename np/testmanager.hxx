@@ -27,6 +27,7 @@ namespace np { namespace spiegel { namespace dwarf { class state_t; } } }
 namespace np {
 
 class classifier_t;
+class discovery_cache_t;
 
 class testmanager_t : public np::util::zalloc
 {
@@ -50,9 +51,14 @@ private:
 
     void print_banner();
     functype_t classify_function(const char *func, char *match_return, size_t maxmatch);
+    static bool is_interesting(const char *func, void *closure);
     void add_classifier(const char *re, bool case_sensitive, functype_t type);
     void setup_classifiers();
     void discover_functions();
+    void find_functions(discovery_cache_t *cache);
+    bool load_functions(discovery_cache_t *cache);
+    void add_function(functype_t type, spiegel::function_t *fn,
+		      const char *submatch, spiegel::function_t *target);
     void setup_builtin_intercepts();
 
     static testmanager_t *instance_;
@@ -105,6 +105,30 @@ testnode_t::add_mock(np::spiegel::addr_t target, np::spiegel::addr_t mock)
     intercepts_.push_back(new redirect_t(target, 0, mock));
 }
 
+/* Returns the innermost declared timeout in seconds, or 0 */
+int
+testnode_t::get_timeout() const
+{
+    for (const testnode_t *a = this ; a ; a = a->parent_)
+    {
+	if (a->timeout_)
+	    return a->timeout_;
+    }
+    return 0;
+}
+
+/* Returns the innermost declared memory use in megabytes, or 0 */
+int
+testnode_t::get_memory() const
+{
+    for (const testnode_t *a = this ; a ; a = a->parent_)
+    {
+	if (a->memory_)
+	    return a->memory_;
+    }
+    return 0;
+}
+
 static void
 indent(int level)
 {
@@ -134,6 +158,17 @@ testnode_t::dump(int level) const
 	}
     }
 
+    if (timeout_)
+    {
+	indent(level);
+	fprintf(stderr, "  timeout=%d\n", timeout_);
+    }
+    if (memory_)
+    {
+	indent(level);
+	fprintf(stderr, "  memory=%d\n", memory_);
+    }
+
     for (testnode_t *child = children_ ; child ; child = child->next_)
 	child->dump(level+1);
 }
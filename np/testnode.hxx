@@ -37,6 +37,10 @@ public:
     void add_mock(np::spiegel::function_t *target, np::spiegel::function_t *mock);
     void add_mock(np::spiegel::addr_t target, const char *name, np::spiegel::addr_t mock);
     void add_mock(np::spiegel::addr_t target, np::spiegel::addr_t mock);
+    void set_timeout(int secs) { timeout_ = secs; }
+    int get_timeout() const;
+    void set_memory(int mb) { memory_ = mb; }
+    int get_memory() const;
 
     testnode_t *detach_common();
     np::spiegel::function_t *get_function(functype_t type) const
@@ -70,6 +74,8 @@ public:
 	void apply() const;
 	void unapply() const;
 	std::string as_string() const;
+	const char *get_name() const { return param_->name_; }
+	const char *get_value() const { return param_->values_[idx_]; }
 
     private:
 	const parameter_t *param_;
@@ -116,6 +122,8 @@ private:
     np::spiegel::function_t *funcs_[FT_NUM_SINGULAR];
     std::vector<np::spiegel::intercept_t*> intercepts_;
     std::vector<parameter_t*> parameters_;
+    int timeout_;	/* declared, in seconds, or 0 */
+    int memory_;	/* declared, in megabytes, or 0 */
 
     friend class preorder_iterator;
 };
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/trace_listener.hxx"
+#include "np/json_listener.hxx"
+#include "np/job.hxx"
+
+namespace np {
+using namespace std;
+using namespace np::util;
+
+static const char * const phase_names[job_t::PH_NUM] =
+{
+    "setup", "before", "test", "after", "check", "done"
+};
+
+trace_listener_t::trace_listener_t(const char *filename)
+ :  filename_(xstrdup(filename)),
+    fp_(0),
+    first_(true),
+    start_(0)
+{
+}
+
+trace_listener_t::~trace_listener_t()
+{
+    if (fp_)
+	fclose(fp_);
+    xfree(filename_);
+}
+
+void
+trace_listener_t::emit(const char *fmt, ...)
+{
+    va_list args;
+
+    if (!fp_)
+	return;
+    fputs(first_ ? "\n" : ",\n", fp_);
+    first_ = false;
+    va_start(args, fmt);
+    vfprintf(fp_, fmt, args);
+    va_end(args);
+    /* children get a copy of fp_, and must have nothing to write */
+    fflush(fp_);
+}
+
+/* Emit a complete ("X") event; times are in microseconds */
+void
+trace_listener_t::span(const char *cat, const string &name, unsigned int slot,
+		       int64_t start, int64_t end, const char *args)
+{
+    if (!start || end < start)
+	return;
+    emit("{\"ph\":\"X\",\"cat\":\"%s\",\"name\":%s,\"pid\":1,\"tid\":%u,"
+	 "\"ts\":%.3f,\"dur\":%.3f%s%s}",
+	 cat, json_string(name).c_str(), slot+1,
+	 (start - start_) / 1000.0, (end - start) / 1000.0,
+	 (args ? ",\"args\":" : ""), (args ? args : ""));
+}
+
+void
+trace_listener_t::begin()
+{
+    fp_ = fopen(filename_, "w");
+    if (!fp_)
+    {
+	perror(filename_);
+	return;
+    }
+    start_ = rel_now();
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", fp_);
+    emit("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,"
+	 "\"args\":{\"name\":\"novaprova\"}}");
+}
+
+void
+trace_listener_t::end()
+{
+    if (!fp_)
+	return;
+    fputs("\n]}\n", fp_);
+    if (fclose(fp_) < 0)
+	perror(filename_);
+    fp_ = 0;
+}
+
+void
+trace_listener_t::begin_job(const job_t *j)
+{
+    unsigned int slot;
+
+    for (slot = 0 ; slot < slots_.size() && slots_[slot] ; slot++)
+	;
+    if (slot == slots_.size())
+    {
+	slots_.push_back(0);
+	emit("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,"
+	     "\"args\":{\"name\":\"slot %u\"}}", slot+1, slot);
+    }
+    slots_[slot] = j;
+}
+
+void
+trace_listener_t::end_job(const job_t *j, result_t res)
+{
+    unsigned int slot;
+
+    for (slot = 0 ; slot < slots_.size() && slots_[slot] != j ; slot++)
+	;
+    if (slot == slots_.size())
+	return;
+    slots_[slot] = 0;
+
+    int64_t start = j->get_start();
+    int64_t end = start + j->get_elapsed();
+    char args[64];
+    snprintf(args, sizeof(args), "{\"result\":\"%s\"}", as_string(res));
+    span("job", j->as_string(), slot, start, end, args);
+
+    /* the child's phases, and the gaps at either end in the parent */
+    int64_t prev = start;
+    const char *prevname = "fork";
+    for (int ph = 0 ; ph < job_t::PH_NUM ; ph++)
+    {
+	int64_t t = j->get_phase_start((job_t::phase_t)ph);
+	if (!t)
+	    continue;
+	span("phase", prevname, slot, prev, t);
+	prev = t;
+	prevname = phase_names[ph];
+    }
+    if (prev != start)
+	span("phase", (prevname == phase_names[job_t::PH_DONE] ?
+		       "reap" : prevname), slot, prev, end);
+}
+
+void
+trace_listener_t::add_event(const job_t *, const event_t *)
+{
+}
+
+// close the namespace
+};
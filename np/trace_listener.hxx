@@ -0,0 +1,62 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_TRACE_LISTENER_H__
+#define __NP_TRACE_LISTENER_H__ 1
+
+#include "np/listener.hxx"
+#include <vector>
+
+namespace np {
+
+/*
+ * Writes a timeline of the run to a file in the Chrome trace event
+ * JSON format, which chrome://tracing and ui.perfetto.dev can show.
+ * Each job is a span on the track of the concurrency slot it ran in,
+ * from when the runner started it to when the runner reaped it, with
+ * nested spans for forking, each phase in the child, and reaping.
+ * Events are written as each job finishes, so a run which doesn't
+ * finish still leaves a trace which the viewers will load.
+ */
+class trace_listener_t : public listener_t
+{
+public:
+    trace_listener_t(const char *filename);
+    ~trace_listener_t();
+
+    void begin();
+    void end();
+    void begin_job(const job_t *);
+    void end_job(const job_t *, result_t);
+    void add_event(const job_t *, const event_t *ev);
+
+private:
+    void span(const char *cat, const std::string &name, unsigned int slot,
+	      int64_t start, int64_t end, const char *args = 0);
+    void emit(const char *fmt, ...)
+	__attribute__ (( format(printf, 2, 3) ));
+
+    char *filename_;
+    FILE *fp_;
+    bool first_;
+    int64_t start_;
+    /* the job running in each slot, or NULL */
+    std::vector<const job_t*> slots_;
+};
+
+// close the namespace
+};
+
+#endif /* __NP_TRACE_LISTENER_H__ */
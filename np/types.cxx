@@ -17,6 +17,19 @@
 
 namespace np {
 
+const char *
+as_string(result_t res)
+{
+    switch (res)
+    {
+    case R_UNKNOWN: return "UNKNOWN";
+    case R_PASS: return "PASS";
+    case R_NOTAPPLICABLE: return "N/A";
+    case R_FAIL: return "FAIL";
+    default: return "INTERNAL ERROR!";
+    }
+}
+
 const char *
 as_string(functype_t type)
 {
@@ -27,6 +40,9 @@ as_string(functype_t type)
     case FT_TEST: return "test";
     case FT_AFTER: return "after";
     case FT_MOCK: return "mock";
+    case FT_PARAM: return "param";
+    case FT_TIMEOUT: return "timeout";
+    case FT_MEMORY: return "memory";
     default: return "INTERNAL ERROR!";
     }
 }
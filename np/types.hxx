@@ -42,9 +42,12 @@ enum functype_t
 #define FT_NUM_SINGULAR	(FT_AFTER+1)
     FT_MOCK,
     FT_PARAM,
-#define FT_NUM		(FT_PARAM+1)
+    FT_TIMEOUT,
+    FT_MEMORY,
+#define FT_NUM		(FT_MEMORY+1)
 };
 
+extern const char *as_string(result_t);
 extern const char *as_string(functype_t);
 
 // close the namespace
@@ -132,6 +132,57 @@ string dec(unsigned int x)
     return string(buf);
 }
 
+sigbuf_t &
+sigbuf_t::str(const char *s)
+{
+    while (s && *s)
+	put(*s++);
+    return *this;
+}
+
+sigbuf_t &
+sigbuf_t::hex(unsigned long x, unsigned int width)
+{
+    char digits[2*sizeof(x)];
+    unsigned int n = 0;
+
+    do
+    {
+	digits[n++] = "0123456789abcdef"[x & 0xf];
+	x >>= 4;
+    } while (x);
+    while (n < width && n < sizeof(digits))
+	digits[n++] = '0';
+
+    put('0');
+    put('x');
+    while (n)
+	put(digits[--n]);
+    return *this;
+}
+
+sigbuf_t &
+sigbuf_t::dec(long x)
+{
+    char digits[24];
+    unsigned int n = 0;
+    unsigned long u = x;
+
+    if (x < 0)
+    {
+	put('-');
+	u = -(unsigned long)x;
+    }
+    do
+    {
+	digits[n++] = '0' + (u % 10);
+	u /= 10;
+    } while (u);
+    while (n)
+	put(digits[--n]);
+    return *this;
+}
+
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 static int64_t posix_now(int clock)
@@ -98,6 +98,44 @@ extern std::string hex(unsigned long x);
 extern std::string HEX(unsigned long x);
 extern std::string dec(unsigned int x);
 
+/*
+ * Builds a string in a fixed size buffer without calling anything
+ * which isn't async-signal-safe, for use in signal handlers where
+ * snprintf() or malloc() might deadlock.  Anything which doesn't fit
+ * is dropped.
+ */
+class sigbuf_t
+{
+public:
+    sigbuf_t(char *buf, size_t len)
+     :  buf_(buf), len_(len), n_(0)
+    {
+	buf_[0] = '\0';
+    }
+
+    sigbuf_t &str(const char *s);
+    /* like "0x%lx", zero padded to width digits */
+    sigbuf_t &hex(unsigned long x, unsigned int width = 0);
+    sigbuf_t &dec(long x);
+
+    const char *c_str() const { return buf_; }
+    size_t length() const { return n_; }
+
+private:
+    void put(char c)
+    {
+	if (n_+1 < len_)
+	{
+	    buf_[n_++] = c;
+	    buf_[n_] = '\0';
+	}
+    }
+
+    char *buf_;
+    size_t len_;
+    size_t n_;
+};
+
 #define NANOSEC_PER_SEC	    (1000000000LL)
 extern int64_t rel_now();
 extern int64_t abs_now();
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/util/parallel.hxx"
+#include <pthread.h>
+
+namespace np { namespace util {
+
+/* more than this and the threads just fight over the memory bus */
+enum { MAX_THREADS = 64 };
+
+struct parallel_job_t
+{
+    unsigned int n_;
+    unsigned int next_;	    /* the next i to be claimed */
+    void (*fn_)(unsigned int, void *);
+    void *closure_;
+};
+
+static void *
+parallel_worker(void *arg)
+{
+    parallel_job_t *job = (parallel_job_t *)arg;
+    unsigned int i;
+
+    while ((i = __sync_fetch_and_add(&job->next_, 1)) < job->n_)
+	job->fn_(i, job->closure_);
+    return 0;
+}
+
+unsigned int
+parallel_threads()
+{
+    static unsigned int nthreads;
+
+    if (!nthreads)
+    {
+	long n;
+	const char *e = getenv("NOVAPROVA_THREADS");
+	if (e)
+	    n = strtol(e, 0, 0);
+	else
+	    n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+	    n = 1;
+	if (n > MAX_THREADS)
+	    n = MAX_THREADS;
+	nthreads = n;
+    }
+    return nthreads;
+}
+
+void
+parallel_for(unsigned int n,
+	     void (*fn)(unsigned int i, void *closure),
+	     void *closure)
+{
+    parallel_job_t job;
+    job.n_ = n;
+    job.next_ = 0;
+    job.fn_ = fn;
+    job.closure_ = closure;
+
+    pthread_t threads[MAX_THREADS];
+    unsigned int nthreads = 0;
+    unsigned int want = parallel_threads();
+    if (want > n)
+	want = n;
+    /* the caller's thread is one of them */
+    while (nthreads+1 < want)
+    {
+	/* if we can't have another thread, the
+	 * ones we have will do its share */
+	if (pthread_create(&threads[nthreads], 0, parallel_worker, &job))
+	    break;
+	nthreads++;
+    }
+
+    parallel_worker(&job);
+
+    while (nthreads > 0)
+	pthread_join(threads[--nthreads], 0);
+}
+
+// close the namespaces
+}; };
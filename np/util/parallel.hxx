@@ -0,0 +1,42 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __NP_PARALLEL_H__
+#define __NP_PARALLEL_H__ 1
+
+#include "np/util/common.hxx"
+
+namespace np { namespace util {
+
+/*
+ * Calls fn(i, closure) once for each i in [0,n), spread over up
+ * to parallel_threads() threads including the caller's, and
+ * returns when all the calls have.  The calls happen in no
+ * particular order, so each should only write state belonging
+ * to its own i; the caller can then combine the results in
+ * order.  Only for use before any children are forked.
+ */
+extern void parallel_for(unsigned int n,
+			 void (*fn)(unsigned int i, void *closure),
+			 void *closure);
+
+/* One per online CPU, or the NOVAPROVA_THREADS environment
+ * variable if set; 1 means do everything on the caller's thread */
+extern unsigned int parallel_threads();
+
+// close the namespaces
+}; };
+
+#endif /* __NP_PARALLEL_H__ */
@@ -16,47 +16,118 @@
 #include "np/util/common.hxx"
 #include "np/util/profile.hxx"
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/uio.h>
 
 namespace np {
 namespace profile {
 
-int probe_t::depth_ = 0;
-int probe_t::log_fd_ = -2;
+bool probe_t::enabled_ = false;
+static int log_fd = -1;
+static record_t *records;
+static unsigned int nrecords;
+static std::vector<site_t *> sites;
+static pthread_t owner;		/* the only thread which may record */
 
-probe_t::probe_t(const char *function)
- :  function_(function)
+static void
+flush_at_exit()
 {
-    log("begin");
-    depth_++;
+    probe_t::flush();
 }
 
-probe_t::~probe_t()
+/* profiling is enabled from the environment before main() runs */
+static struct init_t
 {
-    depth_--;
-    log("end");
+    init_t()
+    {
+	const char *filename = getenv("NOVAPROVA_PROFILE");
+	if (filename && *filename)
+	    probe_t::enable(filename);
+    }
+} init;
+
+bool
+probe_t::enable(const char *filename)
+{
+    if (enabled_)
+	return true;
+
+    log_fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC|O_APPEND, 0666);
+    if (log_fd < 0)
+    {
+	fprintf(stderr, "Cannot open %s for writing: %s\n",
+		filename, strerror(errno));
+	return false;
+    }
+    fcntl(log_fd, F_SETFD, FD_CLOEXEC);
+    records = (record_t *)np::util::xmalloc(BUFFER_SIZE * sizeof(record_t));
+    nrecords = 0;
+    owner = pthread_self();
+    /* our exit() skips atexit handlers and calls flush() itself */
+    atexit(flush_at_exit);
+    pthread_atfork(NULL, NULL, reset_after_fork);
+    enabled_ = true;
+    return true;
 }
 
-void probe_t::log(const char *which)
+/* a forked child starts with an empty buffer; the
+ * parent will flush the records it inherited */
+void
+probe_t::reset_after_fork()
 {
-    if (log_fd_ == -2)
+    nrecords = 0;
+}
+
+void
+probe_t::record(site_t *site, uint32_t which)
+{
+    assert(pthread_equal(pthread_self(), owner));
+    if (!site->id_)
     {
-	static const char filename[] = "novaprova.profile.dat";
-	log_fd_ = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0666);
-	if (log_fd_ < 0)
-	{
-	    fprintf(stderr, "Cannot open %s for writing: %s\n",
-		    filename, strerror(errno));
-	}
+	sites.push_back(site);
+	site->id_ = sites.size();
     }
+    record_t *r = &records[nrecords];
+    r->time_ = np::util::rel_now();
+    r->site_ = site->id_;
+    r->which_ = which;
+    if (++nrecords == BUFFER_SIZE)
+	flush();
+}
 
-    if (log_fd_ >= 0)
+void
+probe_t::flush()
+{
+    if (!nrecords || log_fd < 0)
+	return;
+
+    std::string names;
+    std::vector<site_t *>::const_iterator itr;
+    for (itr = sites.begin() ; itr != sites.end() ; ++itr)
     {
-	char line[512];
-	snprintf(line, sizeof(line), "%lld %d %d %s %s\n",
-		(long long)np::util::rel_time(),
-		(int)getpid(), depth_, which, function_);
-	write(log_fd_, line, strlen(line));
+	uint32_t len = (strlen((*itr)->function_) + 4) & ~3;
+	names.append((const char *)&len, sizeof(len));
+	names.append((*itr)->function_);
+	names.append(len - strlen((*itr)->function_), '\0');
     }
+
+    chunk_t chunk;
+    chunk.magic_ = MAGIC;
+    chunk.pid_ = getpid();
+    chunk.nsites_ = sites.size();
+    chunk.nrecords_ = nrecords;
+
+    /* a single write, so chunks from different processes
+     * appending to the file at once don't get mixed up */
+    struct iovec iov[3];
+    iov[0].iov_base = &chunk;
+    iov[0].iov_len = sizeof(chunk);
+    iov[1].iov_base = (void *)names.data();
+    iov[1].iov_len = names.size();
+    iov[2].iov_base = records;
+    iov[2].iov_len = nrecords * sizeof(record_t);
+    writev(log_fd, iov, 3);
+    nrecords = 0;
 }
 
 // close the namespaces
@@ -16,28 +16,88 @@
 #ifndef __NP_PROFILE_H__
 #define __NP_PROFILE_H__ 1
 
+#include <stdint.h>
+
 namespace np {
 namespace profile {
 
+/*
+ * Low overhead profiling probes.  Put PROFILE at the start of a
+ * function and, when the NOVAPROVA_PROFILE environment variable names
+ * a file, each call records its begin and end as fixed-size binary
+ * records in a per-process buffer.  The buffer is appended to the file
+ * in a single chunk when it fills and when the process exits, so the
+ * records from the runner and each child stay together.  When the
+ * variable isn't set the cost of a probe is a test and a branch.
+ *
+ * The buffer isn't locked and the file format has no notion of
+ * threads, so probes may only be used in code which runs on the
+ * thread which enabled profiling, i.e. not in the functions passed
+ * to parallel_for().
+ *
+ * The npprofile tool converts the file to Chrome trace event format.
+ */
+
+/* one per probe site, statically initialised */
+struct site_t
+{
+    const char *function_;
+    uint32_t id_;	/* 0 until the site first records */
+};
+
+/* the file is a sequence of chunks, each of which is a chunk_t,
+ * nsites_ site names each a uint32 length (a multiple of 4, including
+ * at least one NUL) and the name, then nrecords_ record_t */
+struct chunk_t
+{
+    uint32_t magic_;
+    uint32_t pid_;
+    uint32_t nsites_;
+    uint32_t nrecords_;
+};
+
+struct record_t
+{
+    int64_t time_;	/* rel_now() in nanoseconds */
+    uint32_t site_;	/* 1-based index into the chunk's names */
+    uint32_t which_;
+};
+
+enum { MAGIC = 0x4650504e /* "NPPF" */ };
+enum { BEGIN = 0, END = 1 };
+
 class probe_t
 {
 public:
-    probe_t(const char *function);
-    ~probe_t();
+    probe_t(site_t *site)
+     :  site_(site)
+    {
+	if (enabled_)
+	    record(site_, BEGIN);
+    }
+    ~probe_t()
+    {
+	if (enabled_)
+	    record(site_, END);
+    }
+
+    static bool enable(const char *filename);
+    static void flush();
+
+    /* records in the buffer before it's flushed */
+    enum { BUFFER_SIZE = 16384 };
 
 private:
-    void log(const char *which);
+    static void record(site_t *site, uint32_t which);
+    static void reset_after_fork();
 
-    const char *function_;
-    static int depth_;
-    static int log_fd_;
+    site_t *site_;
+    static bool enabled_;
 };
 
-#if 1
-#define PROFILE
-#else
-#define PROFILE np::profile::probe_t __np_profile_probe(__FUNCTION__);
-#endif
+#define PROFILE \
+    static np::profile::site_t __np_profile_site = { __FUNCTION__, 0 }; \
+    np::profile::probe_t __np_profile_probe(&__np_profile_site)
 
 // close the namespace
 }; };
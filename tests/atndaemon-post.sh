@@ -0,0 +1,35 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+# Run the tests again through a daemon; the output should be just
+# the same as running them directly
+TEST="$1"
+sock=$TEST.sock
+rm -f $sock $TEST.ppid
+./$TEST --daemon $sock 2>/dev/null &
+daemon=$!
+n=0
+while [ ! -S $sock -a $n -lt 100 ] ; do
+    sleep 0.1
+    n=$((n+1))
+done
+./$TEST --connect $sock
+echo "EXIT $?"
+[ "$(cat $TEST.ppid 2>/dev/null)" = "$daemon" ] && echo "MSG the daemon ran the tests"
+kill $daemon
+wait $daemon 2>/dev/null
+rm -f $sock $TEST.ppid
@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+# Run the test a few more times with a discovery cache, and say
+# what happened to the cache file and whether the results changed
+# from the run without one.
+TEST="$1"
+CACHE=$TEST.cache
+rm -rf $CACHE
+
+NOVAPROVA_DISCOVERY_CACHE= ./$TEST 2>&1 | egrep '^(MSG|PASS|FAIL) ' > $TEST.nocache
+
+function cachefile()
+{
+    ls $CACHE/*.npdc 2>/dev/null
+}
+
+function run()
+{
+    local what="$1"
+    local before=$(stat -c %i $(cachefile) 2>/dev/null)
+    NOVAPROVA_DISCOVERY_CACHE=$CACHE ./$TEST > $TEST.cached 2>&1
+    local after=$(stat -c %i $(cachefile) 2>/dev/null)
+
+    if [ -z "$after" ] ; then
+	echo "MSG $what: no cache file"
+    elif [ -z "$before" ] ; then
+	echo "MSG $what: cache written"
+    elif [ "$before" = "$after" ] ; then
+	echo "MSG $what: cache used"
+    else
+	echo "MSG $what: cache rewritten"
+    fi
+    grep -q 'ignoring bad discovery cache' $TEST.cached && \
+	echo "MSG $what: bad cache reported"
+    egrep '^(MSG|PASS|FAIL) ' $TEST.cached | cmp -s - $TEST.nocache || \
+	echo "FAIL $what: results differ"
+}
+
+run "first run"
+run "second run"
+
+# a file cut short, though still for this program
+truncate -s -1 $(cachefile)
+run "truncated"
+
+# a file for another program which hashed to the same name,
+# made by changing the first byte of the identity after the header
+printf '#' | dd of=$(cachefile) bs=1 seek=24 conv=notrunc 2>/dev/null
+run "other identity"
+run "after that"
+
+rm -rf $CACHE $TEST.nocache $TEST.cached
@@ -0,0 +1,40 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+# Summarise the compacted history file, a line per job, with
+# the range of elapsed times kept for the job from the pre script
+TEST="$1"
+awk -v pwd="$PWD" '
+    /^#/ { next }
+    /^@ / { exe = $2; sub(pwd, "%PWD%", exe); next }
+    {
+	job = exe " " $1;
+	if (!(job in n) || $2 < lo[job]) lo[job] = $2;
+	if (!(job in n) || $2 > hi[job]) hi[job] = $2;
+	n[job]++;
+    }
+    END {
+	for (job in n)
+	{
+	    if (job ~ /\.old$/)
+		printf "MSG %s %d samples %d..%d\n", job, n[job], lo[job], hi[job];
+	    else
+		printf "MSG %s %d samples\n", job, n[job];
+	}
+    }
+' $TEST.hist | sort
+rm -f $TEST.hist
@@ -0,0 +1,30 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+# Make a history file with two sections, one for this executable
+# with 100 samples of a job, more than enough to be compacted.
+TEST="$1"
+rm -f $TEST.hist $TEST.hist.tmp
+(
+    echo "# novaprova job history: name elapsed_ns peak_rss_kb result"
+    echo "@ /other/exe"
+    echo "other.before 5 0 PASS"
+    echo "@ $PWD/$TEST"
+    for i in $(seq 1 100) ; do
+	echo "$TEST.old $i 0 PASS"
+    done
+) > $TEST.hist
@@ -0,0 +1,27 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+# Report what became of the awkward characters in the captured output
+TEST="$1"
+perl -0777 -ne '
+    my $n = () = m/\xe2\x82\xac/g;
+    print "MSG $n euros\n";
+    while (m/(before.*after)/g)
+    {
+	(my $s = $1) =~ s/\xef\xbf\xbd/?/g;
+	print "MSG $s\n";
+    }
+' reports/TEST-$TEST.xml
@@ -0,0 +1,23 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+# Run the test again with a spec for each of two of its tests, using
+# the names the run without specs gave them.
+TEST="$1"
+first=$(./$TEST 2>&1 | sed -n -e 's/^PASS \(.*\.albatross\)$/\1/p')
+./$TEST $first ${first%albatross}condor
+echo "EXIT $?"
@@ -0,0 +1,29 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+# Report what was logged, leaving out the times and paths
+TEST="$1"
+../tools/npresults $TEST.nprl runs | awk '{print "MSG", $1, $3, $4}'
+../tools/npresults $TEST.nprl failures | sed -e 's/^ */MSG /' -e 's/  */ /g'
+
+# Runs logging to the same file at once should each get a run of
+# their own, with all of their jobs
+for i in 1 2 3 4 ; do
+    ./$TEST -B $TEST.nprl > /dev/null 2>&1 &
+done
+wait
+../tools/npresults $TEST.nprl runs | awk 'NR > 3 {print "MSG", $1, $3, $4}'
+rm -f $TEST.nprl
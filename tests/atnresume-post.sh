@@ -0,0 +1,24 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+# A journal which has lost its header isn't resumed from, so
+# test_first runs again
+TEST="$1"
+sed -i -e '/^#/d' $TEST.jnl
+./$TEST -J $TEST.jnl -R
+echo "EXIT $?"
+rm -rf $TEST.jnl $TEST.jnl.d
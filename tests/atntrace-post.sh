@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+# Summarise the spans in the trace, leaving out the times
+TEST="$1"
+perl -MJSON::PP -e '
+    local $/;
+    my $trace = decode_json(<STDIN>);
+    foreach my $ev (@{$trace->{traceEvents}})
+    {
+	next unless $ev->{ph} eq "X";
+	if ($ev->{cat} eq "job")
+	{
+	    print "\n" if defined $phases;
+	    print "MSG $ev->{name} $ev->{args}->{result} slot $ev->{tid}";
+	    $phases = 1;
+	}
+	else
+	{
+	    print " $ev->{name}";
+	}
+    }
+    print "\n";
+' < $TEST.json
+rm -f $TEST.json
@@ -33,3 +33,6 @@ int main(int argc, char **argv)
 {
     return 0;
 }
+
+/* defined so that it's described whatever the DWARF version */
+coffee *coffee::milkshk = 0;
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/spiegel/spiegel.hxx"
+#include "np/spiegel/dwarf/state.hxx"
+#include "np/spiegel/dwarf/compile_unit.hxx"
+#include "np/spiegel/dwarf/walker.hxx"
+#include <sys/stat.h>
+
+using namespace std;
+using namespace np::util;
+using namespace np::spiegel::dwarf;
+
+/*
+ * Builds a DWARF5 .debug_names section for an executable, for the
+ * tests of the reader, as no toolchain we build with makes one.
+ * The names are appended to a copy of the executable's .debug_str,
+ * and the caller puts both sections back with objcopy.  Variables
+ * are indexed too, as they should be ignored.
+ *
+ * Usage: mkdebugnames executable debug_str debug_names
+ */
+
+struct index_entry_t
+{
+    index_entry_t(uint32_t a, uint32_t cu, uint32_t off)
+     :  abbrev_(a), cu_(cu), die_offset_(off) {}
+    uint32_t abbrev_;
+    uint32_t cu_;
+    uint32_t die_offset_;
+};
+
+enum { ABBREV_FUNCTION = 1, ABBREV_VARIABLE = 2 };
+
+static void
+put_u16(string &s, uint16_t v)
+{
+    s.append((const char *)&v, sizeof(v));
+}
+
+static void
+put_u32(string &s, uint32_t v)
+{
+    s.append((const char *)&v, sizeof(v));
+}
+
+static void
+put_uleb128(string &s, uint32_t v)
+{
+    do
+    {
+	unsigned char b = v & 0x7f;
+	v >>= 7;
+	s += (char)(b | (v ? 0x80 : 0));
+    }
+    while (v);
+}
+
+static void
+put_abbrev(string &s, uint32_t code, uint32_t tag)
+{
+    put_uleb128(s, code);
+    put_uleb128(s, tag);
+    put_uleb128(s, DW_IDX_compile_unit);
+    put_uleb128(s, DW_FORM_udata);
+    put_uleb128(s, DW_IDX_die_offset);
+    put_uleb128(s, DW_FORM_ref4);
+    put_uleb128(s, 0);
+    put_uleb128(s, 0);
+}
+
+int
+main(int argc, char **argv)
+{
+    argv0 = argv[0];
+    if (argc != 4)
+	fatal("Usage: %s executable debug_str debug_names\n", argv0);
+
+    state_t state;
+    if (!state.add_executable(argv[1]))
+	return 1;
+
+    map<string, vector<index_entry_t> > names;
+    const vector<compile_unit_t *> &units = state.get_compile_units();
+    for (uint32_t i = 0 ; i < units.size() ; i++)
+    {
+	walker_t w(units[i]);
+	while (const entry_t *e = w.move_preorder())
+	{
+	    const char *name = e->get_string_attribute(DW_AT_name);
+	    if (!name)
+		continue;
+	    uint32_t die_offset = e->get_offset() - units[i]->get_offset();
+	    if (e->get_tag() == DW_TAG_subprogram &&
+		e->get_attribute(DW_AT_low_pc))
+		names[name].push_back(index_entry_t(ABBREV_FUNCTION, i, die_offset));
+	    else if (e->get_tag() == DW_TAG_variable &&
+		     e->get_attribute(DW_AT_location))
+		names[name].push_back(index_entry_t(ABBREV_VARIABLE, i, die_offset));
+	}
+    }
+
+    struct stat sb;
+    if (stat(argv[2], &sb) < 0)
+	fatal("%s: %s\n", argv[2], strerror(errno));
+    FILE *strfp = fopen(argv[2], "a");
+    if (!strfp)
+	fatal("%s: %s\n", argv[2], strerror(errno));
+
+    string stroffs;
+    string entryoffs;
+    string pool;
+    map<string, vector<index_entry_t> >::iterator n;
+    uint32_t stroff = sb.st_size;
+    for (n = names.begin() ; n != names.end() ; ++n)
+    {
+	fwrite(n->first.c_str(), 1, n->first.length()+1, strfp);
+	put_u32(stroffs, stroff);
+	stroff += n->first.length()+1;
+
+	put_u32(entryoffs, pool.length());
+	vector<index_entry_t>::iterator e;
+	for (e = n->second.begin() ; e != n->second.end() ; ++e)
+	{
+	    put_uleb128(pool, e->abbrev_);
+	    put_uleb128(pool, e->cu_);
+	    put_u32(pool, e->die_offset_);
+	}
+	put_uleb128(pool, 0);
+    }
+    if (fclose(strfp) < 0)
+	fatal("%s: %s\n", argv[2], strerror(errno));
+
+    string abbrevs;
+    put_abbrev(abbrevs, ABBREV_FUNCTION, DW_TAG_subprogram);
+    put_abbrev(abbrevs, ABBREV_VARIABLE, DW_TAG_variable);
+    put_uleb128(abbrevs, 0);
+
+    /* no hash table, which is allowed */
+    string unit;
+    put_u16(unit, 5);		    /* version */
+    put_u16(unit, 0);		    /* padding */
+    put_u32(unit, units.size());    /* comp_unit_count */
+    put_u32(unit, 0);		    /* local_type_unit_count */
+    put_u32(unit, 0);		    /* foreign_type_unit_count */
+    put_u32(unit, 0);		    /* bucket_count */
+    put_u32(unit, names.size());    /* name_count */
+    put_u32(unit, abbrevs.length());
+    put_u32(unit, 0);		    /* augmentation_string_size */
+    for (uint32_t i = 0 ; i < units.size() ; i++)
+	put_u32(unit, units[i]->get_offset());
+    unit += stroffs;
+    unit += entryoffs;
+    unit += abbrevs;
+    unit += pool;
+
+    string section;
+    put_u32(section, unit.length());
+    section += unit;
+
+    FILE *fp = fopen(argv[3], "w");
+    if (!fp)
+	fatal("%s: %s\n", argv[3], strerror(errno));
+    fwrite(section.c_str(), 1, section.length(), fp);
+    if (fclose(fp) < 0)
+	fatal("%s: %s\n", argv[3], strerror(errno));
+    return 0;
+}
@@ -69,6 +69,7 @@ function normalize
 	    sed -r \
 		-e 's|'$PWD'|%PWD%|g' \
 		-e 's/process [0-9]+/process %PID%/g' \
+		-e 's/after [0-9]+ sec/after %N% sec/g' \
 		-e 's/0x[0-9A-F]{7,16}/%ADDR%/g'
     fi
 }
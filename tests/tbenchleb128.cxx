@@ -0,0 +1,199 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/spiegel/spiegel.hxx"
+#include "np/spiegel/dwarf/state.hxx"
+#include "np/spiegel/dwarf/compile_unit.hxx"
+#include "np/spiegel/dwarf/walker.hxx"
+#include <time.h>
+
+using namespace std;
+using namespace np::util;
+using namespace np::spiegel::dwarf;
+
+/*
+ * Compares the speed of reader_t's LEB128 decoders against the
+ * byte at a time ones they fall back to, on the DWARF info of
+ * this program (or of the program named on the command line).
+ * Not one of the tests run by "make check" as the timings vary;
+ * use "make bench".
+ */
+
+#define REPEATS	    50
+
+static double
+now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Every abbrev code in .debug_info, where they really are */
+static uint64_t
+read_codes(const vector<reader_t> &codes, bool fast)
+{
+    uint64_t sum = 0;
+    vector<reader_t>::const_iterator i;
+    for (i = codes.begin() ; i != codes.end() ; ++i)
+    {
+	reader_t r = *i;
+	uint32_t v = 0;
+	if (fast ? r.read_uleb128(v) : r.read_uleb128_slow(v))
+	    sum += v;
+    }
+    return sum;
+}
+
+/* Whole sections read as nothing but LEB128 numbers */
+static uint64_t
+read_uleb_stream(const vector<reader_t> &sections, bool fast)
+{
+    uint64_t sum = 0;
+    vector<reader_t>::const_iterator i;
+    for (i = sections.begin() ; i != sections.end() ; ++i)
+    {
+	reader_t r = *i;
+	uint32_t v;
+	while (fast ? r.read_uleb128(v) : r.read_uleb128_slow(v))
+	    sum += v;
+    }
+    return sum;
+}
+
+static uint64_t
+read_sleb_stream(const vector<reader_t> &sections, bool fast)
+{
+    uint64_t sum = 0;
+    vector<reader_t>::const_iterator i;
+    for (i = sections.begin() ; i != sections.end() ; ++i)
+    {
+	reader_t r = *i;
+	int32_t v;
+	while (fast ? r.read_sleb128(v) : r.read_sleb128_slow(v))
+	    sum += (uint32_t)v;
+    }
+    return sum;
+}
+
+static int
+report(const char *what, unsigned long count,
+       double slow, double fast, uint64_t slowsum, uint64_t fastsum)
+{
+    printf("%-24s %9lu numbers  byte at a time %6.2f ns  fast %6.2f ns  x%.2f\n",
+	   what, count,
+	   slow * 1e9 / (count * REPEATS),
+	   fast * 1e9 / (count * REPEATS),
+	   (fast > 0 ? slow / fast : 0.0));
+    if (slowsum != fastsum)
+    {
+	printf("%s: results differ\n", what);
+	return 1;
+    }
+    return 0;
+}
+
+#define TIME(var, sum, expr) \
+    { \
+	double start = now(); \
+	sum = 0; \
+	for (int rep = 0 ; rep < REPEATS ; rep++) \
+	{ \
+	    /* stop the compiler doing it only once */ \
+	    __asm__ __volatile__("" ::: "memory"); \
+	    sum += (expr); \
+	} \
+	var = now() - start; \
+    }
+
+int
+main(int argc, char **argv)
+{
+    state_t state;
+    bool ok = (argc > 1 ? state.add_executable(argv[1]) : state.add_self());
+    if (!ok)
+	return 1;
+
+    vector<reader_t> codes;
+    vector<reader_t> info;
+    vector<reader_t> abbrevs;
+    const section_t *last_abbrev = 0;
+    const vector<compile_unit_t *> &units = state.get_compile_units();
+    vector<compile_unit_t *>::const_iterator i;
+    for (i = units.begin() ; i != units.end() ; ++i)
+    {
+	info.push_back((*i)->get_contents());
+
+	// the units in a link object share its .debug_abbrev
+	const section_t *sec = (*i)->get_section(DW_sec_abbrev);
+	if (sec && sec != last_abbrev)
+	    abbrevs.push_back(sec->get_contents());
+	last_abbrev = sec;
+
+	walker_t w(*i);
+	while (const entry_t *e = w.move_preorder())
+	{
+	    reader_t r = (*i)->get_contents();
+	    r.seek(e->get_offset());
+	    codes.push_back(r);
+	}
+    }
+
+    unsigned long nstream = 0;
+    for (vector<reader_t>::iterator j = abbrevs.begin() ; j != abbrevs.end() ; ++j)
+    {
+	reader_t r = *j;
+	while (r.skip_uleb128())
+	    nstream++;
+    }
+    unsigned long ninfo = 0;
+    for (vector<reader_t>::iterator j = info.begin() ; j != info.end() ; ++j)
+    {
+	reader_t r = *j;
+	while (r.skip_uleb128())
+	    ninfo++;
+    }
+    if (!codes.size() || !nstream || !ninfo)
+    {
+	printf("no DWARF info to read\n");
+	return 1;
+    }
+
+    int failed = 0;
+    double slow, fast;
+    uint64_t slowsum = 0, fastsum = 0;
+
+    TIME(slow, slowsum, read_codes(codes, false));
+    TIME(fast, fastsum, read_codes(codes, true));
+    failed |= report("abbrev codes", codes.size(),
+		     slow, fast, slowsum, fastsum);
+
+    TIME(slow, slowsum, read_uleb_stream(abbrevs, false));
+    TIME(fast, fastsum, read_uleb_stream(abbrevs, true));
+    failed |= report(".debug_abbrev as uleb", nstream,
+		     slow, fast, slowsum, fastsum);
+
+    TIME(slow, slowsum, read_uleb_stream(info, false));
+    TIME(fast, fastsum, read_uleb_stream(info, true));
+    failed |= report(".debug_info as uleb", ninfo,
+		     slow, fast, slowsum, fastsum);
+
+    TIME(slow, slowsum, read_sleb_stream(info, false));
+    TIME(fast, fastsum, read_sleb_stream(info, true));
+    failed |= report(".debug_info as sleb", ninfo,
+		     slow, fast, slowsum, fastsum);
+
+    return failed;
+}
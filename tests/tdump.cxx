@@ -15,6 +15,8 @@
  */
 #include "np/spiegel/spiegel.hxx"
 #include "np/spiegel/dwarf/state.hxx"
+#include "np/spiegel/dwarf/compile_unit.hxx"
+#include "np/spiegel/dwarf/walker.hxx"
 #include <string.h>
 
 using namespace std;
@@ -86,6 +88,38 @@ dump_compile_units(np::spiegel::dwarf::state_t &state)
     printf("\n\n");
 }
 
+static void
+dump_function_index(np::spiegel::dwarf::state_t &state)
+{
+    printf("Function Index\n");
+    printf("==============\n");
+
+    const np::spiegel::dwarf::state_t::function_index_t *index =
+	state.get_function_index();
+    if (!index)
+    {
+	printf("none\n\n\n");
+	return;
+    }
+
+    const vector<np::spiegel::dwarf::compile_unit_t *> &units = state.get_compile_units();
+    np::spiegel::dwarf::state_t::function_index_t::const_iterator i;
+    for (i = index->begin() ; i != index->end() ; ++i)
+    {
+	printf("%s:", i->first.c_str());
+	vector<uint32_t>::const_iterator j;
+	for (j = i->second.begin() ; j != i->second.end() ; ++j)
+	{
+	    np::spiegel::dwarf::walker_t w(units[*j]);
+	    const np::spiegel::dwarf::entry_t *e = w.move_next();
+	    printf(" %s", e->get_string_attribute(DW_AT_name));
+	}
+	printf("\n");
+    }
+
+    printf("\n\n");
+}
+
 int
 main(int argc, char **argv)
 {
@@ -138,6 +172,8 @@ usage:
 	dump_functions(state);
     else if (!strcmp(a0, "tdumpacu"))
 	dump_compile_units(state);
+    else if (!strcmp(a0, "tdumpdidx"))
+	dump_function_index(state);
     else
 	fatal("Don't know which dumper to run");
 
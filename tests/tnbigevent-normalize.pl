@@ -0,0 +1,36 @@
+#!/usr/bin/perl
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+use strict;
+use warnings;
+
+# Summarises tnbigevent's enormous event description: it should
+# have been cut short to fit in a proxy frame.
+while (<STDIN>)
+{
+    chomp;
+
+    my ($which, $desc) = m/^EVENT (\w+) (x+\.\.\.)$/;
+    if (defined $desc)
+    {
+	printf "EVENT %s %s\n", $which,
+	    (length($desc) <= 1024*1024 ? "cut short" : "too long");
+	next;
+    }
+
+    print "$_\n" if (m/^(EVENT|PASS|FAIL|EXIT) /);
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * An event with a description too big for the parent to accept
+ * in a proxy frame should arrive cut short, rather than hanging
+ * the child or being thrown away as garbage.
+ */
+#define BIG	(2*1024*1024)
+
+static void test_big(void)
+{
+    char *big = malloc(BIG+1);
+    memset(big, 'x', BIG);
+    big[BIG] = '\0';
+    __assert_fail(big, __FILE__, __LINE__, __func__);
+}
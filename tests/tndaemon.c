@@ -0,0 +1,37 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/*
+ * atndaemon-post.sh runs these again through a daemon, which must
+ * give the same results.  test_parent records which process forked
+ * it, so the script can tell the daemon really ran them.
+ */
+
+static void test_fail(void)
+{
+    NP_FAIL;
+}
+
+static void test_parent(void)
+{
+    FILE *fp = fopen("tndaemon.ppid", "w");
+    NP_ASSERT_NOT_NULL(fp);
+    fprintf(fp, "%d\n", (int)getppid());
+    fclose(fp);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+
+/*
+ * Something of each kind of function discovery finds, for
+ * atndisccache-post.sh to check is found again from the cache.
+ */
+
+int blue_bottle(int x)
+{
+    return x;
+}
+
+int mock_blue_bottle(int x)
+{
+    return x+1;
+}
+
+NP_PARAMETER(pour, "over,cold");
+
+static void test_disccache(void)
+{
+    fprintf(stderr, "MSG pour=\"%s\"\n", pour);
+    NP_ASSERT_EQUAL(blue_bottle(41), 42);
+}
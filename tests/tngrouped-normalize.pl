@@ -0,0 +1,70 @@
+#!/usr/bin/perl
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+use strict;
+use warnings;
+
+# Checks that every line tngrouped's tests wrote to stdout or
+# stderr appears in the block for the job which wrote it, i.e.
+# between that job's "np: running" and PASS lines.
+my $job;
+my $npass = 0;
+my $nlines = 0;
+my $misplaced = 0;
+
+while (<STDIN>)
+{
+    chomp;
+
+    my ($name) = m/^np: running: "\S*tngrouped\.(\w+)"$/;
+    if (defined $name)
+    {
+	$misplaced++ if defined $job;
+	$job = $name;
+	next;
+    }
+
+    ($name) = m/^(?:OUT|ERR) (\w+) \d+$/;
+    if (defined $name)
+    {
+	$misplaced++ unless (defined $job && $job eq $name);
+	$nlines++;
+	next;
+    }
+
+    ($name) = m/^PASS \S*tngrouped\.(\w+)$/;
+    if (defined $name)
+    {
+	$misplaced++ unless (defined $job && $job eq $name);
+	$npass++;
+	undef $job;
+	next;
+    }
+
+    print "$_\n" if (m/^(FAIL|EXIT) /);
+}
+
+printf "MSG %d jobs passed\n", $npass;
+printf "MSG %d lines of output\n", $nlines;
+if ($misplaced)
+{
+    printf "FAIL %d lines outside their job's block\n", $misplaced;
+}
+else
+{
+    printf "PASS output grouped by job\n";
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/*
+ * Each test writes a few lines to stdout and stderr, pausing between
+ * them so that tests running in parallel would interleave their
+ * output.  The normalize script checks that the grouped output
+ * format kept each job's lines together in its block.
+ */
+static void chatter(const char *name)
+{
+    int i;
+
+    for (i = 0 ; i < 4 ; i++)
+    {
+	printf("OUT %s %d\n", name, i);
+	fflush(stdout);
+	fprintf(stderr, "ERR %s %d\n", name, i);
+	usleep(50000);
+    }
+}
+
+static void test_ant(void) { chatter("ant"); }
+static void test_bee(void) { chatter("bee"); }
+static void test_cat(void) { chatter("cat"); }
+static void test_dog(void) { chatter("dog"); }
+static void test_eel(void) { chatter("eel"); }
+static void test_fox(void) { chatter("fox"); }
+static void test_gnu(void) { chatter("gnu"); }
+static void test_hen(void) { chatter("hen"); }
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * atnhistory-pre.sh gives the run a history file with more than
+ * enough old samples to be compacted at the end of the run.  This
+ * test appends a section to the file as another run sharing it
+ * would, after it has been loaded, and that mustn't be lost.
+ */
+static void test_late(void)
+{
+    static const char section[] = "@ /another/exe\nanother.late 7 0 PASS\n";
+    int fd = open("tnhistory.hist", O_WRONLY|O_APPEND);
+    NP_ASSERT(fd >= 0);
+    NP_ASSERT_EQUAL(write(fd, section, strlen(section)), strlen(section));
+    close(fd);
+}
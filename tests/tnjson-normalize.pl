@@ -0,0 +1,38 @@
+#!/usr/bin/perl
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+use strict;
+use warnings;
+
+# Keep the JSON lines and the exit status, masking the parts
+# which vary from run to run.
+while (<STDIN>)
+{
+    if (m/^EXIT /)
+    {
+	print;
+	next;
+    }
+    next unless m/^\{/;
+    s/"(time|elapsed|peak_rss_kb|timeout)":[0-9.]+/"$1":N/g;
+    s/"timestamp":"[^"]*"/"timestamp":T/;
+    s/"stack":"(\\.|[^"\\])*"/"stack":S/;
+    # the test name depends on where it was built
+    s/"[\w.]*(tnjson\.)/"$1/g;
+    s/,"peak_rss_kb":N//;
+    print;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+
+/*
+ * Run with -fjson; tnjson-normalize.pl masks the times and
+ * resource usage, which vary from run to run.
+ */
+NP_PARAMETER(pastry, "donut,danish");
+
+static void test_param(void)
+{
+    printf("pastry=\"%s\"\n", pastry);
+}
+
+static void test_bytes(void)
+{
+    /* a tab, a valid UTF-8 e-acute, and a byte which is never valid */
+    printf("a\tb \303\251 \377\n");
+    fprintf(stderr, "to stderr\n");
+}
+
+static void test_fail(void)
+{
+    NP_FAIL;
+}
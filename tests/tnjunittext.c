@@ -0,0 +1,36 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+
+/*
+ * Writes output which is awkward to put in a JUnit report: enough
+ * 3-byte UTF-8 characters that some are split between the chunks
+ * the spill file is read in, and characters XML doesn't allow.
+ */
+
+#define NEUROS	12000
+
+static void test_text(void)
+{
+    static const char controls[] = "before\0nul\001\033[0m after\n";
+    int i;
+
+    for (i = 0 ; i < NEUROS ; i++)
+	fputs("\xe2\x82\xac", stdout);
+    putchar('\n');
+    fwrite(controls, 1, sizeof(controls)-1, stdout);
+}
@@ -0,0 +1,84 @@
+#!/usr/bin/perl
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+use strict;
+use warnings;
+
+# Checks the log of tnmembudget run with -M250, where each test
+# declares 100 MB except test_big which declares 200 MB.
+my $n = 0;
+my $maxn = 0;
+my $big = 0;
+my $shared = 0;
+my @lines;
+
+while (<STDIN>)
+{
+    chomp;
+
+    my ($name) = m/^\d+.\d+ test_(\w+) begins$/;
+    if (defined $name)
+    {
+	$n++;
+	$maxn = $n if ($n > $maxn);
+	$big = 1 if ($name eq 'big');
+	$shared = 1 if ($big && $n > 1);
+	next;
+    }
+
+    ($name) = m/^\d+.\d+ test_(\w+) ends$/;
+    if (defined $name)
+    {
+	$n--;
+	$big = 0 if ($name eq 'big');
+	next;
+    }
+
+    if (m/^PASS tnmembudget\./)
+    {
+	push(@lines, $_);
+	next;
+    }
+
+    if (m/^EXIT/)
+    {
+	foreach my $l (sort @lines)
+	{
+	    print "$l\n";
+	}
+	print "$_\n";
+	next;
+    }
+}
+
+if ($maxn != 2)
+{
+    printf "FAIL expected maximum concurrency 2 got %d\n", $maxn;
+}
+else
+{
+    printf "PASS good maximum concurrency\n";
+}
+
+if ($shared)
+{
+    printf "FAIL test_big shared the memory budget\n";
+}
+else
+{
+    printf "PASS test_big ran alone\n";
+}
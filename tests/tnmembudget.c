@@ -0,0 +1,44 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+/*
+ * With a budget of 250 MB, at most two of these tests can run at
+ * the same time, and test_big must run alone.
+ */
+NP_MEMORY(100);
+
+#define TEST(name) \
+    static void test_##name(void) \
+    { \
+	fprintf(stderr, "%s test_" #name " begins\n", np_rel_timestamp()); fflush(stderr); \
+	usleep(300000); \
+	fprintf(stderr, "%s test_" #name " ends\n", np_rel_timestamp()); fflush(stderr); \
+    }
+
+TEST(1)
+TEST(2)
+TEST(3)
+TEST(4)
+TEST(big)
+NP_TEST_MEMORY(big, 200);
+TEST(5)
+TEST(6)
+TEST(7)
+TEST(8)
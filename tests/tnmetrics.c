@@ -0,0 +1,68 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * Run with -S tnmetrics.sock; the runner is serving metrics on
+ * that socket while the test scrapes them.
+ */
+static void test_other(void)
+{
+}
+
+static void test_scrape(void)
+{
+    static const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    static const char * const wanted[] =
+    {
+	"HTTP/", "np_jobs_queued ", "np_jobs_running ", "np_jobs_done_total ",
+	"np_job_results_total{result=\"PASS\"} ",
+	"np_job_duration_seconds_count ", NULL
+    };
+    struct sockaddr_un sun;
+    char buf[16384];
+    size_t len = 0;
+    ssize_t r;
+    char *line;
+    int i;
+    int fd;
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, "tnmetrics.sock");
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    NP_ASSERT(fd >= 0);
+    NP_ASSERT_EQUAL(connect(fd, (struct sockaddr *)&sun, sizeof(sun)), 0);
+    NP_ASSERT_EQUAL(write(fd, request, sizeof(request)-1), (ssize_t)sizeof(request)-1);
+    while (len < sizeof(buf)-1 && (r = read(fd, buf+len, sizeof(buf)-1-len)) > 0)
+	len += r;
+    close(fd);
+    buf[len] = '\0';
+
+    for (line = strtok(buf, "\r\n") ; line ; line = strtok(NULL, "\r\n"))
+    {
+	for (i = 0 ; wanted[i] ; i++)
+	{
+	    if (!strncmp(line, wanted[i], strlen(wanted[i])))
+		printf("MSG %s\n", line);
+	}
+    }
+}
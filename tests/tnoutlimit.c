@@ -0,0 +1,41 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+
+/*
+ * Run with a small output cap: both tests have their captured
+ * stdout truncated, and the second also writes more than the
+ * hard limit and fails.
+ */
+
+static void write_lines(int nbytes)
+{
+    int i;
+
+    for (i = 0 ; i < nbytes/64 ; i++)
+	printf("line %05d %052d\n", i, 0);
+}
+
+static void test_chatty(void)
+{
+    write_lines(32*1024);
+}
+
+static void test_flood(void)
+{
+    write_lines(256*1024);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <stdio.h>
+
+/*
+ * atnresume-pre.sh runs only test_first, journalling its result;
+ * the resumed run should replay that result without running it
+ * again, and only run test_second.
+ */
+static void test_first(void)
+{
+    fprintf(stderr, "MSG test_first is running\n");
+}
+
+static void test_second(void)
+{
+    fprintf(stderr, "MSG test_second is running\n");
+}
@@ -0,0 +1,60 @@
+#!/usr/bin/perl
+#
+#  Copyright 2011-2012 Gregory Banks
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+
+use strict;
+use warnings;
+
+# Checks that the syslog events raised by tnringorder arrive in
+# the order they were raised, none are missing, and the assert which
+# went through the pipe arrives after them.
+my $expected = 150;
+my $n = 0;
+my $misordered = 0;
+
+while (<STDIN>)
+{
+    chomp;
+
+    my ($i) = m/^EVENT SYSLOG err: message (\d+) /;
+    if (defined $i)
+    {
+	$misordered++ if ($i != $n);
+	$n++;
+	next;
+    }
+
+    if (m/^EVENT ASSERT x+$/)
+    {
+	$misordered++ if ($n != $expected);
+	next;
+    }
+
+    print "$_\n" if (m/^(PASS|FAIL|EXIT) /);
+}
+
+if ($n != $expected)
+{
+    printf "FAIL expected %d events got %d\n", $expected, $n;
+}
+elsif ($misordered)
+{
+    printf "FAIL %d events out of order\n", $misordered;
+}
+else
+{
+    printf "PASS events in order\n";
+}
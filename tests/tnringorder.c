@@ -0,0 +1,45 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <np.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+/*
+ * Raises a stream of events, which go through the event ring, then
+ * one too big for the ring to hold at all, so the child has to
+ * switch to the pipe part way through the test.  The normalize
+ * script checks the events were all reported in the order they
+ * were raised.
+ */
+#define NMESSAGES   150
+#define BIG	    (128*1024)
+
+static void test_ring_overflow(void)
+{
+    char *big;
+    int i;
+
+    np_syslog_ignore("message [0-9]+ ");
+    for (i = 0 ; i < NMESSAGES ; i++)
+	syslog(LOG_ERR, "message %d %0500d", i, 0);
+
+    big = malloc(BIG+1);
+    memset(big, 'x', BIG);
+    big[BIG] = '\0';
+    __assert_fail(big, __FILE__, __LINE__, __func__);
+}
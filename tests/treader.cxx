@@ -24,6 +24,9 @@ int
 main(int argc __attribute__((unused)),
      char **argv __attribute__((unused)))
 {
+    // Each number is read both on its own, and followed by enough
+    // other bytes that the reader can take the fast path.
+    unsigned char buf[16];
 #define TESTCASE(in, out) \
     { \
 	BEGIN("read_sleb128(%d)", out); \
@@ -31,6 +34,13 @@ main(int argc __attribute__((unused)),
 	int32_t v = 0; \
 	CHECK(r.read_sleb128(v)); \
 	CHECK(v == out); \
+	memset(buf, 0x80, sizeof(buf)); \
+	memcpy(buf, in, sizeof(in)-1); \
+	np::spiegel::dwarf::reader_t r2(buf, sizeof(buf)); \
+	v = 0; \
+	CHECK(r2.read_sleb128(v)); \
+	CHECK(v == out); \
+	CHECK(r2.get_offset() == sizeof(in)-1); \
 	END; \
     }
     TESTCASE("\x02", 2);
@@ -41,6 +51,9 @@ main(int argc __attribute__((unused)),
     TESTCASE("\x80\x7f", -128);
     TESTCASE("\x81\x01", 129);
     TESTCASE("\xff\x7e", -129);
+    TESTCASE("\xc0\xbb\x78", -123456);
+    TESTCASE("\xff\xff\xff\xff\x07", 2147483647);
+    TESTCASE("\x80\x80\x80\x80\x78", (int32_t)0x80000000);
 
 #undef TESTCASE
 #define TESTCASE(in, out) \
@@ -50,6 +63,13 @@ main(int argc __attribute__((unused)),
 	uint32_t v = 0; \
 	CHECK(r.read_uleb128(v)); \
 	CHECK(v == out); \
+	memset(buf, 0x80, sizeof(buf)); \
+	memcpy(buf, in, sizeof(in)-1); \
+	np::spiegel::dwarf::reader_t r2(buf, sizeof(buf)); \
+	v = 0; \
+	CHECK(r2.read_uleb128(v)); \
+	CHECK(v == out); \
+	CHECK(r2.get_offset() == sizeof(in)-1); \
 	END; \
     }
 
@@ -59,6 +79,10 @@ main(int argc __attribute__((unused)),
     TESTCASE("\x81\x01", 129);
     TESTCASE("\x82\x01", 130);
     TESTCASE("\xb9\x64", 12857);
+    TESTCASE("\xe5\x8e\x26", 624485);
+    TESTCASE("\xff\xff\xff\xff\x0f", 0xffffffff);
+    // bits beyond 32 are dropped
+    TESTCASE("\x81\x80\x80\x80\x80\x01", 1);
 
 #undef TESTCASE
     return 0;
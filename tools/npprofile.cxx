@@ -0,0 +1,164 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/util/common.hxx"
+#include "np/util/profile.hxx"
+#include <map>
+
+/*
+ * npprofile: convert the binary records written by the profiling
+ * probes when NOVAPROVA_PROFILE is set into Chrome trace event JSON,
+ * for chrome://tracing or https://ui.perfetto.dev.
+ */
+
+using namespace std;
+using namespace np::profile;
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s profile-file > trace.json\n", argv0);
+    exit(1);
+}
+
+static bool
+read_file(const char *filename, string &data)
+{
+    FILE *fp = fopen(filename, "r");
+    if (!fp)
+    {
+	perror(filename);
+	return false;
+    }
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+	data.append(buf, n);
+    fclose(fp);
+    return true;
+}
+
+struct chunk_info_t
+{
+    const chunk_t *chunk_;
+    vector<const char *> names_;
+    const record_t *records_;
+};
+
+/* Split the file into chunks; a truncated last chunk is dropped */
+static bool
+parse_chunks(const string &data, vector<chunk_info_t> &chunks)
+{
+    const char *p = data.data();
+    const char *end = p + data.size();
+
+    while (p + sizeof(chunk_t) <= end)
+    {
+	chunk_info_t ci;
+	ci.chunk_ = (const chunk_t *)p;
+	if (ci.chunk_->magic_ != MAGIC)
+	{
+	    fprintf(stderr, "npprofile: bad chunk at offset %lu\n",
+		    (unsigned long)(p - data.data()));
+	    return false;
+	}
+	p += sizeof(chunk_t);
+	for (uint32_t i = 0 ; i < ci.chunk_->nsites_ ; i++)
+	{
+	    uint32_t len;
+	    if (p + sizeof(len) > end)
+		return true;
+	    memcpy(&len, p, sizeof(len));
+	    p += sizeof(len);
+	    if (p + len > end)
+		return true;
+	    ci.names_.push_back(p);
+	    p += len;
+	}
+	if (p + ci.chunk_->nrecords_ * sizeof(record_t) > end)
+	    return true;
+	ci.records_ = (const record_t *)p;
+	p += ci.chunk_->nrecords_ * sizeof(record_t);
+	chunks.push_back(ci);
+    }
+    return true;
+}
+
+/* Names are C++ function names, which need no JSON escaping
+ * beyond what's done here */
+static string
+json_name(const char *s)
+{
+    string r;
+    for ( ; *s ; s++)
+    {
+	if (*s == '"' || *s == '\\')
+	    r += '\\';
+	r += *s;
+    }
+    return r;
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc != 2)
+	usage(argv[0]);
+
+    string data;
+    vector<chunk_info_t> chunks;
+    if (!read_file(argv[1], data) || !parse_chunks(data, chunks))
+	exit(1);
+
+    /* times are shown relative to the first record */
+    int64_t first = 0;
+    vector<chunk_info_t>::const_iterator itr;
+    for (itr = chunks.begin() ; itr != chunks.end() ; ++itr)
+    {
+	for (uint32_t i = 0 ; i < itr->chunk_->nrecords_ ; i++)
+	{
+	    if (!first || itr->records_[i].time_ < first)
+		first = itr->records_[i].time_;
+	}
+    }
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    const char *sep = "\n";
+    /* A child's records start inside the probe which was around the
+     * fork in its parent; the viewers don't like unmatched ends */
+    map<uint32_t, int> depths;
+    for (itr = chunks.begin() ; itr != chunks.end() ; ++itr)
+    {
+	int &depth = depths[itr->chunk_->pid_];
+	for (uint32_t i = 0 ; i < itr->chunk_->nrecords_ ; i++)
+	{
+	    const record_t *r = &itr->records_[i];
+	    if (r->site_ < 1 || r->site_ > itr->names_.size())
+		continue;
+	    if (r->which_ == END && !depth)
+		continue;
+	    depth += (r->which_ == BEGIN ? 1 : -1);
+	    printf("%s{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%u,\"tid\":%u,"
+		   "\"ts\":%.3f}",
+		   sep, json_name(itr->names_[r->site_-1]).c_str(),
+		   (r->which_ == BEGIN ? "B" : "E"),
+		   itr->chunk_->pid_, itr->chunk_->pid_,
+		   (r->time_ - first) / 1000.0);
+	    sep = ",\n";
+	}
+    }
+    printf("\n]}\n");
+    return 0;
+}
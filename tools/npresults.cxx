@@ -0,0 +1,285 @@
+/*
+ * Copyright 2011-2012 Gregory Banks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "np/util/common.hxx"
+#include "np/resultlog.hxx"
+#include <getopt.h>
+#include <algorithm>
+
+/*
+ * npresults: query a binary result log written with np_set_result_log.
+ */
+
+using namespace std;
+using namespace np;
+using namespace np::util;
+
+static unsigned int max_lines = 20;
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-n count] result-log runs\n"
+		    "       %s [-n count] result-log slowest [run]\n"
+		    "       %s [-n count] result-log failures\n"
+		    "       %s [-n count] result-log compare [run1 run2]\n",
+		    argv0, argv0, argv0, argv0);
+    exit(1);
+}
+
+static unsigned int
+parse_run(const result_log_t *log, const char *arg)
+{
+    char *end;
+    unsigned long run = strtoul(arg, &end, 10);
+    if (*end || !log->get_run(run))
+    {
+	fprintf(stderr, "npresults: no such run \"%s\"\n", arg);
+	exit(1);
+    }
+    return run;
+}
+
+static void
+list_runs(const result_log_t *log)
+{
+    vector<unsigned int> njobs(log->get_nruns()+1);
+    vector<unsigned int> nfailed(log->get_nruns()+1);
+    vector<const result_log_t::job_record_t*>::const_iterator itr;
+    for (itr = log->get_jobs().begin() ; itr != log->get_jobs().end() ; ++itr)
+    {
+	unsigned int run = (*itr)->run_;
+	if (run >= njobs.size())
+	    continue;
+	njobs[run]++;
+	if ((*itr)->result_ == R_FAIL)
+	    nfailed[run]++;
+    }
+
+    printf("%5s %-19s %6s %6s %s\n", "RUN", "TIMESTAMP", "JOBS", "FAILED", "EXE");
+    for (unsigned int run = 1 ; run <= log->get_nruns() ; run++)
+    {
+	const result_log_t::run_record_t *r = log->get_run(run);
+	printf("%5u %-19s %6u %6u %s\n", run,
+	       abs_format_iso8601(r->timestamp_).c_str(),
+	       njobs[run], nfailed[run], log->get_string(r->exe_));
+    }
+}
+
+static bool
+slower(const result_log_t::job_record_t *a, const result_log_t::job_record_t *b)
+{
+    return a->elapsed_ > b->elapsed_;
+}
+
+static void
+list_slowest(const result_log_t *log, unsigned int run)
+{
+    vector<const result_log_t::job_record_t*> jobs;
+    vector<const result_log_t::job_record_t*>::const_iterator itr;
+    for (itr = log->get_jobs().begin() ; itr != log->get_jobs().end() ; ++itr)
+    {
+	if ((*itr)->run_ == run)
+	    jobs.push_back(*itr);
+    }
+    sort(jobs.begin(), jobs.end(), slower);
+
+    printf("%10s %-7s %s\n", "ELAPSED", "RESULT", "NAME");
+    for (unsigned int i = 0 ; i < jobs.size() && i < max_lines ; i++)
+	printf("%10s %-7s %s\n", rel_format(jobs[i]->elapsed_).c_str(),
+	       as_string((result_t)jobs[i]->result_),
+	       log->get_string(jobs[i]->name_));
+}
+
+struct rate_t
+{
+    rate_t() : name_(0), nruns_(0), nfailed_(0), event_(0) {}
+
+    uint64_t name_;
+    unsigned int nruns_;
+    unsigned int nfailed_;
+    uint64_t event_;	    /* the most recent failure */
+};
+
+static bool
+more_failures(const rate_t &a, const rate_t &b)
+{
+    /* compare nfailed/nruns without dividing */
+    uint64_t fa = (uint64_t)a.nfailed_ * b.nruns_;
+    uint64_t fb = (uint64_t)b.nfailed_ * a.nruns_;
+    if (fa != fb)
+	return fa > fb;
+    return a.nfailed_ > b.nfailed_;
+}
+
+static void
+list_failures(const result_log_t *log)
+{
+    /* strings are interned, so the name's offset identifies the test */
+    map<uint64_t, rate_t> rates;
+    vector<const result_log_t::job_record_t*>::const_iterator itr;
+    for (itr = log->get_jobs().begin() ; itr != log->get_jobs().end() ; ++itr)
+    {
+	rate_t &r = rates[(*itr)->name_];
+	r.name_ = (*itr)->name_;
+	r.nruns_++;
+	if ((*itr)->result_ == R_FAIL)
+	{
+	    r.nfailed_++;
+	    r.event_ = (*itr)->event_;
+	}
+    }
+
+    vector<rate_t> failing;
+    map<uint64_t, rate_t>::const_iterator ritr;
+    for (ritr = rates.begin() ; ritr != rates.end() ; ++ritr)
+    {
+	if (ritr->second.nfailed_)
+	    failing.push_back(ritr->second);
+    }
+    sort(failing.begin(), failing.end(), more_failures);
+
+    printf("%6s %6s %6s %s\n", "FAILED", "RUNS", "RATE", "NAME");
+    for (unsigned int i = 0 ; i < failing.size() && i < max_lines ; i++)
+    {
+	const rate_t &r = failing[i];
+	printf("%6u %6u %5.1f%% %s\n", r.nfailed_, r.nruns_,
+	       100.0 * r.nfailed_ / r.nruns_, log->get_string(r.name_));
+	if (r.event_)
+	    printf("%21s%s\n", "", log->get_string(r.event_));
+    }
+}
+
+struct delta_t
+{
+    delta_t() : name_(0), before_(-1), after_(-1) {}
+
+    uint64_t name_;
+    int64_t before_;
+    int64_t after_;
+};
+
+static int64_t
+magnitude(const delta_t &d)
+{
+    int64_t x = d.after_ - d.before_;
+    return (x < 0 ? -x : x);
+}
+
+static bool
+bigger_change(const delta_t &a, const delta_t &b)
+{
+    return magnitude(a) > magnitude(b);
+}
+
+static void
+compare_runs(const result_log_t *log, unsigned int run1, unsigned int run2)
+{
+    map<uint64_t, delta_t> deltas;
+    vector<const result_log_t::job_record_t*>::const_iterator itr;
+    for (itr = log->get_jobs().begin() ; itr != log->get_jobs().end() ; ++itr)
+    {
+	if ((*itr)->run_ != run1 && (*itr)->run_ != run2)
+	    continue;
+	delta_t &d = deltas[(*itr)->name_];
+	d.name_ = (*itr)->name_;
+	if ((*itr)->run_ == run1)
+	    d.before_ = (*itr)->elapsed_;
+	else
+	    d.after_ = (*itr)->elapsed_;
+    }
+
+    /* only tests which ran in both */
+    vector<delta_t> both;
+    map<uint64_t, delta_t>::const_iterator ditr;
+    for (ditr = deltas.begin() ; ditr != deltas.end() ; ++ditr)
+    {
+	if (ditr->second.before_ >= 0 && ditr->second.after_ >= 0)
+	    both.push_back(ditr->second);
+    }
+    sort(both.begin(), both.end(), bigger_change);
+
+    printf("%10s %10s %10s %s\n", "BEFORE", "AFTER", "DELTA", "NAME");
+    for (unsigned int i = 0 ; i < both.size() && i < max_lines ; i++)
+    {
+	const delta_t &d = both[i];
+	string delta = rel_format(d.after_ - d.before_);
+	if (d.after_ >= d.before_)
+	    delta = "+" + delta;
+	printf("%10s %10s %10s %s\n", rel_format(d.before_).c_str(),
+	       rel_format(d.after_).c_str(), delta.c_str(),
+	       log->get_string(d.name_));
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "n:")) >= 0)
+    {
+	switch (c)
+	{
+	case 'n':
+	    if ((max_lines = atoi(optarg)) == 0)
+		usage(argv[0]);
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+    }
+    if (argc - optind < 2)
+	usage(argv[0]);
+
+    result_log_t log(argv[optind]);
+    if (!log.load())
+	exit(1);
+    const char *cmd = argv[optind+1];
+    int nargs = argc - optind - 2;
+    char **args = argv + optind + 2;
+    unsigned int last = log.get_nruns();
+
+    if (!strcmp(cmd, "runs") && nargs == 0)
+    {
+	list_runs(&log);
+    }
+    else if (!strcmp(cmd, "slowest") && nargs <= 1)
+    {
+	if (!last)
+	    exit(0);
+	list_slowest(&log, (nargs ? parse_run(&log, args[0]) : last));
+    }
+    else if (!strcmp(cmd, "failures") && nargs == 0)
+    {
+	list_failures(&log);
+    }
+    else if (!strcmp(cmd, "compare") && (nargs == 0 || nargs == 2))
+    {
+	if (nargs)
+	    compare_runs(&log, parse_run(&log, args[0]), parse_run(&log, args[1]));
+	else if (last >= 2)
+	    compare_runs(&log, last-1, last);
+	else
+	{
+	    fprintf(stderr, "npresults: need two runs to compare\n");
+	    exit(1);
+	}
+    }
+    else
+	usage(argv[0]);
+
+    return 0;
+}